@@ -0,0 +1,337 @@
+/**
+ * compares the latest run in a result store (see benchresult.h) against
+ * a baseline: earlier runs in the same store, or a separate baseline store
+ * given with -B. each series is matched by machine, test and metric and
+ * tested with a two sided Mann-Whitney U test. a change counts as a
+ * regression only if it is significant, has at least a medium effect size
+ * (Cliff's delta) and moves the median by more than a few percent, so the
+ * frame-to-frame noise of a healthy run does not trip it.
+ *
+ * exit status: 0 no regression, 1 regression found, 2 error, 3 nothing
+ * compared (no series had a baseline).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "benchutil.h"
+
+struct Record {
+    char *run, *machine, *kernel, *driver, *test, *metric, *unit;
+    int lower_is_better;        // -1 for context series, never a regression
+    double *samples;
+    size_t n;
+};
+
+struct Store {
+    struct Record *recs;
+    size_t n, cap;
+};
+
+static struct {
+    double alpha;
+    double min_delta;
+    double min_change;
+    const char *run;
+} opts = {
+    0.01, 0.33, 3.0, NULL,
+};
+
+static int split_tabs(char *line, char **fields, int max)
+{
+    int n = 0;
+    for (char *p = line; n < max; ) {
+        fields[n++] = p;
+        p = strchr(p, '\t');
+        if (!p) break;
+        *p++ = 0;
+    }
+    return n;
+}
+
+static int load_store(const char *path, struct Store *st)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    int lineno = 0;
+    while ((len = getline(&line, &size, f)) > 0) {
+        lineno++;
+        if (line[len-1] == '\n') line[--len] = 0;
+        if (len == 0 || line[0] == '#') continue;
+
+        char *fld[11];
+        if (split_tabs(line, fld, 11) != 11) {
+            fprintf(stderr, "%s:%d: malformed record, skipped\n", path, lineno);
+            continue;
+        }
+
+        if (st->n == st->cap) {
+            st->cap = st->cap ? st->cap * 2 : 256;
+            st->recs = realloc(st->recs, st->cap * sizeof *st->recs);
+        }
+        struct Record *r = &st->recs[st->n++];
+        r->run = strdup(fld[0]);
+        r->machine = strdup(fld[2]);
+        r->kernel = strdup(fld[3]);
+        r->driver = strdup(fld[4]);
+        r->test = strdup(fld[5]);
+        r->metric = strdup(fld[6]);
+        r->unit = strdup(fld[7]);
+        r->lower_is_better = !strcmp(fld[8], "none") ? -1 : strcmp(fld[8], "higher") != 0;
+
+        size_t want = strtoul(fld[9], NULL, 10);
+        r->samples = calloc(want ? want : 1, sizeof(double));
+        r->n = 0;
+        for (char *p = fld[10]; *p && r->n < want; ) {
+            char *end;
+            double v = strtod(p, &end);
+            if (end == p) break;
+            r->samples[r->n++] = v;
+            p = *end == ',' ? end + 1 : end;
+        }
+    }
+    free(line);
+    fclose(f);
+    return 0;
+}
+
+static void free_store(struct Store *st)
+{
+    for (size_t i = 0; i < st->n; i++) {
+        struct Record *r = &st->recs[i];
+        free(r->run); free(r->machine); free(r->kernel); free(r->driver);
+        free(r->test); free(r->metric); free(r->unit); free(r->samples);
+    }
+    free(st->recs);
+    memset(st, 0, sizeof *st);
+}
+
+static int same_series(const struct Record *a, const struct Record *b)
+{
+    return !strcmp(a->machine, b->machine) && !strcmp(a->test, b->test) &&
+        !strcmp(a->metric, b->metric);
+}
+
+struct Pool {
+    double *v;
+    size_t n;
+};
+
+static void pool_add(struct Pool *p, const struct Record *r)
+{
+    p->v = realloc(p->v, (p->n + r->n) * sizeof(double));
+    memcpy(p->v + p->n, r->samples, r->n * sizeof(double));
+    p->n += r->n;
+}
+
+struct Ranked {
+    double v;
+    int group;
+};
+
+static int cmp_ranked(const void *a, const void *b)
+{
+    double x = ((const struct Ranked*)a)->v, y = ((const struct Ranked*)b)->v;
+    return x < y ? -1 : (x > y);
+}
+
+struct MannWhitney {
+    double u;           // pairs where the new sample is larger, ties count half
+    double p;           // two sided, normal approximation with tie correction
+    double delta;       // Cliff's delta of new against base, -1..1
+};
+
+static void mann_whitney(const struct Pool *base, const struct Pool *cur,
+        struct MannWhitney *mw)
+{
+    size_t n1 = base->n, n2 = cur->n, N = n1 + n2;
+    struct Ranked *all = malloc(N * sizeof *all);
+    for (size_t i = 0; i < n1; i++) all[i] = (struct Ranked){ base->v[i], 0 };
+    for (size_t i = 0; i < n2; i++) all[n1 + i] = (struct Ranked){ cur->v[i], 1 };
+    qsort(all, N, sizeof *all, cmp_ranked);
+
+    // average ranks over ties
+    double rank_sum_new = 0.0, tie_term = 0.0;
+    for (size_t i = 0; i < N; ) {
+        size_t j = i;
+        while (j < N && all[j].v == all[i].v) j++;
+        double rank = (i + 1 + j) / 2.0;
+        double t = j - i;
+        tie_term += t * t * t - t;
+        for (size_t k = i; k < j; k++) {
+            if (all[k].group) rank_sum_new += rank;
+        }
+        i = j;
+    }
+    free(all);
+
+    mw->u = rank_sum_new - n2 * (n2 + 1) / 2.0;
+    mw->delta = 2.0 * mw->u / ((double)n1 * n2) - 1.0;
+
+    double mu = n1 * n2 / 2.0;
+    double var = n1 * n2 / 12.0 * ((N + 1) - tie_term / ((double)N * (N - 1)));
+    if (var <= 0) {
+        mw->p = 1.0;
+        return;
+    }
+    double diff = fabs(mw->u - mu) - 0.5;
+    double z = diff > 0 ? diff / sqrt(var) : 0.0;
+    mw->p = erfc(z / sqrt(2.0));
+}
+
+static double median(const struct Pool *p)
+{
+    double *tmp = malloc(p->n * sizeof(double));
+    memcpy(tmp, p->v, p->n * sizeof(double));
+    struct bench_stats st;
+    bench_stats_compute(tmp, p->n, &st);
+    free(tmp);
+    return st.median;
+}
+
+// the most recent run other than `exclude` that has this series
+static const char *baseline_run(const struct Store *st, const struct Record *r,
+        const char *exclude)
+{
+    for (size_t i = st->n; i-- > 0; ) {
+        const struct Record *b = &st->recs[i];
+        if (same_series(b, r) && (!exclude || strcmp(b->run, exclude))) return b->run;
+    }
+    return NULL;
+}
+
+// compares one series, returns 1 on regression, -1 when there is nothing
+// to compare against
+static int compare_series(const struct Store *cur_store, const struct Record *first,
+        const struct Store *base_store, const char *cur_run)
+{
+    struct Pool cur = {0}, base = {0};
+    const struct Record *last_base = NULL;
+
+    for (size_t i = 0; i < cur_store->n; i++) {
+        const struct Record *r = &cur_store->recs[i];
+        if (!strcmp(r->run, cur_run) && same_series(r, first)) pool_add(&cur, r);
+    }
+
+    const char *brun = baseline_run(base_store, first,
+            base_store == cur_store ? cur_run : NULL);
+    for (size_t i = 0; brun && i < base_store->n; i++) {
+        const struct Record *r = &base_store->recs[i];
+        if (!strcmp(r->run, brun) && same_series(r, first)) {
+            pool_add(&base, r);
+            last_base = r;
+        }
+    }
+
+    char label[160];
+    snprintf(label, sizeof label, "%s/%s", first->test, first->metric);
+    int regression = -1;
+
+    if (!last_base) {
+        printf("%-40s no baseline\n", label);
+    } else if (base.n < 8 || cur.n < 8) {
+        printf("%-40s too few samples (%zu vs %zu)\n", label, base.n, cur.n);
+    } else {
+        struct MannWhitney mw;
+        mann_whitney(&base, &cur, &mw);
+        double bm = median(&base), cm = median(&cur);
+        double change = bm != 0 ? 100.0 * (cm - bm) / fabs(bm) : 0.0;
+
+        // delta > 0: new values tend to be larger
+        double worse = first->lower_is_better ? mw.delta : -mw.delta;
+        int significant = mw.p < opts.alpha && fabs(mw.delta) >= opts.min_delta &&
+            fabs(change) >= opts.min_change;
+        regression = significant && first->lower_is_better >= 0 && worse > 0;
+
+        printf("%-40s %10.4g -> %-10.4g %s %+6.1f%%  p=%.2g delta=%+.2f  %s\n",
+                label, bm, cm, first->unit, change, mw.p, mw.delta,
+                !significant ? "same" : first->lower_is_better < 0 ? "changed" :
+                regression ? "REGRESSION" : "improved");
+        if (strcmp(last_base->kernel, first->kernel))
+            printf("%-40s kernel %s -> %s\n", "", last_base->kernel, first->kernel);
+        if (strcmp(last_base->driver, first->driver))
+            printf("%-40s driver %s -> %s\n", "", last_base->driver, first->driver);
+    }
+
+    free(cur.v);
+    free(base.v);
+    return regression;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-B baseline.tsv] [-r run] [-a alpha] [-d min_delta] "
+            "[-c min_change_pct] results.tsv\n"
+            "compares run (default: the last one in results.tsv) against the latest\n"
+            "earlier run of each series in the baseline store. exits 1 on a\n"
+            "regression, 3 when no series had a baseline to compare against\n", prog);
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *baseline_path = NULL;
+    int c;
+    while ((c = getopt(argc, argv, "B:r:a:d:c:")) != -1) {
+        switch (c) {
+            case 'B': baseline_path = optarg; break;
+            case 'r': opts.run = optarg; break;
+            case 'a': opts.alpha = atof(optarg); break;
+            case 'd': opts.min_delta = atof(optarg); break;
+            case 'c': opts.min_change = atof(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind + 1 != argc || opts.alpha <= 0) usage(argv[0]);
+
+    struct Store cur = {0}, base = {0};
+    if (load_store(argv[optind], &cur)) return 2;
+    // a missing baseline is not an error, the first run has none. it is not
+    // a pass either: exit 3 below tells the caller nothing was compared
+    if (baseline_path && load_store(baseline_path, &base))
+        fprintf(stderr, "no baseline store, nothing to compare against\n");
+    const struct Store *bstore = baseline_path ? &base : &cur;
+
+    if (cur.n == 0) {
+        printf("no results recorded\n");
+        free_store(&cur);
+        free_store(&base);
+        return 3;
+    }
+    const char *run = opts.run ? opts.run : cur.recs[cur.n - 1].run;
+
+    printf("run %s on %s, kernel %s, alpha %g, min |delta| %g, min change %g%%\n",
+            run, cur.recs[cur.n - 1].machine, cur.recs[cur.n - 1].kernel,
+            opts.alpha, opts.min_delta, opts.min_change);
+
+    int regressions = 0, compared = 0;
+    for (size_t i = 0; i < cur.n; i++) {
+        const struct Record *r = &cur.recs[i];
+        if (strcmp(r->run, run)) continue;
+
+        // each series once, at its first record in the run
+        int seen = 0;
+        for (size_t j = 0; j < i && !seen; j++) {
+            seen = !strcmp(cur.recs[j].run, run) && same_series(&cur.recs[j], r);
+        }
+        if (seen) continue;
+        int res = compare_series(&cur, r, bstore, run);
+        if (res >= 0) compared++;
+        if (res > 0) regressions++;
+    }
+
+    printf("%d regression(s) in %d compared series\n", regressions, compared);
+    free_store(&cur);
+    free_store(&base);
+    return regressions ? 1 : compared ? 0 : 3;
+}
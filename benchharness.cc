@@ -0,0 +1,107 @@
+#include <math.h>
+
+#include "benchutil.h"
+#include "benchharness.h"
+
+using namespace std;
+
+BenchState::BenchState(int64_t arg, double warmup_ms, double min_sample_ms,
+        int repetitions)
+    :_arg(arg), _warmup_ns(warmup_ms * 1e6), _min_sample_ns(min_sample_ms * 1e6),
+    _repetitions(repetitions)
+{
+}
+
+void BenchState::pause_timing()
+{
+    _pause_start = bench_now_ns();
+}
+
+void BenchState::resume_timing()
+{
+    _paused_ns += bench_now_ns() - _pause_start;
+}
+
+void BenchState::set_items(double per_iteration, const char *unit)
+{
+    _items = per_iteration;
+    _item_unit = unit;
+}
+
+void BenchState::skip(const string& reason)
+{
+    _skip_reason = reason;
+    _phase = DONE;
+    _remaining = 0;
+}
+
+void BenchState::fail(const string& reason)
+{
+    skip(reason);
+    _failed = true;
+}
+
+// called when a batch is used up, the current call counts as the first
+// iteration of the next batch
+bool BenchState::next_batch()
+{
+    uint64_t now = bench_now_ns();
+    double elapsed = (double)(now - _batch_start) - _paused_ns;
+
+    switch (_phase) {
+    case START:
+        _phase = WARMUP;
+        _warmup_end = now + _warmup_ns;
+        _batch = 1;
+        break;
+
+    case WARMUP:
+        if (now < _warmup_end || elapsed <= 0) {
+            // doubling keeps the clock reads out of short iterations
+            _batch *= 2;
+            break;
+        }
+        _phase = MEASURE;
+        _batch = (int64_t)ceil(_min_sample_ns / (elapsed / _batch));
+        if (_batch < 1) _batch = 1;
+        break;
+
+    case MEASURE:
+        _samples.push_back(elapsed / _batch);
+        if ((int)_samples.size() < _repetitions) break;
+        _phase = DONE;
+        return false;
+
+    case DONE:
+        return false;
+    }
+
+    _remaining = _batch - 1;
+    _paused_ns = 0;
+    _batch_start = bench_now_ns();
+    return true;
+}
+
+static vector<BenchCase>& registry()
+{
+    // function local, registration runs from static initializers
+    static vector<BenchCase> cases;
+    return cases;
+}
+
+int bench_register(const char *name, BenchFunction fn,
+        initializer_list<int64_t> args)
+{
+    if (args.size() == 0) {
+        registry().push_back({ name, fn, 0 });
+    }
+    for (int64_t arg: args) {
+        registry().push_back({ string(name) + "/" + to_string(arg), fn, arg });
+    }
+    return 0;
+}
+
+const vector<BenchCase>& bench_cases()
+{
+    return registry();
+}
@@ -0,0 +1,102 @@
+#ifndef _BENCH_HARNESS_H
+#define _BENCH_HARNESS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <initializer_list>
+
+/**
+ * harness behind video_bench. a case is a function that does its setup,
+ * then loops on keep_running() around the code being measured:
+ *
+ *   static void frame_copy(BenchState& state)
+ *   {
+ *       vector<char> src(state.arg()), dst(state.arg());
+ *       state.set_items(state.arg(), "B");
+ *       while (state.keep_running()) memcpy(dst.data(), src.data(), src.size());
+ *   }
+ *   VIDEO_BENCH(frame_copy, 1 << 20, 8 << 20);
+ *
+ * the loop warms up first and sizes its batches from that, then records
+ * `repetitions` samples of at least the minimum sample time each. every
+ * sample is the mean time of one iteration of its batch. setup before the
+ * loop and teardown after it are not timed.
+ */
+class BenchState {
+public:
+    BenchState(int64_t arg, double warmup_ms, double min_sample_ms, int repetitions);
+
+    bool keep_running()
+    {
+        if (_remaining > 0) {
+            _remaining--;
+            return true;
+        }
+        return next_batch();
+    }
+
+    // for per iteration work that should not count, e.g. refilling input
+    void pause_timing();
+    void resume_timing();
+
+    // items (bytes, pixels, draws...) one iteration handles, for a rate
+    void set_items(double per_iteration, const char *unit);
+    // the case cannot run here (no GL, missing extension...)
+    void skip(const std::string& reason);
+    // the case ran but produced wrong output, video_bench exits 1
+    void fail(const std::string& reason);
+
+    int64_t arg() const { return _arg; }
+    bool skipped() const { return !_skip_reason.empty(); }
+    bool failed() const { return _failed; }
+    const std::string& skip_reason() const { return _skip_reason; }
+    const std::vector<double>& samples_ns() const { return _samples; }
+    int64_t batch() const { return _batch; }
+    double items() const { return _items; }
+    const char *item_unit() const { return _item_unit; }
+
+private:
+    enum Phase { START, WARMUP, MEASURE, DONE };
+
+    bool next_batch();
+
+    int64_t _arg;
+    uint64_t _warmup_ns, _min_sample_ns;
+    int _repetitions;
+
+    Phase _phase {START};
+    int64_t _batch {1}, _remaining {0};
+    uint64_t _batch_start {0}, _warmup_end {0};
+    uint64_t _paused_ns {0}, _pause_start {0};
+    std::vector<double> _samples;
+
+    double _items {0};
+    const char *_item_unit {""};
+    std::string _skip_reason;
+    bool _failed {false};
+};
+
+typedef void (*BenchFunction)(BenchState& state);
+
+struct BenchCase {
+    std::string name;
+    BenchFunction fn;
+    int64_t arg;
+};
+
+// registers fn once per argument (or once without), named "fn/arg"
+int bench_register(const char *name, BenchFunction fn,
+        std::initializer_list<int64_t> args);
+const std::vector<BenchCase>& bench_cases();
+
+#define VIDEO_BENCH(fn, ...) \
+    static int fn##_registered = bench_register(#fn, fn, {__VA_ARGS__})
+
+// keeps the compiler from dropping a result nobody reads
+static inline void bench_keep(const void *p)
+{
+    asm volatile("" : : "g"(p) : "memory");
+}
+
+#endif
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#include <GLES2/gl2.h>
+
+#include "benchresult.h"
+
+static char driver_name[256] = "unknown";
+static char run_id[128];
+static char machine[256];
+
+// fields are tab separated, keep tabs and newlines out of them
+static void copy_field(char *dst, size_t size, const char *src)
+{
+    size_t i = 0;
+    for (; src && *src && i + 1 < size; src++) {
+        dst[i++] = (*src == '\t' || *src == '\n' || *src == '\r') ? ' ' : *src;
+    }
+    while (i > 0 && dst[i-1] == ' ') i--;
+    dst[i] = 0;
+}
+
+static int read_line(const char *path, char *buf, size_t size)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return 1;
+    char *ok = fgets(buf, size, f);
+    fclose(f);
+    if (!ok) return 1;
+    buf[strcspn(buf, "\n")] = 0;
+    return buf[0] == 0;
+}
+
+static void init_ids()
+{
+    if (run_id[0]) return;
+
+    const char *env = getenv("BENCH_RUN_ID");
+    if (env && *env) copy_field(run_id, sizeof run_id, env);
+    else snprintf(run_id, sizeof run_id, "%ld-%d", (long)time(NULL), (int)getpid());
+
+    // the product name says what the machine is, the uuid which one;
+    // hostnames are the same on every board booting the same image
+    char product[128], id[128], tmp[256];
+    env = getenv("BENCH_MACHINE");
+    if (env && *env) {
+        copy_field(machine, sizeof machine, env);
+        return;
+    }
+    if (read_line("/sys/class/dmi/id/product_name", product, sizeof product))
+        strcpy(product, "unknown");
+    if (read_line("/sys/class/dmi/id/product_uuid", id, sizeof id) &&
+            gethostname(id, sizeof id))
+        strcpy(id, "unknown");
+    snprintf(tmp, sizeof tmp, "%s:%s", product, id);
+    copy_field(machine, sizeof machine, tmp);
+}
+
+void bench_result_driver(const char *driver)
+{
+    copy_field(driver_name, sizeof driver_name, driver);
+}
+
+void bench_result_gl_driver(void)
+{
+    const char *renderer = (const char *)glGetString(GL_RENDERER);
+    const char *version = (const char *)glGetString(GL_VERSION);
+    char buf[256];
+    snprintf(buf, sizeof buf, "%s, %s", renderer ? renderer : "unknown",
+            version ? version : "unknown");
+    bench_result_driver(buf);
+}
+
+int bench_result_record(const char *test, const char *metric, const char *unit,
+        int lower_is_better, const double *samples, size_t n)
+{
+    const char *path = getenv("BENCH_RESULTS");
+    if (!path || !*path || n == 0) return 0;
+    init_ids();
+
+    struct utsname uts;
+    if (uname(&uts)) strcpy(uts.release, "unknown");
+
+    char t[128], m[128], u[32];
+    copy_field(t, sizeof t, test);
+    copy_field(m, sizeof m, metric);
+    copy_field(u, sizeof u, unit);
+
+    size_t keep = n < BENCH_RESULT_MAX_SAMPLES ? n : BENCH_RESULT_MAX_SAMPLES;
+    size_t cap = 2048 + keep * 24;
+    char *line = malloc(cap);
+    if (!line) return 1;
+
+    int len = snprintf(line, cap, "%s\t%ld\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%zu\t",
+            run_id, (long)time(NULL), machine, uts.release, driver_name, t, m, u,
+            lower_is_better == BENCH_CONTEXT ? "none" : lower_is_better ? "lower" : "higher",
+            keep);
+    for (size_t i = 0; i < keep && len < (int)cap; i++) {
+        size_t idx = keep == n ? i : i * n / keep;
+        len += snprintf(line + len, cap - len, i ? ",%.6g" : "%.6g", samples[idx]);
+    }
+    if (len >= (int)cap - 1) len = cap - 2;
+    line[len++] = '\n';
+
+    // one write on an O_APPEND fd, concurrent tests do not interleave
+    int ret = 1;
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd >= 0) {
+        ret = write(fd, line, len) != len;
+        close(fd);
+    }
+    if (ret) fprintf(stderr, "cannot append results to %s\n", path);
+    free(line);
+    return ret;
+}
@@ -0,0 +1,40 @@
+#ifndef _BENCH_RESULT_H
+#define _BENCH_RESULT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * append-only result store, one tab separated line per measured series:
+ *
+ *   run time machine kernel driver test metric unit better n s1,s2,...
+ *
+ * `better` is "lower", "higher" or "none" for series that only explain
+ * others (clocks, power states). records go to the file named by
+ * $BENCH_RESULTS and nothing is written when it is unset. all records of
+ * a process share $BENCH_RUN_ID (one per lava job), or a generated id.
+ * $BENCH_MACHINE overrides the dmi based machine name. series longer
+ * than BENCH_RESULT_MAX_SAMPLES are evenly subsampled.
+ */
+#define BENCH_RESULT_MAX_SAMPLES 256
+
+/* gl renderer and version, drm driver name... whatever identifies the
+ * driver stack the following records were measured on */
+void bench_result_driver(const char *driver);
+/* renderer and version of the current gl context */
+void bench_result_gl_driver(void);
+
+/* lower_is_better 1 or 0, or BENCH_CONTEXT for a "none" series */
+#define BENCH_CONTEXT (-1)
+
+int bench_result_record(const char *test, const char *metric, const char *unit,
+        int lower_is_better, const double *samples, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
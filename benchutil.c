@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "benchutil.h"
+
+uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : (x > y);
+}
+
+double bench_quantile(const double *sorted, size_t n, double q)
+{
+    if (n == 0) return 0.0;
+    if (q <= 0.0) return sorted[0];
+    if (q >= 1.0) return sorted[n-1];
+
+    // linear interpolation between closest ranks
+    double pos = q * (n - 1);
+    size_t lo = (size_t)pos;
+    double frac = pos - lo;
+    if (lo + 1 >= n) return sorted[n-1];
+    return sorted[lo] + (sorted[lo+1] - sorted[lo]) * frac;
+}
+
+void bench_stats_compute(double *samples, size_t n, struct bench_stats *st)
+{
+    st->n = n;
+    if (n == 0) {
+        st->min = st->max = st->mean = st->stddev = 0.0;
+        st->median = st->p95 = st->p99 = 0.0;
+        return;
+    }
+
+    qsort(samples, n, sizeof(double), cmp_double);
+
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++) sum += samples[i];
+    st->mean = sum / n;
+
+    double var = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double d = samples[i] - st->mean;
+        var += d * d;
+    }
+    st->stddev = n > 1 ? sqrt(var / (n - 1)) : 0.0;
+
+    st->min = samples[0];
+    st->max = samples[n-1];
+    st->median = bench_quantile(samples, n, 0.5);
+    st->p95 = bench_quantile(samples, n, 0.95);
+    st->p99 = bench_quantile(samples, n, 0.99);
+}
+
+void bench_stats_print(const char *label, const char *unit,
+        const struct bench_stats *st)
+{
+    printf("%-24s n=%-6zu min %9.3f  med %9.3f  mean %9.3f  p95 %9.3f  "
+            "p99 %9.3f  max %9.3f  sd %8.3f %s\n",
+            label, st->n, st->min, st->median, st->mean, st->p95,
+            st->p99, st->max, st->stddev, unit);
+}
+
+static uint64_t timeval_ns(const struct timeval *tv)
+{
+    return (uint64_t)tv->tv_sec * 1000000000ull + tv->tv_usec * 1000ull;
+}
+
+void bench_cpu_sample(struct bench_cpu_usage *u)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    u->wall_ns = bench_now_ns();
+    u->user_ns = timeval_ns(&ru.ru_utime);
+    u->sys_ns = timeval_ns(&ru.ru_stime);
+    u->voluntary_cs = ru.ru_nvcsw;
+    u->involuntary_cs = ru.ru_nivcsw;
+}
+
+void bench_cpu_print(const char *label, const struct bench_cpu_usage *begin,
+        const struct bench_cpu_usage *end)
+{
+    double wall = (end->wall_ns - begin->wall_ns) / 1e6;
+    double user = (end->user_ns - begin->user_ns) / 1e6;
+    double sys = (end->sys_ns - begin->sys_ns) / 1e6;
+
+    printf("%-24s wall %.1f ms, user %.1f ms, sys %.1f ms, cpu %.1f%% of a core, "
+            "ctx switches %ld/%ld (vol/invol)\n",
+            label, wall, user, sys, wall > 0 ? 100.0 * (user + sys) / wall : 0.0,
+            end->voluntary_cs - begin->voluntary_cs,
+            end->involuntary_cs - begin->involuntary_cs);
+}
+
+static int list_has(const char *list, char sep, const char *name)
+{
+    size_t len = strlen(name);
+    for (const char *p = list; (p = strstr(p, name)); p += len) {
+        if ((p == list || p[-1] == sep) && (p[len] == sep || p[len] == 0))
+            return 1;
+    }
+    return 0;
+}
+
+int extension_list_has(const char *list, const char *name)
+{
+    return list && list_has(list, ' ', name);
+}
+
+int bench_selected(const char *list, const char *name)
+{
+    return !strcmp(list, "all") || list_has(list, ',', name);
+}
@@ -0,0 +1,56 @@
+#ifndef _BENCH_UTIL_H
+#define _BENCH_UTIL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct bench_stats {
+    size_t n;
+    double min, max;
+    double mean, stddev;
+    double median, p95, p99;
+};
+
+/* monotonic clock, not affected by ntp jumps like gettimeofday */
+uint64_t bench_now_ns(void);
+
+static inline double bench_ns_to_ms(uint64_t ns) { return ns / 1e6; }
+
+/* samples are sorted in place */
+void bench_stats_compute(double *samples, size_t n, struct bench_stats *st);
+
+/* value at quantile q (0..1) of an already sorted array */
+double bench_quantile(const double *sorted, size_t n, double q);
+
+void bench_stats_print(const char *label, const char *unit,
+        const struct bench_stats *st);
+
+/* process cpu time (getrusage) against wall time */
+struct bench_cpu_usage {
+    uint64_t wall_ns;
+    uint64_t user_ns, sys_ns;
+    long voluntary_cs, involuntary_cs;
+};
+
+void bench_cpu_sample(struct bench_cpu_usage *u);
+/* prints cpu time used between two samples and its share of one core */
+void bench_cpu_print(const char *label, const struct bench_cpu_usage *begin,
+        const struct bench_cpu_usage *end);
+
+/* non-zero when name is a whole token of a space separated list, such as
+ * a GL or EGL extension string. list may be NULL */
+int extension_list_has(const char *list, const char *name);
+
+/* non-zero when list is "all" or has name as one of its comma separated
+ * entries, for options like -m blit,copy */
+int bench_selected(const char *list, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,585 @@
+/**
+ * draws the same scenes through Cogl and through raw GLES2 into an
+ * offscreen target of the same size: textured quads from an atlas, many
+ * small solid rectangles, and quads that keep switching texture and
+ * blending. every frame is finished before the next, so wall time per
+ * frame is throughput and rusage time per frame is what the cpu paid for
+ * it, Cogl's journal and state tracking on one side, our own batching on
+ * the other.
+ *
+ * Cogl runs on its GLES2 driver over an EGL winsys, so that both sides
+ * drive the same GL implementation and only the Cogl layer differs. the
+ * raw side sets the same blend and texture state Cogl derives from its
+ * pipelines.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#define COGL_ENABLE_EXPERIMENTAL_2_0_API
+#include <cogl/cogl.h>
+
+#include "glutil.h"
+#include "eglutil.h"
+#include "benchutil.h"
+#include "memstat.h"
+#include "benchresult.h"
+
+#define err_msg(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+} while (0)
+
+#define err_quit(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+    exit(1); \
+} while (0)
+
+using namespace std;
+
+static struct {
+    int count;
+    int frames;
+    int width, height;
+    const char* api;
+} opts = {
+    2000, 200, 1280, 720, "all",
+};
+
+enum Scene {
+    TexturedQuads,
+    SmallPrimitives,
+    StateChanges,
+    SceneCount,
+};
+
+static const char* scene_names[] = {
+    "textured-quads", "small-primitives", "state-changes",
+};
+
+enum Api {
+    Cogl,
+    Gles,
+    ApiCount,
+};
+
+static const int ATLAS_SIZE = 256, ATLAS_CELLS = 8;
+static const int PALETTE = 16;
+static const int STATE_VARIANTS = 8;    // 4 textures x blend on/off
+
+struct Result {
+    bool valid;
+    double wall_ms, cpu_ms;
+    struct bench_stats st;
+};
+
+static Result results[SceneCount][ApiCount];
+// the GL implementation each side ran on, printed with the comparison
+static string drivers[ApiCount];
+
+static string gl_driver_string()
+{
+    const char *renderer = (const char *)glGetString(GL_RENDERER);
+    const char *version = (const char *)glGetString(GL_VERSION);
+    return string(renderer ? renderer : "unknown") + ", " + (version ? version : "unknown");
+}
+
+static int scene_count(Scene scene)
+{
+    // small primitives are cheap to fill, submit many more of them
+    return scene == SmallPrimitives ? opts.count * 4 : opts.count;
+}
+
+// a grid of rectangles that drifts a bit every frame, so geometry has
+// to be rebuilt like a scrolling ui does
+static void quad_rect(Scene scene, int i, int frame, float r[4])
+{
+    float size = scene == SmallPrimitives ? 6.0f : 32.0f;
+    int cols = (int)(opts.width / (size + 2));
+    int rows = (int)(opts.height / (size + 2));
+    int cell = i % (cols * rows);
+    r[0] = (cell % cols) * (size + 2) + (frame % 3);
+    r[1] = (cell / cols) * (size + 2);
+    r[2] = r[0] + size;
+    r[3] = r[1] + size;
+}
+
+static void atlas_cell(int i, float st[4])
+{
+    int cell = i % (ATLAS_CELLS * ATLAS_CELLS);
+    float s = 1.0f / ATLAS_CELLS;
+    st[0] = (cell % ATLAS_CELLS) * s;
+    st[1] = (cell / ATLAS_CELLS) * s;
+    st[2] = st[0] + s;
+    st[3] = st[1] + s;
+}
+
+static void palette_color(int i, GLubyte c[4])
+{
+    c[0] = (GLubyte)(i * 16);
+    c[1] = (GLubyte)(255 - i * 16);
+    c[2] = (GLubyte)(i * 48);
+    c[3] = 255;
+}
+
+// premultiplied rgba, translucent toward the edges of each atlas cell
+static vector<GLubyte> texture_pixels(int size, int seed)
+{
+    vector<GLubyte> px(size * size * 4);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            GLubyte *p = &px[(y * size + x) * 4];
+            int cx = x % (size / ATLAS_CELLS), cy = y % (size / ATLAS_CELLS);
+            int a = (cx > 2 && cy > 2) ? 255 : 128;
+            p[0] = (GLubyte)(((x * 7 + seed * 40) & 0xff) * a / 255);
+            p[1] = (GLubyte)(((y * 5) & 0xff) * a / 255);
+            p[2] = (GLubyte)(((x ^ y) & 0xff) * a / 255);
+            p[3] = (GLubyte)a;
+        }
+    }
+    return px;
+}
+
+typedef void (*FrameFunc)(Scene scene, int frame);
+
+// runs frames until opts.frames are measured, each one waited for
+static void measure(Scene scene, Api api, FrameFunc frame_fn, void (*finish)())
+{
+    for (int frame = 0; frame < 3; frame++) frame_fn(scene, frame);
+    finish();
+
+    vector<double> frame_ms;
+    frame_ms.reserve(opts.frames);
+    struct bench_cpu_usage begin, end;
+    bench_cpu_sample(&begin);
+    for (int frame = 0; frame < opts.frames; frame++) {
+        uint64_t t0 = bench_now_ns();
+        frame_fn(scene, frame);
+        finish();
+        frame_ms.push_back(bench_ns_to_ms(bench_now_ns() - t0));
+    }
+    bench_cpu_sample(&end);
+
+    Result& r = results[scene][api];
+    r.valid = true;
+    r.wall_ms = bench_ns_to_ms(end.wall_ns - begin.wall_ns) / opts.frames;
+    r.cpu_ms = bench_ns_to_ms(end.user_ns + end.sys_ns - begin.user_ns - begin.sys_ns)
+        / opts.frames;
+    bench_stats_compute(frame_ms.data(), frame_ms.size(), &r.st);
+
+    char label[64];
+    snprintf(label, sizeof label, "%s %s", api == Cogl ? "cogl" : "gles", scene_names[scene]);
+    bench_stats_print(label, "ms/frame", &r.st);
+    bench_result_record("cogl_gles_bench", label, "ms/frame", 1, frame_ms.data(),
+            frame_ms.size());
+}
+
+static struct {
+    CoglContext *ctx;
+    CoglFramebuffer *fb;
+    CoglTexture *fb_tex;
+    CoglPipeline *atlas;
+    CoglPipeline *solid[PALETTE];
+    CoglPipeline *variant[STATE_VARIANTS];
+    CoglTexture *tex[STATE_VARIANTS / 2];
+} cs;
+
+static CoglTexture *cs_texture(int size, const vector<GLubyte>& px)
+{
+    CoglError *error = NULL;
+    CoglTexture2D *tex = cogl_texture_2d_new_from_data(cs.ctx, size, size,
+            COGL_PIXEL_FORMAT_RGBA_8888_PRE, size * 4, px.data(), &error);
+    if (!tex) {
+        err_msg("cogl texture: %s\n", error->message);
+        cogl_error_free(error);
+        return NULL;
+    }
+    return COGL_TEXTURE(tex);
+}
+
+static const char *winsys_name(CoglWinsysID id)
+{
+    switch (id) {
+        case COGL_WINSYS_ID_EGL_XLIB: return "egl-xlib";
+        case COGL_WINSYS_ID_EGL_NULL: return "egl-null";
+        case COGL_WINSYS_ID_EGL_WAYLAND: return "egl-wayland";
+        case COGL_WINSYS_ID_EGL_KMS: return "egl-kms";
+        default: return "other";
+    }
+}
+
+static bool cs_setup()
+{
+    CoglError *error = NULL;
+
+    // the default is desktop GL on whatever winsys comes first, which
+    // would compare drivers instead of Cogl against raw calls
+    CoglRenderer *renderer = cogl_renderer_new();
+    cogl_renderer_set_driver(renderer, COGL_DRIVER_GLES2);
+    cogl_renderer_add_constraint(renderer, COGL_RENDERER_CONSTRAINT_USES_EGL);
+    CoglDisplay *display = NULL;
+    if (cogl_renderer_connect(renderer, &error)) {
+        display = cogl_display_new(renderer, NULL);
+        if (cogl_display_setup(display, &error))
+            cs.ctx = cogl_context_new(display, &error);
+    }
+    // the context keeps its display and renderer alive
+    if (display) cogl_object_unref(display);
+    if (!cs.ctx) {
+        err_msg("cannot create a GLES2 CoglContext: %s\n", error->message);
+        cogl_error_free(error);
+        cogl_object_unref(renderer);
+        return false;
+    }
+    const char *winsys = winsys_name(cogl_renderer_get_winsys_id(renderer));
+    cogl_object_unref(renderer);
+
+    cs.fb_tex = COGL_TEXTURE(cogl_texture_2d_new_with_size(cs.ctx, opts.width, opts.height));
+    cs.fb = COGL_FRAMEBUFFER(cogl_offscreen_new_with_texture(cs.fb_tex));
+    if (!cogl_framebuffer_allocate(cs.fb, &error)) {
+        err_msg("cannot allocate cogl framebuffer: %s\n", error->message);
+        cogl_error_free(error);
+        return false;
+    }
+    cogl_framebuffer_orthographic(cs.fb, 0, 0, opts.width, opts.height, -1, 100);
+    bench_result_gl_driver();
+    drivers[Cogl] = gl_driver_string() + " (cogl gles2 driver, " + winsys + ")";
+
+    for (int i = 0; i < STATE_VARIANTS / 2; i++) {
+        cs.tex[i] = cs_texture(ATLAS_SIZE, texture_pixels(ATLAS_SIZE, i));
+        if (!cs.tex[i]) return false;
+    }
+
+    cs.atlas = cogl_pipeline_new(cs.ctx);
+    cogl_pipeline_set_layer_texture(cs.atlas, 0, cs.tex[0]);
+
+    for (int i = 0; i < PALETTE; i++) {
+        GLubyte c[4];
+        palette_color(i, c);
+        cs.solid[i] = cogl_pipeline_new(cs.ctx);
+        cogl_pipeline_set_color4ub(cs.solid[i], c[0], c[1], c[2], c[3]);
+    }
+
+    for (int i = 0; i < STATE_VARIANTS; i++) {
+        cs.variant[i] = cogl_pipeline_new(cs.ctx);
+        cogl_pipeline_set_layer_texture(cs.variant[i], 0, cs.tex[i % 4]);
+        if (i >= 4) cogl_pipeline_set_blend(cs.variant[i], "RGBA = ADD(SRC_COLOR, 0)", NULL);
+    }
+    return true;
+}
+
+static void cs_release()
+{
+    for (auto p: cs.variant) if (p) cogl_object_unref(p);
+    for (auto p: cs.solid) if (p) cogl_object_unref(p);
+    for (auto t: cs.tex) if (t) cogl_object_unref(t);
+    if (cs.atlas) cogl_object_unref(cs.atlas);
+    if (cs.fb) cogl_object_unref(cs.fb);
+    if (cs.fb_tex) cogl_object_unref(cs.fb_tex);
+    if (cs.ctx) cogl_object_unref(cs.ctx);
+    memset(&cs, 0, sizeof cs);
+}
+
+static void cs_frame(Scene scene, int frame)
+{
+    cogl_framebuffer_clear4f(cs.fb, COGL_BUFFER_BIT_COLOR, 0, 0, 0, 1);
+
+    int n = scene_count(scene);
+    for (int i = 0; i < n; i++) {
+        float r[4], st[4];
+        quad_rect(scene, i, frame, r);
+        switch (scene) {
+            case TexturedQuads:
+                atlas_cell(i, st);
+                cogl_framebuffer_draw_textured_rectangle(cs.fb, cs.atlas,
+                        r[0], r[1], r[2], r[3], st[0], st[1], st[2], st[3]);
+                break;
+            case SmallPrimitives:
+                cogl_framebuffer_draw_rectangle(cs.fb, cs.solid[i % PALETTE],
+                        r[0], r[1], r[2], r[3]);
+                break;
+            default:
+                cogl_framebuffer_draw_textured_rectangle(cs.fb,
+                        cs.variant[i % STATE_VARIANTS], r[0], r[1], r[2], r[3],
+                        0, 0, 1, 1);
+                break;
+        }
+    }
+}
+
+static void cs_finish()
+{
+    cogl_framebuffer_finish(cs.fb);
+}
+
+static const char* vert_shader = R"(
+attribute vec2 position;
+attribute vec2 texcoord;
+attribute vec4 color;
+uniform vec2 scale;
+varying vec2 v_uv;
+varying vec4 v_color;
+
+void main() {
+    v_uv = texcoord;
+    v_color = color;
+    // pixels, origin top left, like cogl_framebuffer_orthographic
+    gl_Position = vec4(position * scale + vec2(-1.0, 1.0), 0.0, 1.0);
+}
+)";
+static const char* frag_shader = R"(
+precision mediump float;
+uniform sampler2D tex;
+varying vec2 v_uv;
+varying vec4 v_color;
+void main() {
+    gl_FragColor = texture2D(tex, v_uv) * v_color;
+}
+)";
+// what Cogl generates for a pipeline with a colour and no layers
+static const char* solid_frag_shader = R"(
+precision mediump float;
+varying vec2 v_uv;
+varying vec4 v_color;
+void main() {
+    gl_FragColor = v_color;
+}
+)";
+
+struct Vertex {
+    GLfloat x, y, u, v;
+    GLubyte rgba[4];
+};
+
+static struct {
+    GLProgram prog, solid;
+    GLBuffer vbo {GL_ARRAY_BUFFER};
+    GLuint tex[STATE_VARIANTS / 2];
+    vector<Vertex> verts;
+} gs;
+
+static GLuint gs_texture(int size, const GLubyte *px)
+{
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA,
+            GL_UNSIGNED_BYTE, px);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return tex;
+}
+
+static bool gs_setup()
+{
+    gs.prog = GLProgram(vert_shader, frag_shader);
+    gs.solid = GLProgram(vert_shader, solid_frag_shader);
+    if (!gs.prog.valid() || !gs.solid.valid()) return false;
+    gs.solid.use();
+    glUniform2f(gs.solid.uniform("scale"), 2.0f / opts.width, -2.0f / opts.height);
+    gs.prog.use();
+    glUniform2f(gs.prog.uniform("scale"), 2.0f / opts.width, -2.0f / opts.height);
+    glUniform1i(gs.prog.uniform("tex"), 0);
+
+    for (int i = 0; i < STATE_VARIANTS / 2; i++) {
+        gs.tex[i] = gs_texture(ATLAS_SIZE, texture_pixels(ATLAS_SIZE, i).data());
+    }
+
+    // premultiplied over, cogl's default blend
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glViewport(0, 0, opts.width, opts.height);
+    gs.verts.reserve(scene_count(SmallPrimitives) * 6);
+    return glGetError() == GL_NO_ERROR;
+}
+
+static void gs_release()
+{
+    glDeleteTextures(STATE_VARIANTS / 2, gs.tex);
+    gs.prog.reset();
+    gs.solid.reset();
+    gs.vbo = GLBuffer(GL_ARRAY_BUFFER);
+    vector<Vertex>().swap(gs.verts);
+}
+
+static void push_quad(const float r[4], const float st[4], const GLubyte c[4])
+{
+    const float xy[6][4] = {
+        {r[0], r[1], st[0], st[1]}, {r[0], r[3], st[0], st[3]}, {r[2], r[3], st[2], st[3]},
+        {r[2], r[3], st[2], st[3]}, {r[2], r[1], st[2], st[1]}, {r[0], r[1], st[0], st[1]},
+    };
+    for (int k = 0; k < 6; k++) {
+        Vertex v = { xy[k][0], xy[k][1], xy[k][2], xy[k][3], { c[0], c[1], c[2], c[3] } };
+        gs.verts.push_back(v);
+    }
+}
+
+static void gs_frame(Scene scene, int frame)
+{
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    int n = scene_count(scene);
+    static const float full[4] = { 0, 0, 1, 1 };
+    static const GLubyte white[4] = { 255, 255, 255, 255 };
+    gs.verts.clear();
+    for (int i = 0; i < n; i++) {
+        float r[4], st[4];
+        GLubyte c[4];
+        quad_rect(scene, i, frame, r);
+        switch (scene) {
+            case TexturedQuads:
+                atlas_cell(i, st);
+                push_quad(r, st, white);
+                break;
+            case SmallPrimitives:
+                palette_color(i % PALETTE, c);
+                push_quad(r, full, c);
+                break;
+            default:
+                push_quad(r, full, white);
+                break;
+        }
+    }
+
+    // orphan and refill, the straightforward way to stream geometry
+    gs.vbo.data(gs.verts.size() * sizeof(Vertex), gs.verts.data(), GL_STREAM_DRAW);
+    const GLProgram& prog = scene == SmallPrimitives ? gs.solid : gs.prog;
+    prog.use();
+    // texcoord is unused and may be compiled out of the solid program
+    GLint pos = prog.attrib("position");
+    GLint uv = prog.attrib("texcoord");
+    GLint color = prog.attrib("color");
+    glEnableVertexAttribArray(pos);
+    glVertexAttribPointer(pos, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));
+    if (uv >= 0) {
+        glEnableVertexAttribArray(uv);
+        glVertexAttribPointer(uv, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                (void*)offsetof(Vertex, u));
+    }
+    glEnableVertexAttribArray(color);
+    glVertexAttribPointer(color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+            (void*)offsetof(Vertex, rgba));
+
+    if (scene == SmallPrimitives) {
+        // opaque colours without layers: Cogl draws them untextured with
+        // blending off
+        glDisable(GL_BLEND);
+        glDrawArrays(GL_TRIANGLES, 0, n * 6);
+        return;
+    }
+    if (scene == TexturedQuads) {
+        // the atlas has alpha, Cogl blends it with its default blend
+        glEnable(GL_BLEND);
+        glBindTexture(GL_TEXTURE_2D, gs.tex[0]);
+        glDrawArrays(GL_TRIANGLES, 0, n * 6);
+        return;
+    }
+
+    // every quad needs other state than the previous one, as in cogl:
+    // its ADD(SRC_COLOR, 0) variants are drawn with blending off
+    for (int i = 0; i < n; i++) {
+        int variant = i % STATE_VARIANTS;
+        glBindTexture(GL_TEXTURE_2D, gs.tex[variant % 4]);
+        if (variant >= 4) glDisable(GL_BLEND);
+        else glEnable(GL_BLEND);
+        glDrawArrays(GL_TRIANGLES, i * 6, 6);
+    }
+}
+
+static void gs_finish()
+{
+    glFinish();
+}
+
+static void print_comparison()
+{
+    bool paired = false;
+    for (int s = 0; s < SceneCount; s++) paired |= results[s][Cogl].valid && results[s][Gles].valid;
+    if (!paired) return;
+
+    printf("\ncogl: %s\ngles: %s\n", drivers[Cogl].c_str(), drivers[Gles].c_str());
+    printf("\n%-18s %12s %12s %12s %12s %8s\n", "scene", "cogl cpu ms", "gles cpu ms",
+            "cogl fps", "gles fps", "cpu x");
+    for (int s = 0; s < SceneCount; s++) {
+        const Result& c = results[s][Cogl];
+        const Result& g = results[s][Gles];
+        if (!c.valid || !g.valid) continue;
+        printf("%-18s %12.3f %12.3f %12.1f %12.1f %8.2f\n", scene_names[s],
+                c.cpu_ms, g.cpu_ms, 1000.0 / c.wall_ms, 1000.0 / g.wall_ms,
+                g.cpu_ms > 0 ? c.cpu_ms / g.cpu_ms : 0.0);
+    }
+}
+
+static void usage(const char* prog)
+{
+    err_quit("usage: %s [-n count] [-f frames] [-s WxH] [-a all|cogl|gles]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    int c;
+    while ((c = getopt(argc, argv, "n:f:s:a:")) != -1) {
+        switch (c) {
+            case 'n': opts.count = atoi(optarg); break;
+            case 'f': opts.frames = atoi(optarg); break;
+            case 's':
+                if (sscanf(optarg, "%dx%d", &opts.width, &opts.height) != 2)
+                    usage(argv[0]);
+                break;
+            case 'a': opts.api = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (opts.count <= 0 || opts.frames <= 0 || opts.width <= 0 || opts.height <= 0)
+        usage(argv[0]);
+    bool do_cogl = !strcmp(opts.api, "all") || !strcmp(opts.api, "cogl");
+    bool do_gles = !strcmp(opts.api, "all") || !strcmp(opts.api, "gles");
+    if (!do_cogl && !do_gles) usage(argv[0]);
+
+    printf("%d quads (x4 small primitives), %d frames at %dx%d\n", opts.count,
+            opts.frames, opts.width, opts.height);
+
+    struct memstat mem = {0};
+    int ret = 0;
+
+    // one api at a time, each with its own context
+    if (do_cogl) {
+        if (cs_setup()) {
+            for (int s = 0; s < SceneCount; s++) measure((Scene)s, Cogl, cs_frame, cs_finish);
+        } else {
+            ret = 1;
+        }
+        cs_release();
+        memstat_sample(&mem, "cogl");
+    }
+
+    if (do_gles) {
+        EGLOffscreen egl;
+        if (egl.create(opts.width, opts.height) && gs_setup()) {
+            printf("gles renderer: %s\n", glGetString(GL_RENDERER));
+            bench_result_gl_driver();
+            drivers[Gles] = gl_driver_string() + " (surfaceless or pbuffer EGL)";
+            for (int s = 0; s < SceneCount; s++) measure((Scene)s, Gles, gs_frame, gs_finish);
+            if (glGetError() != GL_NO_ERROR) {
+                err_msg("gl error\n");
+                ret = 1;
+            }
+            gs_release();
+        } else {
+            err_msg("cannot set up the GLES2 side\n");
+            ret = 1;
+        }
+        egl.release();
+        memstat_sample(&mem, "gles");
+    }
+
+    print_comparison();
+    memstat_sample(&mem, "end");
+    memstat_report(&mem, "cogl_gles_bench");
+    memstat_release(&mem);
+    return ret;
+}
@@ -1,9 +1,18 @@
 #include <glib.h>
 #include <cstdlib>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
 #define COGL_ENABLE_EXPERIMENTAL_2_0_API
 #include <cogl/cogl.h>
 
+#include "benchutil.h"
+#include "memstat.h"
+#include "benchresult.h"
+
 #define FB_WIDTH 512
 #define FB_HEIGHT 512
 
@@ -109,14 +118,429 @@ static CoglTexture * test_texture_new_with_size(CoglContext *ctx,
   return tex;
 }
 
+/**
+ * compositor workload: wallpaper, a full screen video layer, N window
+ * textures stacked with premultiplied alpha and a dock whose background is
+ * blurred from what is behind it, the way our desktop draws a frame. all
+ * of it goes through Cogl pipelines into an offscreen framebuffer at
+ * monitor resolution. the window count is swept to see how frame time
+ * scales, and from that how many windows still fit in a 60 fps frame.
+ */
+static struct {
+    bool enabled;
+    int width, height;
+    int max_windows;
+    int frames;
+    int blur_passes;
+    bool video;
+} comp_opts = {
+    false, 1920, 1080, 32, 120, 2, true,
+};
+
+static const int VIDEO_WIDTH = 1920, VIDEO_HEIGHT = 1080;
+static const int VIDEO_FRAMES = 4;
+static const int DOCK_HEIGHT = 72;
+static const double FRAME_BUDGET_MS = 1000.0 / 60;
+
+// 9 tap gaussian folded into 5 fetches by sampling between texels
+static const char *blur_decl = "uniform vec2 blur_step;\n";
+static const char *blur_lookup =
+    "vec2 st = cogl_tex_coord.st;\n"
+    "cogl_texel = texture2D(cogl_sampler, st) * 0.2270270270;\n"
+    "cogl_texel += (texture2D(cogl_sampler, st + blur_step * 1.3846153846) +\n"
+    "    texture2D(cogl_sampler, st - blur_step * 1.3846153846)) * 0.3162162162;\n"
+    "cogl_texel += (texture2D(cogl_sampler, st + blur_step * 3.2307692308) +\n"
+    "    texture2D(cogl_sampler, st - blur_step * 3.2307692308)) * 0.0702702703;\n";
+
+struct CompWindow {
+    CoglTexture *tex;
+    CoglPipeline *pipeline;
+    float x, y, w, h;
+};
+
+struct BlurTarget {
+    CoglTexture *tex {nullptr};
+    CoglFramebuffer *fb {nullptr};
+    int w {0}, h {0};
+};
+
+struct Compositor {
+    CoglFramebuffer *fb {nullptr};
+    CoglTexture *fb_tex {nullptr};
+
+    CoglPipeline *wallpaper {nullptr};
+    CoglTexture *wallpaper_tex {nullptr};
+
+    CoglTexture *video_tex {nullptr};
+    CoglPipeline *video {nullptr};
+    std::vector<std::vector<uint8_t> > video_frames;
+
+    std::vector<CompWindow> windows;
+
+    BlurTarget blur[2];
+    CoglPipeline *blur_pass[2] {nullptr, nullptr};  // horizontal, vertical
+    CoglPipeline *dock_copy {nullptr};
+    CoglPipeline *dock_tint {nullptr};
+    float dock_x {0}, dock_y {0}, dock_w {0}, dock_h {0};
+};
+
+static CoglTexture *texture_from_pixels(int w, int h, const uint8_t *pixels)
+{
+    CoglError *error = NULL;
+    CoglTexture2D *tex = cogl_texture_2d_new_from_data(test_ctx, w, h,
+            COGL_PIXEL_FORMAT_RGBA_8888_PRE, w * 4, pixels, &error);
+    if (!tex) {
+        g_message("Failed to create %dx%d texture: %s", w, h, error->message);
+        cogl_error_free(error);
+        return NULL;
+    }
+    return COGL_TEXTURE(tex);
+}
+
+// window contents: title bar, a body gradient and a soft premultiplied
+// shadow around it, which is what makes every window need blending
+static std::vector<uint8_t> window_pixels(int w, int h, int seed)
+{
+    const int shadow = 16, title = 32;
+    std::vector<uint8_t> px(w * h * 4);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            uint8_t *p = &px[(y * w + x) * 4];
+            int edge = std::min(std::min(x, w - 1 - x), std::min(y, h - 1 - y));
+            if (edge < shadow) {
+                uint8_t a = (uint8_t)(96 * edge / shadow);
+                p[0] = p[1] = p[2] = 0;
+                p[3] = a;
+            } else if (y < shadow + title) {
+                p[0] = 48; p[1] = 48; p[2] = (uint8_t)(64 + seed * 16); p[3] = 255;
+            } else {
+                p[0] = (uint8_t)(x * 255 / w);
+                p[1] = (uint8_t)(y * 255 / h);
+                p[2] = (uint8_t)(seed * 37);
+                p[3] = 255;
+            }
+        }
+    }
+    return px;
+}
+
+static CoglPipeline *opaque_pipeline(CoglTexture *tex)
+{
+    CoglPipeline *p = cogl_pipeline_new(test_ctx);
+    cogl_pipeline_set_layer_texture(p, 0, tex);
+    cogl_pipeline_set_layer_filters(p, 0, COGL_PIPELINE_FILTER_LINEAR,
+            COGL_PIPELINE_FILTER_LINEAR);
+    cogl_pipeline_set_layer_wrap_mode(p, 0, COGL_PIPELINE_WRAP_MODE_CLAMP_TO_EDGE);
+    cogl_pipeline_set_blend(p, "RGBA = ADD(SRC_COLOR, 0)", NULL);
+    return p;
+}
+
+static bool blur_target_init(BlurTarget *bt, int w, int h)
+{
+    CoglError *error = NULL;
+    bt->w = w;
+    bt->h = h;
+    bt->tex = COGL_TEXTURE(cogl_texture_2d_new_with_size(test_ctx, w, h));
+    bt->fb = COGL_FRAMEBUFFER(cogl_offscreen_new_with_texture(bt->tex));
+    if (!cogl_framebuffer_allocate(bt->fb, &error)) {
+        g_message("Failed to allocate blur target: %s", error->message);
+        cogl_error_free(error);
+        return false;
+    }
+    cogl_framebuffer_orthographic(bt->fb, 0, 0, w, h, -1, 100);
+    return true;
+}
+
+static bool compositor_init(Compositor *c)
+{
+    int W = comp_opts.width, H = comp_opts.height;
+    CoglError *error = NULL;
+
+    c->fb_tex = COGL_TEXTURE(cogl_texture_2d_new_with_size(test_ctx, W, H));
+    c->fb = COGL_FRAMEBUFFER(cogl_offscreen_new_with_texture(c->fb_tex));
+    if (!cogl_framebuffer_allocate(c->fb, &error)) {
+        g_message("Failed to allocate %dx%d framebuffer: %s", W, H, error->message);
+        cogl_error_free(error);
+        return false;
+    }
+    cogl_framebuffer_orthographic(c->fb, 0, 0, W, H, -1, 100);
+
+    std::vector<uint8_t> px(W * H * 4);
+    for (int i = 0; i < W * H; i++) {
+        int x = i % W, y = i / W;
+        px[i*4+0] = (uint8_t)(20 + x * 60 / W);
+        px[i*4+1] = (uint8_t)(40 + y * 80 / H);
+        px[i*4+2] = (uint8_t)(120 + ((x ^ y) & 31));
+        px[i*4+3] = 255;
+    }
+    c->wallpaper_tex = texture_from_pixels(W, H, px.data());
+    if (!c->wallpaper_tex) return false;
+    c->wallpaper = opaque_pipeline(c->wallpaper_tex);
+
+    // decoded frames cycle so generating them stays out of the frame time
+    c->video_frames.resize(VIDEO_FRAMES);
+    for (int f = 0; f < VIDEO_FRAMES; f++) {
+        std::vector<uint8_t>& v = c->video_frames[f];
+        v.resize(VIDEO_WIDTH * VIDEO_HEIGHT * 4);
+        for (int i = 0; i < VIDEO_WIDTH * VIDEO_HEIGHT; i++) {
+            int x = i % VIDEO_WIDTH, y = i / VIDEO_WIDTH;
+            v[i*4+0] = (uint8_t)(x + f * 8);
+            v[i*4+1] = (uint8_t)(y + f * 4);
+            v[i*4+2] = (uint8_t)((x + y) >> 2);
+            v[i*4+3] = 255;
+        }
+    }
+    c->video_tex = texture_from_pixels(VIDEO_WIDTH, VIDEO_HEIGHT, c->video_frames[0].data());
+    if (!c->video_tex) return false;
+    c->video = opaque_pipeline(c->video_tex);
+
+    // sizes of the windows people actually keep open: browsers, terminals,
+    // file managers, dialogs
+    static const int sizes[][2] = {
+        {1280, 800}, {800, 600}, {1024, 768}, {640, 480},
+        {1440, 900}, {480, 320}, {960, 640}, {1600, 900},
+    };
+    CoglPipeline *window_template = cogl_pipeline_new(test_ctx);
+    cogl_pipeline_set_layer_filters(window_template, 0, COGL_PIPELINE_FILTER_LINEAR,
+            COGL_PIPELINE_FILTER_LINEAR);
+    uint32_t seed = 1;
+    for (int i = 0; i < comp_opts.max_windows; i++) {
+        CompWindow win;
+        win.w = std::min(sizes[i % 8][0], W);
+        win.h = std::min(sizes[i % 8][1], H);
+        seed = seed * 1103515245 + 12345;
+        win.x = (float)((seed >> 8) % (W - (int)win.w + 1));
+        seed = seed * 1103515245 + 12345;
+        win.y = (float)((seed >> 8) % (H - (int)win.h + 1));
+
+        std::vector<uint8_t> wpx = window_pixels((int)win.w, (int)win.h, i);
+        win.tex = texture_from_pixels((int)win.w, (int)win.h, wpx.data());
+        if (!win.tex) return false;
+        win.pipeline = cogl_pipeline_copy(window_template);
+        cogl_pipeline_set_layer_texture(win.pipeline, 0, win.tex);
+        // every fourth window is translucent, e.g. a terminal
+        if (i % 4 == 3) cogl_pipeline_set_color4f(win.pipeline, 0.85f, 0.85f, 0.85f, 0.85f);
+        c->windows.push_back(win);
+    }
+    cogl_object_unref(window_template);
+
+    c->dock_w = W * 0.6f;
+    c->dock_h = DOCK_HEIGHT;
+    c->dock_x = (W - c->dock_w) / 2;
+    c->dock_y = H - DOCK_HEIGHT - 8;
+
+    // the blur runs at half resolution like most compositors do it
+    for (int i = 0; i < 2; i++) {
+        if (!blur_target_init(&c->blur[i], (int)c->dock_w / 2, DOCK_HEIGHT / 2))
+            return false;
+    }
+    c->dock_copy = opaque_pipeline(c->fb_tex);
+
+    for (int dir = 0; dir < 2; dir++) {
+        // horizontal reads blur[0] into blur[1], vertical goes back
+        BlurTarget& src = c->blur[dir];
+        CoglPipeline *p = opaque_pipeline(src.tex);
+        CoglSnippet *snippet = cogl_snippet_new(COGL_SNIPPET_HOOK_TEXTURE_LOOKUP,
+                blur_decl, NULL);
+        cogl_snippet_set_replace(snippet, blur_lookup);
+        cogl_pipeline_add_layer_snippet(p, 0, snippet);
+        cogl_object_unref(snippet);
+
+        float step[2] = { dir == 0 ? 1.0f / src.w : 0.0f, dir == 1 ? 1.0f / src.h : 0.0f };
+        int loc = cogl_pipeline_get_uniform_location(p, "blur_step");
+        cogl_pipeline_set_uniform_float(p, loc, 2, 1, step);
+        c->blur_pass[dir] = p;
+    }
+
+    c->dock_tint = cogl_pipeline_new(test_ctx);
+    cogl_pipeline_set_layer_texture(c->dock_tint, 0, c->blur[0].tex);
+    cogl_pipeline_set_layer_filters(c->dock_tint, 0, COGL_PIPELINE_FILTER_LINEAR,
+            COGL_PIPELINE_FILTER_LINEAR);
+    // blurred background slightly darkened, fully opaque
+    cogl_pipeline_set_color4f(c->dock_tint, 0.7f, 0.7f, 0.7f, 1.0f);
+    return true;
+}
+
+static void compositor_release(Compositor *c)
+{
+    for (auto& win: c->windows) {
+        cogl_object_unref(win.pipeline);
+        cogl_object_unref(win.tex);
+    }
+    c->windows.clear();
+    for (int i = 0; i < 2; i++) {
+        if (c->blur_pass[i]) cogl_object_unref(c->blur_pass[i]);
+        if (c->blur[i].fb) cogl_object_unref(c->blur[i].fb);
+        if (c->blur[i].tex) cogl_object_unref(c->blur[i].tex);
+    }
+    void *objs[] = {
+        c->dock_copy, c->dock_tint, c->video, c->video_tex,
+        c->wallpaper, c->wallpaper_tex, c->fb, c->fb_tex,
+    };
+    for (auto obj: objs) {
+        if (obj) cogl_object_unref(obj);
+    }
+}
+
+static void compositor_frame(Compositor *c, int nwindows, int frame)
+{
+    int W = comp_opts.width, H = comp_opts.height;
+    CoglFramebuffer *fb = c->fb;
+
+    cogl_framebuffer_draw_rectangle(fb, c->wallpaper, 0, 0, W, H);
+
+    if (comp_opts.video) {
+        const std::vector<uint8_t>& v = c->video_frames[frame % VIDEO_FRAMES];
+        cogl_texture_set_region(c->video_tex, 0, 0, 0, 0, VIDEO_WIDTH, VIDEO_HEIGHT,
+                VIDEO_WIDTH, VIDEO_HEIGHT, COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                VIDEO_WIDTH * 4, v.data());
+        cogl_framebuffer_draw_rectangle(fb, c->video, 0, 0, W, H);
+    }
+
+    for (int i = 0; i < nwindows; i++) {
+        const CompWindow& win = c->windows[i];
+        cogl_framebuffer_draw_rectangle(fb, win.pipeline, win.x, win.y,
+                win.x + win.w, win.y + win.h);
+    }
+
+    // blur what ended up behind the dock, then put it back under the dock
+    cogl_framebuffer_draw_textured_rectangle(c->blur[0].fb, c->dock_copy,
+            0, 0, c->blur[0].w, c->blur[0].h,
+            c->dock_x / W, c->dock_y / H,
+            (c->dock_x + c->dock_w) / W, (c->dock_y + c->dock_h) / H);
+    for (int pass = 0; pass < comp_opts.blur_passes; pass++) {
+        cogl_framebuffer_draw_rectangle(c->blur[1].fb, c->blur_pass[0],
+                0, 0, c->blur[1].w, c->blur[1].h);
+        cogl_framebuffer_draw_rectangle(c->blur[0].fb, c->blur_pass[1],
+                0, 0, c->blur[0].w, c->blur[0].h);
+    }
+    cogl_framebuffer_draw_rectangle(fb, c->dock_tint, c->dock_x, c->dock_y,
+            c->dock_x + c->dock_w, c->dock_y + c->dock_h);
+}
+
+static int run_compositor(struct memstat *mem)
+{
+    Compositor comp;
+    if (!compositor_init(&comp)) {
+        compositor_release(&comp);
+        return 1;
+    }
+
+    bench_result_gl_driver();
+    printf("compositor: %dx%d, video %s, %d blur passes on a %dx%d dock, %d frames per step\n",
+            comp_opts.width, comp_opts.height, comp_opts.video ? "on" : "off",
+            comp_opts.blur_passes, (int)comp.dock_w, (int)comp.dock_h, comp_opts.frames);
+
+    std::vector<int> steps;
+    for (int n = 1; n < comp_opts.max_windows; n *= 2) steps.push_back(n);
+    steps.push_back(comp_opts.max_windows);
+
+    std::vector<double> counts, medians;
+    for (int n: steps) {
+        // shaders are generated and compiled on first use
+        for (int f = 0; f < 3; f++) compositor_frame(&comp, n, f);
+        cogl_framebuffer_finish(comp.fb);
+
+        std::vector<double> frame_ms, submit_ms;
+        frame_ms.reserve(comp_opts.frames);
+        submit_ms.reserve(comp_opts.frames);
+        for (int f = 0; f < comp_opts.frames; f++) {
+            uint64_t t0 = bench_now_ns();
+            // cogl batches rectangles in its journal, most gl calls
+            // happen when finish flushes it
+            compositor_frame(&comp, n, f);
+            uint64_t t1 = bench_now_ns();
+            cogl_framebuffer_finish(comp.fb);
+            uint64_t t2 = bench_now_ns();
+            submit_ms.push_back(bench_ns_to_ms(t1 - t0));
+            frame_ms.push_back(bench_ns_to_ms(t2 - t0));
+        }
+        memstat_sample(mem, "compositor");
+
+        char label[64];
+        struct bench_stats st, sub;
+        bench_stats_compute(submit_ms.data(), submit_ms.size(), &sub);
+        bench_stats_compute(frame_ms.data(), frame_ms.size(), &st);
+        snprintf(label, sizeof label, "%d windows", n);
+        bench_stats_print(label, "ms/frame", &st);
+        bench_result_record("cogl_test", label, "ms/frame", 1, frame_ms.data(),
+                frame_ms.size());
+        printf("%-24s record %.3f ms, %.1f fps, %s\n", "", sub.median,
+                1000.0 / st.median,
+                st.p95 <= FRAME_BUDGET_MS ? "fits 60 fps" : "MISSES 60 fps");
+        counts.push_back(n);
+        medians.push_back(st.median);
+    }
+
+    // least squares fit of frame time against window count
+    if (counts.size() >= 2) {
+        double sx = 0, sy = 0, sxx = 0, sxy = 0, k = counts.size();
+        for (size_t i = 0; i < counts.size(); i++) {
+            sx += counts[i];
+            sy += medians[i];
+            sxx += counts[i] * counts[i];
+            sxy += counts[i] * medians[i];
+        }
+        double slope = (k * sxy - sx * sy) / (k * sxx - sx * sx);
+        double base = (sy - slope * sx) / k;
+        printf("scaling: %.3f ms base + %.3f ms per window", base, slope);
+        if (base > FRAME_BUDGET_MS) printf(", 60 fps out of reach even without windows\n");
+        else if (slope > 0) printf(", about %d windows fit in 60 fps\n",
+                (int)((FRAME_BUDGET_MS - base) / slope));
+        else printf("\n");
+    }
+
+    compositor_release(&comp);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-w] [-s WxH] [-n max_windows] [-f frames] "
+            "[-b blur_passes] [-V]\n"
+            "  -w runs the compositor workload after the feature checks, "
+            "-V leaves out the video layer\n", prog);
+    exit(1);
+}
+
 int main(int argc, char *argv[])
 {
+    int c;
+    while ((c = getopt(argc, argv, "ws:n:f:b:V")) != -1) {
+        switch (c) {
+            case 'w': comp_opts.enabled = true; break;
+            case 's':
+                if (sscanf(optarg, "%dx%d", &comp_opts.width, &comp_opts.height) != 2)
+                    usage(argv[0]);
+                break;
+            case 'n': comp_opts.max_windows = atoi(optarg); break;
+            case 'f': comp_opts.frames = atoi(optarg); break;
+            case 'b': comp_opts.blur_passes = atoi(optarg); break;
+            case 'V': comp_opts.video = false; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (comp_opts.width <= 0 || comp_opts.height <= DOCK_HEIGHT ||
+            comp_opts.max_windows <= 0 || comp_opts.frames <= 0 ||
+            comp_opts.blur_passes < 0)
+        usage(argv[0]);
+
+    struct memstat mem = {0};
+    memstat_sample(&mem, "start");
     init();
+    memstat_sample(&mem, "init");
 
     CoglTexture* tex = test_texture_new_with_size(test_ctx, 
             1440, 900, COGL_TEXTURE_COMPONENTS_RGBA);
+    memstat_sample(&mem, "texture");
     cogl_object_unref(tex);
 
+    int ret = 0;
+    if (comp_opts.enabled) ret = run_compositor(&mem);
+
     cleanup();
-    return 0;
+    memstat_sample(&mem, "cleanup");
+    memstat_report(&mem, "cogl_test");
+    memstat_release(&mem);
+    return ret;
 }
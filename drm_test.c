@@ -9,6 +9,10 @@
 #include <string.h>
 #include <stdio.h>
 #include <sys/mman.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <poll.h>
+#include <pthread.h>
 
 #include <X11/Xlib.h>
 
@@ -23,6 +27,9 @@
 //compile using c++!
 #include <libdrm/nouveau_drm.h>
 #include <libdrm/vmwgfx_drm.h>
+#include <libdrm/drm_fourcc.h>
+#include <amdgpu.h>
+#include <nouveau.h>
 
 //include gbm before gl header
 #include <gbm.h>
@@ -31,6 +38,14 @@
 
 #include <EGL/egl.h>
 
+#include "benchutil.h"
+#include "memstat.h"
+#include "gputrace.h"
+#include "benchresult.h"
+#include "pixelops.h"
+#include "framepace.h"
+#include "powerstat.h"
+
 struct DisplayContext {
     int fd;                                 //drm device handle
     EGLDisplay display;
@@ -54,6 +69,42 @@ struct DisplayContext {
     int paused;
 } dc = {-1, 0, };
 
+static struct memstat mem;
+static struct powerstat power;
+static const char *power_test;      // key of the running test
+static char power_label[64];
+
+// samples the card behind fd, the device the test actually opened, until
+// power_detach. a test moving on to another device reports the last one first
+static void power_detach(void)
+{
+    if (!power.running) return;
+    powerstat_stop(&power);
+    powerstat_report(&power, "drm_test", power_label);
+}
+
+static void power_attach(int fd, const char *device)
+{
+    power_detach();
+    powerstat_release(&power);
+    if (powerstat_open_fd(&power, NULL, fd)) return;
+    if (device)
+        snprintf(power_label, sizeof power_label, "%s %s", power_test, device);
+    else
+        snprintf(power_label, sizeof power_label, "%s", power_test);
+    powerstat_start(&power, 50);
+}
+
+// set with -t, every test then adds its events to one trace
+static const char *trace_path;
+static struct trace trace;
+
+enum {
+    TRACK_CPU = 1,
+    TRACK_GPU,
+    TRACK_FLIPS,                // one per output from here on
+};
+
 static void err_msg(const char *fmt, ...)
 {
     va_list ap;
@@ -128,6 +179,7 @@ static int setup_drm()
         }
 
         dc.fd = fd;
+        power_attach(fd, NULL);
         err_msg("setup to test card%d\n", i);
         break;
     }
@@ -181,21 +233,27 @@ static int setup_drm()
     return 0;
 }
 
+static EGLConfig match_config(EGLDisplay display, uint32_t format);
+
 /**
  * basically, if we can create an egl context, that means (I assume) drm hardware 
  * acceleration is working.
  */
-static void setup_egl()
+static int setup_egl()
 {
     dc.gbm = gbm_create_device(dc.fd);
+    if (!dc.gbm) {
+        err_msg("gbm_create_device failed\n");
+        return 1;
+    }
     printf("backend name: %s\n", gbm_device_get_backend_name(dc.gbm));
 
     dc.gbm_surface = gbm_surface_create(dc.gbm, dc.mode.hdisplay,
             dc.mode.vdisplay, GBM_FORMAT_XRGB8888,
             GBM_BO_USE_SCANOUT | GBM_BO_USE_RENDERING);
     if (!dc.gbm_surface) {
-        printf("cannot create gbm surface (%d): %m", errno);
-        exit(-EFAULT);
+        err_msg("cannot create gbm surface: %s\n", strerror(errno));
+        return 1;
     }
 
 
@@ -203,63 +261,57 @@ static void setup_egl()
     EGLint minor;
     const char *ver, *extensions, *apis;
 
-    static const EGLint conf_att[] = {
-        EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
-        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
-        EGL_RED_SIZE, 1,
-        EGL_GREEN_SIZE, 1,
-        EGL_BLUE_SIZE, 1,
-        EGL_ALPHA_SIZE, 0,
-        EGL_DEPTH_SIZE, 1,
-        EGL_NONE,
-    };
     static const EGLint ctx_att[] = {
         EGL_CONTEXT_CLIENT_VERSION, 2,
         EGL_NONE
     };
 
     dc.display = eglGetDisplay(dc.gbm);
-    eglInitialize(dc.display, &major, &minor);
+    if (!eglInitialize(dc.display, &major, &minor)) {
+        err_msg("cannot initialize EGL on gbm\n");
+        return 1;
+    }
     ver = eglQueryString(dc.display, EGL_VERSION);
     extensions = eglQueryString(dc.display, EGL_EXTENSIONS);
     apis = eglQueryString(dc.display, EGL_CLIENT_APIS);
     err_msg("ver: %s, ext: %s, apis: %s\n", ver, extensions, apis);
 
     if (!strstr(extensions, "EGL_KHR_surfaceless_context")) {
-        err_quit("%s\n", "need EGL_KHR_surfaceless_context extension");
-        exit(1);
+        err_msg("%s\n", "need EGL_KHR_surfaceless_context extension");
+        return 1;
     }
 
     if (!eglBindAPI(EGL_OPENGL_ES_API)) {
-        err_quit("bind api failed\n");
-        exit(-1);
+        err_msg("bind api failed\n");
+        return 1;
     }
 
-    EGLConfig conf;
-    int num_conf;
-    EGLBoolean ret = eglChooseConfig(dc.display, conf_att, &conf, 1, &num_conf);
-    if (!ret || num_conf != 1) {
-        printf("cannot find a proper EGL framebuffer configuration");
-        exit(-1);
+    // the first config may not scan out as the surface's format
+    EGLConfig conf = match_config(dc.display, GBM_FORMAT_XRGB8888);
+    if (!conf) {
+        err_msg("no EGL config for GBM_FORMAT_XRGB8888\n");
+        return 1;
     }
 
     dc.gl_context = eglCreateContext(dc.display, conf, EGL_NO_CONTEXT, ctx_att);
     if (dc.gl_context == EGL_NO_CONTEXT) {
-        printf("no context created.\n"); exit(0);
+        err_msg("no context created.\n");
+        return 1;
     }
 
     dc.surface = eglCreateWindowSurface(dc.display, conf,
             (EGLNativeWindowType)dc.gbm_surface,
             NULL);
     if (dc.surface == EGL_NO_SURFACE) {
-        printf("cannot create EGL window surface");
-        exit(-1);
+        err_msg("cannot create EGL window surface\n");
+        return 1;
     }
 
     if (!eglMakeCurrent(dc.display, dc.surface, dc.surface, dc.gl_context)) {
-        printf("cannot activate EGL context");
-        exit(-1);
+        err_msg("cannot activate EGL context\n");
+        return 1;
     }
+    return 0;
 }
 
 static void modeset_page_flip_event(int fd, unsigned int frame,
@@ -284,19 +336,20 @@ static void cleanup()
                 break;
         }
 
-        eglDestroySurface(dc.display, dc.surface);
-        eglDestroyContext(dc.display, dc.gl_context);
-        eglTerminate(dc.display);
+        if (dc.display) {
+            eglMakeCurrent(dc.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (dc.surface) eglDestroySurface(dc.display, dc.surface);
+            if (dc.gl_context) eglDestroyContext(dc.display, dc.gl_context);
+            eglTerminate(dc.display);
+        }
 
         if (dc.bo) {
             gbm_bo_destroy(dc.bo);
             gbm_bo_destroy(dc.next_bo);
         }
 
-        if (dc.gbm_surface) {
-            gbm_surface_destroy(dc.gbm_surface);
-            gbm_device_destroy(dc.gbm);
-        }
+        if (dc.gbm_surface) gbm_surface_destroy(dc.gbm_surface);
+        gbm_device_destroy(dc.gbm);
     }
 
     if (dc.fd >= 0) {
@@ -434,6 +487,7 @@ static int TestGEM()
             }
 
             err_msg("do gem test with %s...\n", ver->name);
+            power_attach(fd, card + strlen("/dev/dri/"));
             int ret = doGEM(ver->name, fd);
             drmFreeVersion(ver);
             close(fd);
@@ -448,6 +502,448 @@ static int TestGEM()
     return 0;
 }
 
+/**
+ * allocator churn: a sliding window of live buffers where every step
+ * allocates a buffer of a size drawn from a mixed distribution, maps it,
+ * touches its first and last page and releases the oldest buffer. the
+ * generic backend only needs DRM_IOCTL_MODE_CREATE_DUMB (works on vgem),
+ * the others go through the driver's own allocator where one exists.
+ */
+#define CHURN_OPS 4000
+#define CHURN_WINDOW 64
+
+struct GemBo {
+    uint64_t size;
+    uint32_t handle;
+    void *drv;                  // driver library's bo, if any
+};
+
+struct GemBackend {
+    const char *name;
+    const char *driver;         // drm driver name, NULL for any
+    int (*init)(int fd, void **priv);
+    int (*alloc)(void *priv, uint64_t size, struct GemBo *bo);
+    void *(*map)(void *priv, struct GemBo *bo);
+    void (*unmap)(void *priv, struct GemBo *bo, void *ptr);
+    void (*release)(void *priv, struct GemBo *bo);
+    void (*fini)(void *priv);
+};
+
+struct FdPriv { int fd; };
+
+static int fd_init(int fd, void **priv)
+{
+    struct FdPriv *p = calloc(1, sizeof *p);
+    p->fd = fd;
+    *priv = p;
+    return 0;
+}
+
+static int dumb_init(int fd, void **priv)
+{
+    uint64_t has_dumb = 0;
+    // vgem has no kms and does not report the cap, just try it there
+    if (drmGetCap(fd, DRM_CAP_DUMB_BUFFER, &has_dumb) == 0 && !has_dumb)
+        return 1;
+    return fd_init(fd, priv);
+}
+
+static int dumb_alloc(void *priv, uint64_t size, struct GemBo *bo)
+{
+    struct FdPriv *p = priv;
+    struct drm_mode_create_dumb creq;
+    memset(&creq, 0, sizeof creq);
+    // dumb buffers are 2d, pick a 4k pitch and enough rows
+    creq.width = 1024;
+    creq.bpp = 32;
+    creq.height = (size + 4095) / 4096;
+    if (drmIoctl(p->fd, DRM_IOCTL_MODE_CREATE_DUMB, &creq) < 0)
+        return 1;
+
+    bo->handle = creq.handle;
+    bo->size = creq.size;
+    return 0;
+}
+
+static void *dumb_map(void *priv, struct GemBo *bo)
+{
+    struct FdPriv *p = priv;
+    struct drm_mode_map_dumb mreq;
+    memset(&mreq, 0, sizeof mreq);
+    mreq.handle = bo->handle;
+    if (drmIoctl(p->fd, DRM_IOCTL_MODE_MAP_DUMB, &mreq) < 0)
+        return NULL;
+
+    void *ptr = mmap(0, bo->size, PROT_READ|PROT_WRITE, MAP_SHARED, p->fd, mreq.offset);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+static void dumb_unmap(void *priv, struct GemBo *bo, void *ptr)
+{
+    munmap(ptr, bo->size);
+}
+
+static void dumb_release(void *priv, struct GemBo *bo)
+{
+    struct FdPriv *p = priv;
+    struct drm_mode_destroy_dumb dreq = { bo->handle };
+    drmIoctl(p->fd, DRM_IOCTL_MODE_DESTROY_DUMB, &dreq);
+}
+
+static void plain_fini(void *priv)
+{
+    free(priv);
+}
+
+static int intel_init_common(int fd, void **priv, int reuse)
+{
+    drm_intel_bufmgr *bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+    if (!bufmgr) return 1;
+    if (reuse) drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+    *priv = bufmgr;
+    return 0;
+}
+
+static int intel_init(int fd, void **priv) { return intel_init_common(fd, priv, 0); }
+static int intel_init_reuse(int fd, void **priv) { return intel_init_common(fd, priv, 1); }
+
+static int intel_alloc(void *priv, uint64_t size, struct GemBo *bo)
+{
+    drm_intel_bo *ibo = drm_intel_bo_alloc(priv, "churn", size, 0);
+    if (!ibo) return 1;
+    bo->drv = ibo;
+    bo->size = ibo->size;
+    return 0;
+}
+
+static void *intel_map(void *priv, struct GemBo *bo)
+{
+    drm_intel_bo *ibo = bo->drv;
+    if (drm_intel_bo_map(ibo, 1)) return NULL;
+    return ibo->virtual;
+}
+
+static void intel_unmap(void *priv, struct GemBo *bo, void *ptr)
+{
+    drm_intel_bo_unmap(bo->drv);
+}
+
+static void intel_release(void *priv, struct GemBo *bo)
+{
+    drm_intel_bo_unreference(bo->drv);
+}
+
+static void intel_fini(void *priv)
+{
+    drm_intel_bufmgr_destroy(priv);
+}
+
+static int radeon_alloc(void *priv, uint64_t size, struct GemBo *bo)
+{
+    struct FdPriv *p = priv;
+    struct drm_radeon_gem_create creq;
+    memset(&creq, 0, sizeof creq);
+    creq.size = (size + 4095) & ~4095ull;
+    creq.alignment = 4096;
+    creq.initial_domain = RADEON_GEM_DOMAIN_GTT;
+    if (drmCommandWriteRead(p->fd, DRM_RADEON_GEM_CREATE, &creq, sizeof creq) < 0)
+        return 1;
+    bo->handle = creq.handle;
+    bo->size = creq.size;
+    return 0;
+}
+
+static void *radeon_map(void *priv, struct GemBo *bo)
+{
+    struct FdPriv *p = priv;
+    struct drm_radeon_gem_mmap mreq;
+    memset(&mreq, 0, sizeof mreq);
+    mreq.handle = bo->handle;
+    mreq.size = bo->size;
+    if (drmCommandWriteRead(p->fd, DRM_RADEON_GEM_MMAP, &mreq, sizeof mreq) < 0)
+        return NULL;
+
+    void *ptr = mmap(0, bo->size, PROT_READ|PROT_WRITE, MAP_SHARED, p->fd, mreq.addr_ptr);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+static void gem_close_release(void *priv, struct GemBo *bo)
+{
+    struct FdPriv *p = priv;
+    struct drm_gem_close clreq;
+    memset(&clreq, 0, sizeof clreq);
+    clreq.handle = bo->handle;
+    drmIoctl(p->fd, DRM_IOCTL_GEM_CLOSE, &clreq);
+}
+
+static int amdgpu_init(int fd, void **priv)
+{
+    uint32_t major, minor;
+    amdgpu_device_handle dev;
+    if (amdgpu_device_initialize(fd, &major, &minor, &dev)) return 1;
+    *priv = dev;
+    return 0;
+}
+
+static int amdgpu_alloc(void *priv, uint64_t size, struct GemBo *bo)
+{
+    struct amdgpu_bo_alloc_request req;
+    amdgpu_bo_handle abo;
+    memset(&req, 0, sizeof req);
+    req.alloc_size = size;
+    req.phys_alignment = 4096;
+    req.preferred_heap = AMDGPU_GEM_DOMAIN_GTT;
+    if (amdgpu_bo_alloc(priv, &req, &abo)) return 1;
+    bo->drv = abo;
+    bo->size = size;
+    return 0;
+}
+
+static void *amdgpu_map(void *priv, struct GemBo *bo)
+{
+    void *ptr = NULL;
+    return amdgpu_bo_cpu_map(bo->drv, &ptr) ? NULL : ptr;
+}
+
+static void amdgpu_unmap(void *priv, struct GemBo *bo, void *ptr)
+{
+    amdgpu_bo_cpu_unmap(bo->drv);
+}
+
+static void amdgpu_release(void *priv, struct GemBo *bo)
+{
+    amdgpu_bo_free(bo->drv);
+}
+
+static void amdgpu_fini(void *priv)
+{
+    amdgpu_device_deinitialize(priv);
+}
+
+struct NouveauPriv {
+    struct nouveau_device *dev;
+    struct nouveau_client *client;
+};
+
+static int nouveau_init(int fd, void **priv)
+{
+    struct NouveauPriv *p = calloc(1, sizeof *p);
+    if (nouveau_device_wrap(fd, 0, &p->dev) || nouveau_client_new(p->dev, &p->client)) {
+        if (p->dev) nouveau_device_del(&p->dev);
+        free(p);
+        return 1;
+    }
+    *priv = p;
+    return 0;
+}
+
+static int nouveau_alloc(void *priv, uint64_t size, struct GemBo *bo)
+{
+    struct NouveauPriv *p = priv;
+    struct nouveau_bo *nbo = NULL;
+    if (nouveau_bo_new(p->dev, NOUVEAU_BO_GART | NOUVEAU_BO_MAP, 0, size, NULL, &nbo))
+        return 1;
+    bo->drv = nbo;
+    bo->size = size;
+    return 0;
+}
+
+static void *nouveau_map(void *priv, struct GemBo *bo)
+{
+    struct NouveauPriv *p = priv;
+    struct nouveau_bo *nbo = bo->drv;
+    if (nouveau_bo_map(nbo, NOUVEAU_BO_WR, p->client)) return NULL;
+    return nbo->map;
+}
+
+static void nouveau_unmap(void *priv, struct GemBo *bo, void *ptr)
+{
+    // libdrm_nouveau keeps the mapping until the bo is freed
+}
+
+static void nouveau_release(void *priv, struct GemBo *bo)
+{
+    struct nouveau_bo *nbo = bo->drv;
+    nouveau_bo_ref(NULL, &nbo);
+}
+
+static void nouveau_fini(void *priv)
+{
+    struct NouveauPriv *p = priv;
+    nouveau_client_del(&p->client);
+    nouveau_device_del(&p->dev);
+    free(p);
+}
+
+static const struct GemBackend gem_backends[] = {
+    {"dumb", NULL, dumb_init, dumb_alloc, dumb_map, dumb_unmap, dumb_release, plain_fini},
+    {"i915-bufmgr", "i915", intel_init, intel_alloc, intel_map, intel_unmap,
+        intel_release, intel_fini},
+    {"i915-bufmgr-reuse", "i915", intel_init_reuse, intel_alloc, intel_map, intel_unmap,
+        intel_release, intel_fini},
+    {"radeon-gem", "radeon", fd_init, radeon_alloc, radeon_map, dumb_unmap,
+        gem_close_release, plain_fini},
+    {"amdgpu-bo", "amdgpu", amdgpu_init, amdgpu_alloc, amdgpu_map, amdgpu_unmap,
+        amdgpu_release, amdgpu_fini},
+    {"nouveau-bo", "nouveau", nouveau_init, nouveau_alloc, nouveau_map, nouveau_unmap,
+        nouveau_release, nouveau_fini},
+};
+
+// mostly small thumbnails and tiles, some frame sized, a few 4k planes
+static uint64_t churn_size(uint32_t *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    uint32_t r = (*seed >> 8) % 100;
+    uint32_t v = (*seed >> 4) & 0xffff;
+
+    if (r < 60) return 4096 + (v % 60) * 1024;              // 4k..64k
+    if (r < 90) return (256 << 10) + (v % 768) * 1024;      // 256k..1m
+    return (3 << 20) + (uint64_t)(v % 5) * (1 << 20);       // 3m..8m (1080p nv12..)
+}
+
+static int run_churn(int fd, const char *card, const struct GemBackend *be)
+{
+    void *priv = NULL;
+    if (be->init(fd, &priv)) {
+        err_msg("%s: %s backend not usable here, skipped\n", card, be->name);
+        return 0;
+    }
+
+    struct GemBo window[CHURN_WINDOW];
+    int live = 0, head = 0;
+    double *alloc_us = calloc(CHURN_OPS, sizeof(double));
+    double *map_us = calloc(CHURN_OPS, sizeof(double));
+    double *free_us = calloc(CHURN_OPS, sizeof(double));
+    size_t nfree = 0;
+    uint32_t seed = 0x5eed;
+    uint64_t bytes = 0;
+    int ret = 0, ops;
+
+    memset(window, 0, sizeof window);
+    uint64_t start = bench_now_ns();
+    for (ops = 0; ops < CHURN_OPS; ops++) {
+        if (live == CHURN_WINDOW) {
+            uint64_t t = bench_now_ns();
+            be->release(priv, &window[head]);
+            free_us[nfree++] = (bench_now_ns() - t) / 1e3;
+            live--;
+        }
+
+        struct GemBo *bo = &window[head];
+        memset(bo, 0, sizeof *bo);
+        uint64_t size = churn_size(&seed);
+
+        uint64_t t0 = bench_now_ns();
+        if (be->alloc(priv, size, bo)) {
+            err_msg("%s: %s alloc of %llu bytes failed: %s\n", card, be->name,
+                    (unsigned long long)size, strerror(errno));
+            ret = 1;
+            break;
+        }
+        uint64_t t1 = bench_now_ns();
+        char *ptr = be->map(priv, bo);
+        if (!ptr) {
+            err_msg("%s: %s map failed\n", card, be->name);
+            be->release(priv, bo);
+            ret = 1;
+            break;
+        }
+        // fault in the first and last page, like a decoder writing a frame
+        ptr[0] = 1;
+        ptr[bo->size - 1] = 1;
+        be->unmap(priv, bo, ptr);
+        uint64_t t2 = bench_now_ns();
+
+        alloc_us[ops] = (t1 - t0) / 1e3;
+        map_us[ops] = (t2 - t1) / 1e3;
+        bytes += bo->size;
+        live++;
+        head = (head + 1) % CHURN_WINDOW;
+
+        if (ops % 250 == 0) memstat_sample(&mem, be->name);
+    }
+    double secs = (bench_now_ns() - start) / 1e9;
+
+    // release what is still live, oldest first
+    for (int i = 0; i < live; i++) {
+        int idx = (head - live + i + CHURN_WINDOW) % CHURN_WINDOW;
+        be->release(priv, &window[idx]);
+    }
+    be->fini(priv);
+
+    if (!ret) {
+        struct bench_stats st;
+        char label[64];
+        drmVersionPtr ver = drmGetVersion(fd);
+        bench_result_driver(ver ? ver->name : "unknown");
+        if (ver) drmFreeVersion(ver);
+
+        snprintf(label, sizeof label, "%s alloc", be->name);
+        bench_result_record("drm_test", label, "us", 1, alloc_us, ops);
+        snprintf(label, sizeof label, "%s map+touch", be->name);
+        bench_result_record("drm_test", label, "us", 1, map_us, ops);
+        snprintf(label, sizeof label, "%s free", be->name);
+        bench_result_record("drm_test", label, "us", 1, free_us, nfree);
+
+        printf("%s %s: %d allocs in %.2f s, %.0f allocs/s, %.1f MB/s allocated\n",
+                card, be->name, ops, secs, ops / secs, bytes / secs / 1e6);
+        snprintf(label, sizeof label, "  %s alloc", be->name);
+        bench_stats_compute(alloc_us, ops, &st);
+        bench_stats_print(label, "us", &st);
+        snprintf(label, sizeof label, "  %s map+touch", be->name);
+        bench_stats_compute(map_us, ops, &st);
+        bench_stats_print(label, "us", &st);
+        snprintf(label, sizeof label, "  %s free", be->name);
+        bench_stats_compute(free_us, nfree, &st);
+        bench_stats_print(label, "us", &st);
+    }
+
+    free(alloc_us);
+    free(map_us);
+    free(free_us);
+    return ret;
+}
+
+static int TestGEMChurn()
+{
+    int tested = 0;
+    for (int i = 0; i < DRM_MAX_MINOR; i++) {
+        char card[128] = {0};
+        snprintf(card, 127, "/dev/dri/card%d", i);
+        if (access(card, R_OK)) continue;
+
+        int fd = open(card, O_RDWR|O_CLOEXEC);
+        if (fd < 0) {
+            err_msg("open '%s' failed: %s\n", card, strerror(errno));
+            continue;
+        }
+
+        drmVersionPtr ver = drmGetVersion(fd);
+        if (!ver) {
+            err_msg("drmGetVersion failed\n");
+            close(fd);
+            return 1;
+        }
+
+        err_msg("gem churn on %s (%s)\n", card, ver->name);
+        power_attach(fd, card + strlen("/dev/dri/"));
+        int ret = 0;
+        for (size_t b = 0; !ret && b < sizeof gem_backends / sizeof gem_backends[0]; b++) {
+            const struct GemBackend *be = &gem_backends[b];
+            if (be->driver && strcmp(be->driver, ver->name)) continue;
+            ret = run_churn(fd, card + strlen("/dev/dri/"), be);
+        }
+
+        drmFreeVersion(ver);
+        close(fd);
+        if (ret) return 1;
+        tested++;
+    }
+
+    if (!tested) err_msg("can not open any drm devices\n");
+    return tested ? 0 : 1;
+}
+
 static int TestDevs() 
 {
     //open default dri device
@@ -481,35 +977,1861 @@ static int TestRendering ()
     dc.fd = -1;
     if (setup_drm())
         return 1;
-    setup_egl();
+    // no connected connector is not an error, like kms
+    if (dc.fd < 0)
+        return 0;
+    int ret = setup_egl();
     cleanup();
 
-    return 0;
+    return ret;
 }
 
-int main(int argc, char *argv[])
+/**
+ * multi-head support: every connected connector gets its own crtc, gbm
+ * surface and page flip chain. flips complete through
+ * output_page_flip_event, which gets the Output as user data.
+ */
+#define MAX_OUTPUTS 8
+
+struct Output {
+    uint32_t conn;
+    uint32_t crtc;
+    drmModeModeInfo mode;
+    drmModeCrtc *saved_crtc;
+
+    struct gbm_surface *gbm_surface;
+    EGLSurface surface;
+    struct gbm_bo *bo;
+    struct gbm_bo *next_bo;
+
+    int active;
+    int pflip_pending;
+    long submitted;             // frame id of the next frame rendered
+    long flip_frame;
+    uint64_t flip_queued_ns;
+    int track;
+    unsigned int frames;
+    uint64_t last_flip_us;
+    double *intervals;          // ms between completed flips
+    size_t n_intervals;
+};
+
+struct MultiHead {
+    int fd;
+    int count;
+    struct Output outputs[MAX_OUTPUTS];
+
+    struct gbm_device *gbm;
+    EGLDisplay display;
+    EGLConfig config;
+    EGLContext gl_context;
+    struct gpu_timer gpu;
+
+    // frame content, a plain clear when NULL
+    void (*draw)(struct MultiHead *mh, struct Output *out, int idx);
+    void *draw_data;
+};
+
+static int open_first_card()
 {
-    
-    typedef int (*TestFunc)();
+    for (int i = 0; i < DRM_MAX_MINOR; i++) {
+        char card[128] = {0};
+        snprintf(card, 127, "/dev/dri/card%d", i);
+        if (access(card, R_OK)) continue;
 
-    struct TestCase {
-        const char* name; 
-        TestFunc cb;
-    } tests[] = {
-        {"test open all drm devices", TestDevs},
-        {"test kms", TestKMS},
-        {"test gem", TestGEM},
-        {"test rendering", TestRendering}
-    };
-    
-    int success = 0;
-    for (struct TestCase* tc = &tests[0]; tc != &tests[3]; tc++) {
-        err_msg("\e[38;5;226mstart %s\e[00m\n", tc->name);
-        if ((success = tc->cb())) {
-            err_msg("\e[38;5;160m%s failed\e[00m\n", tc->name);
-            break;
-        } 
+        int fd = open(card, O_RDWR|O_CLOEXEC|O_NONBLOCK);
+        if (fd < 0) {
+            err_msg("open '%s' failed: %s\n", card, strerror(errno));
+            continue;
+        }
+
+        drmModeRes *res = drmModeGetResources(fd);
+        if (!res) {
+            close(fd);
+            continue;
+        }
+        drmModeFreeResources(res);
+
+        if (drmSetMaster(fd)) {
+            err_msg("card%d: not drm master (%s), modesets may fail\n",
+                    i, strerror(errno));
+        }
+        power_attach(fd, NULL);
+        err_msg("setup to test card%d\n", i);
+        return fd;
+    }
+    return -1;
+}
+
+// first free crtc any encoder of the connector can drive, -1 if none
+static int pick_crtc(int fd, drmModeRes *res, drmModeConnector *conn,
+        uint32_t used_mask)
+{
+    for (int i = 0; i < conn->count_encoders; i++) {
+        drmModeEncoder *enc = drmModeGetEncoder(fd, conn->encoders[i]);
+        if (!enc) continue;
+
+        for (int j = 0; j < res->count_crtcs; j++) {
+            if ((enc->possible_crtcs & (1 << j)) && !(used_mask & (1 << j))) {
+                drmModeFreeEncoder(enc);
+                return j;
+            }
+        }
+        drmModeFreeEncoder(enc);
+    }
+    return -1;
+}
+
+static const drmModeModeInfo *preferred_mode(drmModeConnector *conn)
+{
+    for (int i = 0; i < conn->count_modes; i++) {
+        if (conn->modes[i].type & DRM_MODE_TYPE_PREFERRED)
+            return &conn->modes[i];
+    }
+    return &conn->modes[0];
+}
+
+// assigns distinct crtcs to connected connectors, returns output count
+static int find_outputs(struct MultiHead *mh)
+{
+    drmModeRes *res = drmModeGetResources(mh->fd);
+    if (!res) return 0;
+
+    uint32_t used = 0;
+    mh->count = 0;
+    for (int i = 0; i < res->count_connectors && mh->count < MAX_OUTPUTS; i++) {
+        drmModeConnector *conn = drmModeGetConnector(mh->fd, res->connectors[i]);
+        if (!conn) continue;
+
+        if (conn->connection == DRM_MODE_CONNECTED && conn->count_modes > 0) {
+            int idx = pick_crtc(mh->fd, res, conn, used);
+            if (idx < 0) {
+                err_msg("connector %u: no free crtc left\n", conn->connector_id);
+            } else {
+                struct Output *out = &mh->outputs[mh->count++];
+                memset(out, 0, sizeof *out);
+                used |= 1 << idx;
+                out->conn = conn->connector_id;
+                out->crtc = res->crtcs[idx];
+                out->mode = *preferred_mode(conn);
+                out->saved_crtc = drmModeGetCrtc(mh->fd, out->crtc);
+                out->surface = EGL_NO_SURFACE;
+            }
+        }
+        drmModeFreeConnector(conn);
+    }
+
+    drmModeFreeResources(res);
+    return mh->count;
+}
+
+static void restore_outputs(struct MultiHead *mh)
+{
+    for (int i = 0; i < mh->count; i++) {
+        struct Output *out = &mh->outputs[i];
+        drmModeCrtc *saved = out->saved_crtc;
+        if (saved) {
+            drmModeSetCrtc(mh->fd, saved->crtc_id, saved->buffer_id,
+                    saved->x, saved->y, &out->conn, saved->mode_valid ? 1 : 0,
+                    saved->mode_valid ? &saved->mode : NULL);
+            drmModeFreeCrtc(saved);
+            out->saved_crtc = NULL;
+        }
+        free(out->intervals);
+        out->intervals = NULL;
     }
+}
 
+static void output_page_flip_event(int fd, unsigned int frame,
+        unsigned int sec, unsigned int usec, void *data)
+{
+    struct Output *out = data;
+    uint64_t now_us = (uint64_t)sec * 1000000 + usec;
+
+    // flip timestamps are CLOCK_MONOTONIC like bench_now_ns()
+    if (trace_path && out->track) {
+        trace_complete(&trace, out->track, "flip", out->flip_frame,
+                out->flip_queued_ns, now_us * 1000);
+    }
+
+    if (out->last_flip_us && out->intervals) {
+        out->intervals[out->n_intervals++] = (now_us - out->last_flip_us) / 1000.0;
+    }
+    out->last_flip_us = now_us;
+    out->frames++;
+    out->pflip_pending = 0;
+
+    if (out->next_bo) {
+        if (out->bo) gbm_surface_release_buffer(out->gbm_surface, out->bo);
+        out->bo = out->next_bo;
+        out->next_bo = NULL;
+    }
+}
+
+// dispatches drm events until no flip is pending or timeout_ms passes
+static int wait_flips(int fd, struct Output *outs, int n, int timeout_ms)
+{
+    drmEventContext ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.version = DRM_EVENT_CONTEXT_VERSION;
+    ev.page_flip_handler = output_page_flip_event;
+
+    uint64_t deadline = bench_now_ns() + timeout_ms * 1000000ull;
+    for (;;) {
+        int pending = 0;
+        for (int i = 0; i < n; i++) pending += outs[i].pflip_pending;
+        if (!pending) return 0;
+
+        uint64_t now = bench_now_ns();
+        if (now >= deadline) return 1;
+
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int ret = poll(&pfd, 1, (deadline - now) / 1000000 + 1);
+        if (ret < 0 && errno != EINTR) return 1;
+        if (ret > 0) drmHandleEvent(fd, &ev);
+    }
+}
+
+static void fb_destroy_callback(struct gbm_bo *bo, void *data)
+{
+    uint32_t fb_id = (uint32_t)(uintptr_t)data;
+    drmModeRmFB(gbm_device_get_fd(gbm_bo_get_device(bo)), fb_id);
+}
+
+// framebuffer for a bo, created once and cached as the bo's user data. the
+// format and every plane come from the bo, explicit modifiers are passed
+// on when the kernel takes them.
+static uint32_t bo_get_fb(struct gbm_bo *bo)
+{
+    uint32_t fb_id = (uint32_t)(uintptr_t)gbm_bo_get_user_data(bo);
+    if (fb_id) return fb_id;
+
+    int fd = gbm_device_get_fd(gbm_bo_get_device(bo));
+    uint32_t handles[4] = {0}, pitches[4] = {0}, offsets[4] = {0};
+    uint64_t modifiers[4] = {0};
+    uint64_t modifier = gbm_bo_get_modifier(bo);
+    for (int i = 0; i < gbm_bo_get_plane_count(bo) && i < 4; i++) {
+        handles[i] = gbm_bo_get_handle_for_plane(bo, i).u32;
+        pitches[i] = gbm_bo_get_stride_for_plane(bo, i);
+        offsets[i] = gbm_bo_get_offset(bo, i);
+        modifiers[i] = modifier;
+    }
+
+    uint64_t cap = 0;
+    int ret;
+    if (modifier != DRM_FORMAT_MOD_INVALID && !drmGetCap(fd, DRM_CAP_ADDFB2_MODIFIERS, &cap)
+            && cap) {
+        ret = drmModeAddFB2WithModifiers(fd, gbm_bo_get_width(bo), gbm_bo_get_height(bo),
+                gbm_bo_get_format(bo), handles, pitches, offsets, modifiers, &fb_id,
+                DRM_MODE_FB_MODIFIERS);
+    } else {
+        ret = drmModeAddFB2(fd, gbm_bo_get_width(bo), gbm_bo_get_height(bo),
+                gbm_bo_get_format(bo), handles, pitches, offsets, &fb_id, 0);
+    }
+    if (ret) {
+        err_msg("drmModeAddFB2 failed: %s\n", strerror(errno));
+        return 0;
+    }
+    gbm_bo_set_user_data(bo, (void*)(uintptr_t)fb_id, fb_destroy_callback);
+    return fb_id;
+}
+
+static int multihead_egl_display(struct MultiHead *mh)
+{
+    mh->gbm = gbm_create_device(mh->fd);
+    if (!mh->gbm) {
+        err_msg("gbm_create_device failed\n");
+        return 1;
+    }
+
+    EGLint major, minor;
+    mh->display = eglGetDisplay(mh->gbm);
+    if (!eglInitialize(mh->display, &major, &minor) || !eglBindAPI(EGL_OPENGL_ES_API)) {
+        err_msg("cannot initialize EGL on gbm\n");
+        return 1;
+    }
+    return 0;
+}
+
+// a window config that scans out as the gbm format, not just the first one
+static EGLConfig match_config(EGLDisplay display, uint32_t format)
+{
+    static const EGLint conf_att[] = {
+        EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_RED_SIZE, 1,
+        EGL_GREEN_SIZE, 1,
+        EGL_BLUE_SIZE, 1,
+        EGL_ALPHA_SIZE, 0,
+        EGL_NONE,
+    };
+
+    EGLConfig confs[128];
+    int num_conf = 0;
+    eglChooseConfig(display, conf_att, confs, 128, &num_conf);
+    for (int i = 0; i < num_conf; i++) {
+        EGLint id;
+        if (eglGetConfigAttrib(display, confs[i], EGL_NATIVE_VISUAL_ID, &id)
+                && (uint32_t)id == format) {
+            return confs[i];
+        }
+    }
+    return NULL;
+}
+
+static int setup_multihead_egl(struct MultiHead *mh)
+{
+    static const EGLint ctx_att[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+
+    if (multihead_egl_display(mh))
+        return 1;
+
+    mh->config = match_config(mh->display, GBM_FORMAT_XRGB8888);
+    if (!mh->config) {
+        err_msg("no EGL config for GBM_FORMAT_XRGB8888\n");
+        return 1;
+    }
+
+    mh->gl_context = eglCreateContext(mh->display, mh->config, EGL_NO_CONTEXT, ctx_att);
+    if (mh->gl_context == EGL_NO_CONTEXT) {
+        err_msg("no context created.\n");
+        return 1;
+    }
+
+    for (int i = 0; i < mh->count; i++) {
+        struct Output *out = &mh->outputs[i];
+        out->gbm_surface = gbm_surface_create(mh->gbm, out->mode.hdisplay,
+                out->mode.vdisplay, GBM_FORMAT_XRGB8888,
+                GBM_BO_USE_SCANOUT | GBM_BO_USE_RENDERING);
+        if (!out->gbm_surface) {
+            err_msg("cannot create gbm surface for crtc %u\n", out->crtc);
+            return 1;
+        }
+        out->surface = eglCreateWindowSurface(mh->display, mh->config,
+                (EGLNativeWindowType)out->gbm_surface, NULL);
+        if (out->surface == EGL_NO_SURFACE) {
+            err_msg("cannot create EGL window surface for crtc %u\n", out->crtc);
+            return 1;
+        }
+
+        if (trace_path) {
+            char name[64];
+            snprintf(name, sizeof name, "crtc %u flips", out->crtc);
+            out->track = TRACK_FLIPS + i;
+            trace_name_track(&trace, out->track, name);
+        }
+    }
+
+    // queries belong to the context, any of its surfaces will do
+    if (!eglMakeCurrent(mh->display, mh->outputs[0].surface, mh->outputs[0].surface,
+                mh->gl_context)) {
+        err_msg("cannot activate EGL context\n");
+        return 1;
+    }
+    gpu_timer_init(&mh->gpu, trace_path ? &trace : NULL, TRACK_GPU);
+    return 0;
+}
+
+static void cleanup_multihead(struct MultiHead *mh)
+{
+    wait_flips(mh->fd, mh->outputs, mh->count, 1000);
+
+    if (mh->display) {
+        if (mh->gl_context && eglMakeCurrent(mh->display, mh->outputs[0].surface,
+                    mh->outputs[0].surface, mh->gl_context)) {
+            gpu_timer_release(&mh->gpu);
+        }
+        eglMakeCurrent(mh->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+    for (int i = 0; i < mh->count; i++) {
+        struct Output *out = &mh->outputs[i];
+        if (out->surface != EGL_NO_SURFACE) eglDestroySurface(mh->display, out->surface);
+        if (out->bo) gbm_surface_release_buffer(out->gbm_surface, out->bo);
+        if (out->next_bo) gbm_surface_release_buffer(out->gbm_surface, out->next_bo);
+    }
+
+    // scanout has to move off our buffers before they go away
+    restore_outputs(mh);
+
+    for (int i = 0; i < mh->count; i++) {
+        if (mh->outputs[i].gbm_surface) gbm_surface_destroy(mh->outputs[i].gbm_surface);
+    }
+    if (mh->display) {
+        if (mh->gl_context) eglDestroyContext(mh->display, mh->gl_context);
+        eglTerminate(mh->display);
+    }
+    if (mh->gbm) gbm_device_destroy(mh->gbm);
+
+    drmDropMaster(mh->fd);
+    close(mh->fd);
+}
+
+// renders and queues the next frame of an output, returns non-zero on error
+static int output_present(struct MultiHead *mh, struct Output *out, int idx)
+{
+    long frame = out->submitted++;
+    uint64_t t0 = bench_now_ns();
+    if (!eglMakeCurrent(mh->display, out->surface, out->surface, mh->gl_context))
+        return 1;
+
+    float t = (out->frames % 120) / 120.0f;
+    gpu_timer_begin(&mh->gpu, "draw", frame);
+    glViewport(0, 0, out->mode.hdisplay, out->mode.vdisplay);
+    if (mh->draw) {
+        mh->draw(mh, out, idx);
+    } else {
+        glClearColor(idx & 1 ? t : 0.0f, idx & 2 ? t : 0.2f, 1.0f - t, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    gpu_timer_end(&mh->gpu);
+    uint64_t t1 = bench_now_ns();
+    eglSwapBuffers(mh->display, out->surface);
+    uint64_t t2 = bench_now_ns();
+    if (trace_path) {
+        trace_complete(&trace, TRACK_CPU, "render", frame, t0, t1);
+        trace_complete(&trace, TRACK_CPU, "swap", frame, t1, t2);
+    }
+
+    struct gbm_bo *bo = gbm_surface_lock_front_buffer(out->gbm_surface);
+    uint32_t fb_id = bo ? bo_get_fb(bo) : 0;
+    if (!fb_id) return 1;
+
+    if (!out->bo) {
+        // first frame on this crtc: modeset straight onto it
+        if (drmModeSetCrtc(mh->fd, out->crtc, fb_id, 0, 0, &out->conn, 1, &out->mode)) {
+            err_msg("drmModeSetCrtc on crtc %u failed: %s\n", out->crtc, strerror(errno));
+            return 1;
+        }
+        out->bo = bo;
+        return 0;
+    }
+
+    if (drmModePageFlip(mh->fd, out->crtc, fb_id, DRM_MODE_PAGE_FLIP_EVENT, out)) {
+        err_msg("drmModePageFlip on crtc %u failed: %s\n", out->crtc, strerror(errno));
+        gbm_surface_release_buffer(out->gbm_surface, bo);
+        return 1;
+    }
+    out->next_bo = bo;
+    out->pflip_pending = 1;
+    out->flip_frame = frame;
+    out->flip_queued_ns = bench_now_ns();
+    return 0;
+}
+
+// flips all active outputs as fast as they complete for `seconds`
+static int run_outputs(struct MultiHead *mh, double seconds)
+{
+    drmEventContext ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.version = DRM_EVENT_CONTEXT_VERSION;
+    ev.page_flip_handler = output_page_flip_event;
+
+    size_t max_intervals = (size_t)(seconds * 1000) + 16;
+    for (int i = 0; i < mh->count; i++) {
+        struct Output *out = &mh->outputs[i];
+        out->frames = 0;
+        out->last_flip_us = 0;
+        out->n_intervals = 0;
+        free(out->intervals);
+        out->intervals = calloc(max_intervals, sizeof(double));
+    }
+
+    uint64_t deadline = bench_now_ns() + (uint64_t)(seconds * 1e9);
+    uint64_t next_sample = 0;
+    while (bench_now_ns() < deadline) {
+        if (bench_now_ns() >= next_sample) {
+            memstat_sample(&mem, "flips");
+            next_sample = bench_now_ns() + 250000000ull;
+        }
+
+        for (int i = 0; i < mh->count; i++) {
+            struct Output *out = &mh->outputs[i];
+            if (!out->active || out->pflip_pending) continue;
+            if (out->n_intervals + 1 >= max_intervals) continue;
+            if (output_present(mh, out, i)) return 1;
+        }
+        gpu_timer_collect(&mh->gpu, 0);
+
+        struct pollfd pfd = { mh->fd, POLLIN, 0 };
+        int ret = poll(&pfd, 1, 100);
+        if (ret < 0 && errno != EINTR) return 1;
+        if (ret > 0) drmHandleEvent(mh->fd, &ev);
+    }
+
+    gpu_timer_collect(&mh->gpu, 1);
+    return wait_flips(mh->fd, mh->outputs, mh->count, 1000);
+}
+
+static double output_fps(const struct Output *out, double seconds)
+{
+    return out->frames / seconds;
+}
+
+static void print_output_stats(const char *label, struct Output *out)
+{
+    struct bench_stats st;
+    char name[64];
+    snprintf(name, sizeof name, "%s crtc %u", label, out->crtc);
+    bench_result_record("drm_test", name, "ms/flip", 1, out->intervals, out->n_intervals);
+    snprintf(name, sizeof name, "  %s crtc %u", label, out->crtc);
+    bench_stats_compute(out->intervals, out->n_intervals, &st);
+    bench_stats_print(name, "ms/flip", &st);
+}
+
+/**
+ * every connector lit at its preferred mode on its own crtc: each output
+ * alone first, then all at once. an output whose concurrent rate drops
+ * below 90% of its solo rate is reported as disturbed by the others.
+ */
+static int TestMultiCrtc()
+{
+    const double seconds = 3.0;
+    struct MultiHead mh;
+    memset(&mh, 0, sizeof mh);
+
+    if (!drmAvailable()) {
+        err_msg("drm not loaded\n");
+        return 1;
+    }
+    mh.fd = open_first_card();
+    if (mh.fd < 0) {
+        err_msg("can not open any drm devices\n");
+        return 1;
+    }
+
+    if (find_outputs(&mh) == 0) {
+        err_msg("No active connector found!\n");
+        close(mh.fd);
+        return 0;
+    }
+
+    int ret = setup_multihead_egl(&mh);
+    if (!ret) bench_result_gl_driver();
+    double solo[MAX_OUTPUTS] = {0};
+
+    for (int i = 0; !ret && i < mh.count; i++) {
+        for (int j = 0; j < mh.count; j++) mh.outputs[j].active = (i == j);
+        ret = run_outputs(&mh, seconds);
+        solo[i] = output_fps(&mh.outputs[i], seconds);
+        print_output_stats("solo", &mh.outputs[i]);
+    }
+
+    if (!ret) {
+        for (int j = 0; j < mh.count; j++) mh.outputs[j].active = 1;
+        ret = run_outputs(&mh, seconds);
+    }
+
+    for (int i = 0; !ret && i < mh.count; i++) {
+        struct Output *out = &mh.outputs[i];
+        double fps = output_fps(out, seconds);
+        print_output_stats("concurrent", out);
+        printf("crtc %u conn %u %s@%u: solo %.1f fps, concurrent %.1f fps (%.0f%%)%s\n",
+                out->crtc, out->conn, out->mode.name, out->mode.vrefresh,
+                solo[i], fps, solo[i] > 0 ? 100.0 * fps / solo[i] : 0.0,
+                fps < 0.9 * solo[i] ? ", INTERFERENCE" : "");
+    }
+    if (!ret) gpu_timer_print(&mh.gpu, "draw");
+
+    cleanup_multihead(&mh);
+    return ret;
+}
+
+/**
+ * format and modifier sweep on the primary plane of the first output. every
+ * pair from IN_FORMATS (the plain format list with implicit modifiers on
+ * kernels without it) that has a matching EGL config gets its own surface
+ * from gbm_surface_create_with_modifiers, a render run with glFinish per
+ * frame and a flip run drawing the same blended layers.
+ */
+#define SWEEP_LAYERS 8
+#define SWEEP_RENDER_FRAMES 60
+
+struct PlaneFormat {
+    uint32_t format;
+    uint64_t modifier;
+};
+
+struct SweepGL {
+    GLuint program;
+    GLint pos_loc, t_loc;
+    int frame;
+};
+
+static int plane_format_cmp(const void *a, const void *b)
+{
+    const struct PlaneFormat *pa = a, *pb = b;
+    if (pa->format != pb->format) return pa->format < pb->format ? -1 : 1;
+    if (pa->modifier != pb->modifier) return pa->modifier < pb->modifier ? -1 : 1;
+    return 0;
+}
+
+static const char *modifier_name(uint64_t modifier, char *buf, size_t len)
+{
+    static const char *vendors[] = { "none", "intel", "amd", "nvidia", "samsung",
+        "qcom", "vivante", "broadcom", "arm", "allwinner", "amlogic" };
+
+    if (modifier == DRM_FORMAT_MOD_LINEAR) return "linear";
+    if (modifier == DRM_FORMAT_MOD_INVALID) return "implicit";
+    unsigned vendor = modifier >> 56;
+    snprintf(buf, len, "%s:0x%llx",
+            vendor < sizeof vendors / sizeof vendors[0] ? vendors[vendor] : "vendor",
+            (unsigned long long)(modifier & 0x00ffffffffffffffull));
+    return buf;
+}
+
+// value of a property by name, -1 when the object has none
+static int64_t object_property(int fd, uint32_t id, uint32_t type, const char *name)
+{
+    int64_t value = -1;
+    drmModeObjectProperties *props = drmModeObjectGetProperties(fd, id, type);
+    for (uint32_t i = 0; props && i < props->count_props && value < 0; i++) {
+        drmModePropertyRes *prop = drmModeGetProperty(fd, props->props[i]);
+        if (prop && !strcmp(prop->name, name)) value = props->prop_values[i];
+        drmModeFreeProperty(prop);
+    }
+    drmModeFreeObjectProperties(props);
+    return value;
+}
+
+static int plane_formats(int fd, drmModePlane *plane, struct PlaneFormat **out)
+{
+    int64_t blob_id = object_property(fd, plane->plane_id, DRM_MODE_OBJECT_PLANE,
+            "IN_FORMATS");
+    drmModePropertyBlobRes *blob = blob_id > 0 ? drmModeGetPropertyBlob(fd, blob_id) : NULL;
+    int n = 0;
+
+    if (!blob) {
+        *out = calloc(plane->count_formats + 1, sizeof **out);
+        for (uint32_t i = 0; *out && i < plane->count_formats; i++) {
+            (*out)[n].format = plane->formats[i];
+            (*out)[n++].modifier = DRM_FORMAT_MOD_INVALID;
+        }
+        return n;
+    }
+
+    // every modifier entry covers a window of 64 formats from its offset
+    const struct drm_format_modifier_blob *hdr = blob->data;
+    const uint32_t *formats = (const uint32_t *)((const char *)hdr + hdr->formats_offset);
+    const struct drm_format_modifier *mods =
+        (const void *)((const char *)hdr + hdr->modifiers_offset);
+    *out = calloc((size_t)hdr->count_modifiers * 64 + 1, sizeof **out);
+    for (uint32_t m = 0; *out && m < hdr->count_modifiers; m++) {
+        for (uint32_t bit = 0; bit < 64; bit++) {
+            uint32_t f = mods[m].offset + bit;
+            if (!(mods[m].formats >> bit & 1) || f >= hdr->count_formats) continue;
+            (*out)[n].format = formats[f];
+            (*out)[n++].modifier = mods[m].modifier;
+        }
+    }
+    drmModeFreePropertyBlob(blob);
+    return n;
+}
+
+// format/modifier pairs of the primary plane of the crtc with index crtc_idx
+static int primary_plane_formats(int fd, int crtc_idx, struct PlaneFormat **out)
+{
+    int n = 0, found = 0;
+    *out = NULL;
+
+    drmSetClientCap(fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1);
+    drmModePlaneRes *pres = drmModeGetPlaneResources(fd);
+    if (!pres) return 0;
+
+    for (uint32_t i = 0; i < pres->count_planes && !found; i++) {
+        drmModePlane *plane = drmModeGetPlane(fd, pres->planes[i]);
+        if (!plane) continue;
+        if ((plane->possible_crtcs & (1u << crtc_idx)) &&
+                object_property(fd, plane->plane_id, DRM_MODE_OBJECT_PLANE, "type") ==
+                DRM_PLANE_TYPE_PRIMARY) {
+            n = plane_formats(fd, plane, out);
+            found = 1;
+        }
+        drmModeFreePlane(plane);
+    }
+    drmModeFreePlaneResources(pres);
+
+    if (n > 1) qsort(*out, n, sizeof **out, plane_format_cmp);
+    return n;
+}
+
+static GLuint compile_shader(GLenum type, const char *src)
+{
+    GLuint shader = glCreateShader(type);
+    GLint ok = 0;
+    glShaderSource(shader, 1, &src, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[512];
+        glGetShaderInfoLog(shader, sizeof log, NULL, log);
+        err_msg("shader compile failed: %s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+static int sweep_program(struct SweepGL *gl)
+{
+    static const char *vs =
+        "attribute vec2 pos;\n"
+        "varying vec2 uv;\n"
+        "void main() {\n"
+        "    uv = pos * 0.5 + 0.5;\n"
+        "    gl_Position = vec4(pos, 0.0, 1.0);\n"
+        "}\n";
+    static const char *fs =
+        "precision mediump float;\n"
+        "varying vec2 uv;\n"
+        "uniform float t;\n"
+        "void main() {\n"
+        "    gl_FragColor = vec4(uv.x, uv.y, fract(t + uv.x * uv.y), 0.25);\n"
+        "}\n";
+
+    memset(gl, 0, sizeof *gl);
+    GLuint v = compile_shader(GL_VERTEX_SHADER, vs);
+    GLuint f = compile_shader(GL_FRAGMENT_SHADER, fs);
+    if (!v || !f) return 1;
+
+    gl->program = glCreateProgram();
+    glAttachShader(gl->program, v);
+    glAttachShader(gl->program, f);
+    glLinkProgram(gl->program);
+    glDeleteShader(v);
+    glDeleteShader(f);
+
+    GLint ok = 0;
+    glGetProgramiv(gl->program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        err_msg("shader link failed\n");
+        return 1;
+    }
+    gl->pos_loc = glGetAttribLocation(gl->program, "pos");
+    gl->t_loc = glGetUniformLocation(gl->program, "t");
+    return 0;
+}
+
+// full screen layers blended over each other, read-modify-write of every
+// pixel so the buffer layout shows in the frame time
+static void sweep_draw(struct MultiHead *mh, struct Output *out, int idx)
+{
+    static const GLfloat quad[] = { -1, -1, 1, -1, -1, 1, 1, 1 };
+    struct SweepGL *gl = mh->draw_data;
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glUseProgram(gl->program);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glVertexAttribPointer(gl->pos_loc, 2, GL_FLOAT, GL_FALSE, 0, quad);
+    glEnableVertexAttribArray(gl->pos_loc);
+    for (int i = 0; i < SWEEP_LAYERS; i++) {
+        glUniform1f(gl->t_loc, (gl->frame % 120) / 120.0f + i * 0.125f);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+    gl->frame++;
+}
+
+// surface, context and program for one pair, NULL or why it is skipped
+static const char *sweep_setup(struct MultiHead *mh, const struct PlaneFormat *pf,
+        struct SweepGL *gl)
+{
+    static const EGLint ctx_att[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+    struct Output *out = &mh->outputs[0];
+
+    mh->config = match_config(mh->display, pf->format);
+    if (!mh->config)
+        return "no EGL config";
+
+    if (pf->modifier == DRM_FORMAT_MOD_INVALID) {
+        out->gbm_surface = gbm_surface_create(mh->gbm, out->mode.hdisplay,
+                out->mode.vdisplay, pf->format, GBM_BO_USE_SCANOUT | GBM_BO_USE_RENDERING);
+    } else {
+        out->gbm_surface = gbm_surface_create_with_modifiers(mh->gbm, out->mode.hdisplay,
+                out->mode.vdisplay, pf->format, &pf->modifier, 1);
+    }
+    if (!out->gbm_surface)
+        return "gbm cannot allocate it";
+
+    mh->gl_context = eglCreateContext(mh->display, mh->config, EGL_NO_CONTEXT, ctx_att);
+    if (mh->gl_context == EGL_NO_CONTEXT)
+        return "no context";
+    out->surface = eglCreateWindowSurface(mh->display, mh->config,
+            (EGLNativeWindowType)out->gbm_surface, NULL);
+    if (out->surface == EGL_NO_SURFACE)
+        return "no EGL window surface";
+    if (!eglMakeCurrent(mh->display, out->surface, out->surface, mh->gl_context))
+        return "cannot make current";
+    if (sweep_program(gl))
+        return "shaders failed";
+
+    gpu_timer_init(&mh->gpu, NULL, TRACK_GPU);
+    mh->draw = sweep_draw;
+    mh->draw_data = gl;
+    return NULL;
+}
+
+static void sweep_release(struct MultiHead *mh, struct SweepGL *gl)
+{
+    struct Output *out = &mh->outputs[0];
+    wait_flips(mh->fd, out, 1, 1000);
+
+    if (mh->gl_context != EGL_NO_CONTEXT && out->surface != EGL_NO_SURFACE &&
+            eglMakeCurrent(mh->display, out->surface, out->surface, mh->gl_context)) {
+        if (gl->program) glDeleteProgram(gl->program);
+        gpu_timer_release(&mh->gpu);
+    }
+    eglMakeCurrent(mh->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (out->surface != EGL_NO_SURFACE) eglDestroySurface(mh->display, out->surface);
+    if (mh->gl_context != EGL_NO_CONTEXT) eglDestroyContext(mh->display, mh->gl_context);
+
+    // removing the fb on screen turns the crtc off, the next pair modesets again
+    if (out->bo) gbm_surface_release_buffer(out->gbm_surface, out->bo);
+    if (out->next_bo) gbm_surface_release_buffer(out->gbm_surface, out->next_bo);
+    if (out->gbm_surface) gbm_surface_destroy(out->gbm_surface);
+
+    out->gbm_surface = NULL;
+    out->surface = EGL_NO_SURFACE;
+    out->bo = out->next_bo = NULL;
+    out->active = 0;
+    mh->gl_context = EGL_NO_CONTEXT;
+    mh->draw = NULL;
+    mh->draw_data = NULL;
+}
+
+// one format/modifier pair, skipped pairs are not an error
+static int sweep_run(struct MultiHead *mh, const struct PlaneFormat *pf, double seconds)
+{
+    struct Output *out = &mh->outputs[0];
+    struct SweepGL gl;
+    char fourcc[5], mod_buf[32], label[64];
+    double render_ms[SWEEP_RENDER_FRAMES];
+    static int have_driver;
+    int ret = 0;
+
+    memset(&gl, 0, sizeof gl);
+    memcpy(fourcc, &pf->format, 4);
+    fourcc[4] = 0;
+    snprintf(label, sizeof label, "%s %s", fourcc,
+            modifier_name(pf->modifier, mod_buf, sizeof mod_buf));
+
+    const char *skip = sweep_setup(mh, pf, &gl);
+    if (!skip && !have_driver) {
+        bench_result_gl_driver();
+        have_driver = 1;
+    }
+
+    // render only, the back buffer is redrawn without presenting
+    for (int i = -5; !skip && i < SWEEP_RENDER_FRAMES; i++) {
+        uint64_t t0 = bench_now_ns();
+        glViewport(0, 0, out->mode.hdisplay, out->mode.vdisplay);
+        sweep_draw(mh, out, 0);
+        glFinish();
+        if (i >= 0) render_ms[i] = bench_ns_to_ms(bench_now_ns() - t0);
+    }
+
+    // the first present modesets, a layout the plane refuses fails here
+    if (!skip && output_present(mh, out, 0))
+        skip = "not accepted for scanout";
+
+    if (skip) {
+        printf("%-28s skipped, %s\n", label, skip);
+    } else {
+        out->active = 1;
+        ret = run_outputs(mh, seconds);
+    }
+
+    if (!skip && !ret) {
+        char metric[96];
+        struct bench_stats st;
+        snprintf(metric, sizeof metric, "%s render", label);
+        bench_result_record("drm_test", metric, "ms/frame", 1, render_ms,
+                SWEEP_RENDER_FRAMES);
+        bench_stats_compute(render_ms, SWEEP_RENDER_FRAMES, &st);
+
+        uint64_t got = gbm_bo_get_modifier(out->bo);
+        printf("%-28s stride %u%s%s, render %.2f ms/frame (%.0f fps), flipped %.1f fps\n",
+                label, gbm_bo_get_stride(out->bo), got != pf->modifier ? ", got " : "",
+                got != pf->modifier ? modifier_name(got, mod_buf, sizeof mod_buf) : "",
+                st.median, st.median > 0 ? 1000.0 / st.median : 0.0,
+                output_fps(out, seconds));
+        print_output_stats(label, out);
+        if (mh->gpu.mode != GPU_TIMER_NONE) gpu_timer_print(&mh->gpu, "  gpu");
+    }
+
+    sweep_release(mh, &gl);
+    return ret;
+}
+
+// the first connected output alone, the others stay as they are. returns
+// 1 when it is set up, 0 without a connected output and -1 without a card
+static int open_first_output(struct MultiHead *mh)
+{
+    if (!drmAvailable()) {
+        err_msg("drm not loaded\n");
+        return -1;
+    }
+    mh->fd = open_first_card();
+    if (mh->fd < 0) {
+        err_msg("can not open any drm devices\n");
+        return -1;
+    }
+
+    if (find_outputs(mh) == 0) {
+        err_msg("No active connector found!\n");
+        close(mh->fd);
+        return 0;
+    }
+    for (int i = 1; i < mh->count; i++) drmModeFreeCrtc(mh->outputs[i].saved_crtc);
+    mh->count = 1;
+    return 1;
+}
+
+static int TestFormatSweep()
+{
+    const double seconds = 1.0;
+    struct MultiHead mh;
+    memset(&mh, 0, sizeof mh);
+
+    int found = open_first_output(&mh);
+    if (found <= 0)
+        return found < 0;
+    struct Output *out = &mh.outputs[0];
+
+    int crtc_idx = -1;
+    drmModeRes *res = drmModeGetResources(mh.fd);
+    for (int i = 0; res && i < res->count_crtcs; i++) {
+        if (res->crtcs[i] == out->crtc) crtc_idx = i;
+    }
+    drmModeFreeResources(res);
+
+    struct PlaneFormat *pfs = NULL;
+    int n = crtc_idx < 0 ? 0 : primary_plane_formats(mh.fd, crtc_idx, &pfs);
+    int ret = 0;
+    if (n == 0) {
+        err_msg("no primary plane formats for crtc %u\n", out->crtc);
+        ret = 1;
+    }
+    if (!ret) ret = multihead_egl_display(&mh);
+
+    if (!ret) {
+        printf("primary plane of crtc %u, %s@%u: %d format/modifier pairs\n",
+                out->crtc, out->mode.name, out->mode.vrefresh, n);
+    }
+    for (int i = 0; !ret && i < n; i++) {
+        ret = sweep_run(&mh, &pfs[i], seconds);
+        memstat_sample(&mem, "formats");
+    }
+
+    free(pfs);
+    cleanup_multihead(&mh);
+    return ret;
+}
+
+/**
+ * frames in flight capped at 1, 2 and 3 on the first output. a frame starts
+ * (the input sample) only while fewer than the cap are between their start
+ * and their page flip event. rendered frames queue up and go to the screen
+ * once their fence has signaled, so a flip never waits behind unfinished
+ * rendering. reports input to flip latency against the rate each depth gets.
+ */
+struct PacedBo {
+    struct gbm_bo *bo;
+    unsigned seq;
+};
+
+static int paced_run(struct MultiHead *mh, int max_in_flight, double seconds)
+{
+    struct Output *out = &mh->outputs[0];
+    struct frame_pacer pacer;
+    struct PacedBo queue[PACER_MAX_FRAMES];
+    int queued = 0, ret = 0;
+    unsigned presented = 0;
+
+    drmEventContext ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.version = DRM_EVENT_CONTEXT_VERSION;
+    ev.page_flip_handler = output_page_flip_event;
+
+    pacer_init(&pacer, mh->display, max_in_flight, 1);
+    uint64_t deadline = bench_now_ns() + (uint64_t)(seconds * 1e9);
+    while (!ret && bench_now_ns() < deadline) {
+        int can_start = pacer_in_flight(&pacer) < max_in_flight &&
+            queued < PACER_MAX_FRAMES && gbm_surface_has_free_buffers(out->gbm_surface);
+        if (can_start) {
+            unsigned seq = pacer_begin_frame(&pacer);
+            glViewport(0, 0, out->mode.hdisplay, out->mode.vdisplay);
+            mh->draw(mh, out, 0);
+            eglSwapBuffers(mh->display, out->surface);
+            pacer_end_frame(&pacer);
+
+            struct gbm_bo *bo = gbm_surface_lock_front_buffer(out->gbm_surface);
+            if (!bo || !bo_get_fb(bo)) {
+                ret = 1;
+                break;
+            }
+            queue[queued].bo = bo;
+            queue[queued++].seq = seq;
+        }
+
+        // the oldest finished frame goes out once the previous flip is done
+        if (queued && !out->pflip_pending && pacer_frame_done(&pacer, queue[0].seq)) {
+            struct gbm_bo *bo = queue[0].bo;
+            uint32_t fb_id = bo_get_fb(bo);
+            memmove(queue, queue + 1, --queued * sizeof *queue);
+
+            if (!out->bo) {
+                if (drmModeSetCrtc(mh->fd, out->crtc, fb_id, 0, 0, &out->conn, 1,
+                            &out->mode)) {
+                    err_msg("drmModeSetCrtc on crtc %u failed: %s\n", out->crtc,
+                            strerror(errno));
+                    gbm_surface_release_buffer(out->gbm_surface, bo);
+                    ret = 1;
+                    break;
+                }
+                out->bo = bo;
+                pacer_presented(&pacer, bench_now_ns());
+            } else if (drmModePageFlip(mh->fd, out->crtc, fb_id, DRM_MODE_PAGE_FLIP_EVENT,
+                        out)) {
+                err_msg("drmModePageFlip on crtc %u failed: %s\n", out->crtc,
+                        strerror(errno));
+                gbm_surface_release_buffer(out->gbm_surface, bo);
+                ret = 1;
+                break;
+            } else {
+                out->next_bo = bo;
+                out->pflip_pending = 1;
+            }
+            continue;
+        }
+
+        // a frame can start now, a fence is about to signal, or only a flip
+        // event can make progress
+        int timeout = can_start ? 0 : queued && !out->pflip_pending ? 1 : 100;
+        struct pollfd pfd = { mh->fd, POLLIN, 0 };
+        int n = poll(&pfd, 1, timeout);
+        if (n < 0 && errno != EINTR) ret = 1;
+        if (n > 0) {
+            unsigned frames = out->frames;
+            drmHandleEvent(mh->fd, &ev);
+            // flip timestamps are CLOCK_MONOTONIC like bench_now_ns()
+            if (out->frames != frames) {
+                pacer_presented(&pacer, out->last_flip_us * 1000);
+                presented++;
+            }
+        }
+    }
+
+    wait_flips(mh->fd, out, 1, 1000);
+    for (int i = 0; i < queued; i++) gbm_surface_release_buffer(out->gbm_surface, queue[i].bo);
+
+    if (!ret) {
+        char label[64];
+        snprintf(label, sizeof label, "latency %d in flight", max_in_flight);
+        bench_result_record("drm_test", label, "ms", 1, pacer.latency_ms, pacer.n_latency);
+        snprintf(label, sizeof label, "  input to flip");
+        printf("%d in flight: %.1f fps\n", max_in_flight, presented / seconds);
+        pacer_print(&pacer, label);
+    }
+    pacer_release(&pacer);
+    return ret;
+}
+
+static int TestFramePacing()
+{
+    const double seconds = 3.0;
+    struct MultiHead mh;
+    struct SweepGL gl;
+    memset(&mh, 0, sizeof mh);
+    memset(&gl, 0, sizeof gl);
+
+    int found = open_first_output(&mh);
+    if (found <= 0)
+        return found < 0;
+
+    int ret = setup_multihead_egl(&mh);
+    if (!ret) {
+        bench_result_gl_driver();
+        ret = sweep_program(&gl);
+        mh.draw = sweep_draw;
+        mh.draw_data = &gl;
+    }
+    if (!ret) {
+        printf("crtc %u %s@%u, %d blended layers per frame\n", mh.outputs[0].crtc,
+                mh.outputs[0].mode.name, mh.outputs[0].mode.vrefresh, SWEEP_LAYERS);
+    }
+    for (int n = 1; !ret && n <= 3; n++) {
+        ret = paced_run(&mh, n, seconds);
+        memstat_sample(&mem, "pacing");
+    }
+
+    if (gl.program) glDeleteProgram(gl.program);
+    cleanup_multihead(&mh);
+    return ret;
+}
+
+/**
+ * render nodes: every /dev/dri/renderD* gets its own gbm device, EGL
+ * display and context, no master, no connector and no X server needed.
+ * the node's MultiHead has one headless output whose gbm surface is
+ * rendered to and released again without ever being flipped. every node
+ * renders the blended layers of sweep_draw from its own thread, first
+ * alone and then all nodes at once.
+ */
+#define MAX_RENDER_NODES 8
+#define NODE_WIDTH 1920
+#define NODE_HEIGHT 1080
+#define NODE_IN_FLIGHT 2
+#define NODE_MAX_FRAMES 100000
+
+struct RenderNode {
+    char path[32];
+    char driver[32];
+    char prime[32];             // DRI_PRIME value, empty when not on pci
+    char renderer[128];
+    struct MultiHead mh;
+    struct SweepGL gl;
+
+    double seconds;
+    int failed;
+    unsigned frames;
+    double fps;
+    double *frame_ms;           // between frame starts
+    size_t n_frame_ms;
+};
+
+static void node_prime_id(int fd, char *buf, size_t len)
+{
+    drmDevicePtr dev;
+    buf[0] = 0;
+    if (drmGetDevice2(fd, 0, &dev))
+        return;
+    if (dev->bustype == DRM_BUS_PCI) {
+        snprintf(buf, len, "pci-%04x_%02x_%02x_%u", dev->businfo.pci->domain,
+                dev->businfo.pci->bus, dev->businfo.pci->dev, dev->businfo.pci->func);
+    }
+    drmFreeDevice(&dev);
+}
+
+static int open_render_node(struct RenderNode *node, const char *path)
+{
+    static const EGLint ctx_att[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+    struct MultiHead *mh = &node->mh;
+    struct Output *out = &mh->outputs[0];
+
+    memset(node, 0, sizeof *node);
+    snprintf(node->path, sizeof node->path, "%s", path + strlen("/dev/dri/"));
+    mh->fd = open(path, O_RDWR|O_CLOEXEC);
+    if (mh->fd < 0) {
+        err_msg("open '%s' failed: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    drmVersionPtr ver = drmGetVersion(mh->fd);
+    snprintf(node->driver, sizeof node->driver, "%s", ver ? ver->name : "unknown");
+    if (ver) drmFreeVersion(ver);
+    node_prime_id(mh->fd, node->prime, sizeof node->prime);
+
+    if (multihead_egl_display(mh))
+        return 1;
+    mh->config = match_config(mh->display, GBM_FORMAT_XRGB8888);
+    if (!mh->config) {
+        err_msg("%s: no EGL config for GBM_FORMAT_XRGB8888\n", node->path);
+        return 1;
+    }
+    mh->gl_context = eglCreateContext(mh->display, mh->config, EGL_NO_CONTEXT, ctx_att);
+    if (mh->gl_context == EGL_NO_CONTEXT) {
+        err_msg("%s: no context created\n", node->path);
+        return 1;
+    }
+
+    mh->count = 1;
+    out->mode.hdisplay = NODE_WIDTH;
+    out->mode.vdisplay = NODE_HEIGHT;
+    out->gbm_surface = gbm_surface_create(mh->gbm, NODE_WIDTH, NODE_HEIGHT,
+            GBM_FORMAT_XRGB8888, GBM_BO_USE_RENDERING);
+    if (!out->gbm_surface) {
+        err_msg("%s: cannot create gbm surface\n", node->path);
+        return 1;
+    }
+    out->surface = eglCreateWindowSurface(mh->display, mh->config,
+            (EGLNativeWindowType)out->gbm_surface, NULL);
+    if (out->surface == EGL_NO_SURFACE) {
+        err_msg("%s: cannot create EGL window surface\n", node->path);
+        return 1;
+    }
+
+    node->frame_ms = malloc(sizeof(double) * NODE_MAX_FRAMES);
+    return node->frame_ms ? 0 : 1;
+}
+
+// the context is current in this thread only while the node renders
+static void *render_node_thread(void *data)
+{
+    struct RenderNode *node = data;
+    struct MultiHead *mh = &node->mh;
+    struct Output *out = &mh->outputs[0];
+
+    if (!eglMakeCurrent(mh->display, out->surface, out->surface, mh->gl_context)) {
+        err_msg("%s: cannot activate EGL context\n", node->path);
+        node->failed = 1;
+        return NULL;
+    }
+    if (!node->gl.program) {
+        snprintf(node->renderer, sizeof node->renderer, "%s",
+                (const char *)glGetString(GL_RENDERER));
+        if (sweep_program(&node->gl)) {
+            node->failed = 1;
+            eglMakeCurrent(mh->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            return NULL;
+        }
+        mh->draw_data = &node->gl;
+    }
+
+    // nothing waits for a screen, the fences are the only throttle
+    struct frame_pacer pacer;
+    pacer_init(&pacer, mh->display, NODE_IN_FLIGHT, 0);
+    node->frames = 0;
+    node->n_frame_ms = 0;
+
+    uint64_t start = bench_now_ns(), last = start;
+    uint64_t deadline = start + (uint64_t)(node->seconds * 1e9);
+    for (uint64_t now = start; now < deadline; now = bench_now_ns()) {
+        pacer_begin_frame(&pacer);
+        if (node->frames && node->n_frame_ms < NODE_MAX_FRAMES)
+            node->frame_ms[node->n_frame_ms++] = bench_ns_to_ms(now - last);
+        last = now;
+
+        glViewport(0, 0, NODE_WIDTH, NODE_HEIGHT);
+        sweep_draw(mh, out, 0);
+        eglSwapBuffers(mh->display, out->surface);
+        pacer_end_frame(&pacer);
+
+        struct gbm_bo *bo = gbm_surface_lock_front_buffer(out->gbm_surface);
+        if (!bo) {
+            err_msg("%s: cannot lock front buffer\n", node->path);
+            node->failed = 1;
+            break;
+        }
+        gbm_surface_release_buffer(out->gbm_surface, bo);
+        node->frames++;
+    }
+    glFinish();
+    node->fps = node->frames / (bench_ns_to_ms(bench_now_ns() - start) / 1000.0);
+
+    pacer_release(&pacer);
+    eglMakeCurrent(mh->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    return NULL;
+}
+
+// renders on the nodes concurrently, each from its own thread
+static int run_render_nodes(struct RenderNode *nodes, int n, double seconds)
+{
+    pthread_t threads[MAX_RENDER_NODES];
+    int started[MAX_RENDER_NODES];
+    int ret = 0;
+
+    for (int i = 0; i < n; i++) {
+        nodes[i].seconds = seconds;
+        nodes[i].failed = 0;
+        started[i] = !pthread_create(&threads[i], NULL, render_node_thread, &nodes[i]);
+        if (!started[i]) {
+            err_msg("cannot start a thread for %s\n", nodes[i].path);
+            nodes[i].failed = 1;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+        ret |= nodes[i].failed;
+    }
+    return ret;
+}
+
+static void record_render_node(struct RenderNode *node, const char *run)
+{
+    char label[96];
+    struct bench_stats st;
+
+    snprintf(label, sizeof label, "%s %s", node->driver, node->renderer);
+    bench_result_driver(label);
+    snprintf(label, sizeof label, "%s %s frame", node->path, run);
+    bench_result_record("drm_test", label, "ms", 1, node->frame_ms, node->n_frame_ms);
+
+    bench_stats_compute(node->frame_ms, node->n_frame_ms, &st);
+    printf("  %-12s %-10s %8.1f fps  median %6.2f ms  p95 %6.2f ms\n", node->path, run,
+            node->fps, st.median, st.p95);
+}
+
+static int TestRenderNodes()
+{
+    const double seconds = 3.0;
+    struct RenderNode nodes[MAX_RENDER_NODES];
+    double solo_fps[MAX_RENDER_NODES];
+    int n = 0, ret = 0;
+
+    for (int i = 0; i < DRM_MAX_MINOR && n < MAX_RENDER_NODES; i++) {
+        char path[32];
+        snprintf(path, sizeof path, "/dev/dri/renderD%d", 128 + i);
+        if (access(path, R_OK)) continue;
+
+        if (open_render_node(&nodes[n], path)) {
+            err_msg("%s skipped\n", path);
+            free(nodes[n].frame_ms);
+            cleanup_multihead(&nodes[n].mh);
+            continue;
+        }
+        n++;
+    }
+    // like a missing connector for the scanout tests: nothing to test here
+    if (!n) {
+        err_msg("no usable render nodes, skipped\n");
+        return 0;
+    }
+
+    printf("%d render nodes, %dx%d, %d blended layers per frame, %d frames in flight\n",
+            n, NODE_WIDTH, NODE_HEIGHT, SWEEP_LAYERS, NODE_IN_FLIGHT);
+    for (int i = 0; !ret && i < n; i++) {
+        power_attach(nodes[i].mh.fd, nodes[i].path);
+        ret = run_render_nodes(&nodes[i], 1, seconds);
+        if (ret) break;
+        printf("%s: %s, %s%s%s\n", nodes[i].path, nodes[i].driver, nodes[i].renderer,
+                nodes[i].prime[0] ? ", DRI_PRIME=" : "", nodes[i].prime);
+        record_render_node(&nodes[i], "solo");
+        solo_fps[i] = nodes[i].fps;
+        memstat_sample(&mem, "rendernodes");
+    }
+
+    power_detach();
+    if (!ret && n > 1) {
+        printf("all %d nodes at once\n", n);
+        ret = run_render_nodes(nodes, n, seconds);
+        for (int i = 0; !ret && i < n; i++) {
+            record_render_node(&nodes[i], "together");
+            printf("  %-12s keeps %.0f%% of its solo rate\n", nodes[i].path,
+                    solo_fps[i] > 0 ? 100.0 * nodes[i].fps / solo_fps[i] : 0.0);
+        }
+        memstat_sample(&mem, "rendernodes");
+    }
+
+    if (!ret && n > 1) {
+        int best = 0;
+        for (int i = 1; i < n; i++) {
+            if (solo_fps[i] > solo_fps[best]) best = i;
+        }
+        printf("fastest for offload: %s (%s)%s%s\n", nodes[best].path, nodes[best].driver,
+                nodes[best].prime[0] ? ", DRI_PRIME=" : "", nodes[best].prime);
+    }
+
+    for (int i = 0; i < n; i++) {
+        struct RenderNode *node = &nodes[i];
+        if (node->gl.program && eglMakeCurrent(node->mh.display, node->mh.outputs[0].surface,
+                    node->mh.outputs[0].surface, node->mh.gl_context)) {
+            glDeleteProgram(node->gl.program);
+        }
+        free(node->frame_ms);
+        cleanup_multihead(&node->mh);
+    }
+    return ret;
+}
+
+struct DumbBuffer {
+    uint32_t width, height, format;
+    uint32_t handle, pitch, fb_id;
+    uint64_t size;
+    void *map;
+};
+
+// format is DRM_FORMAT_XRGB8888 or DRM_FORMAT_RGB565
+static int dumb_create(int fd, uint32_t width, uint32_t height, uint32_t format,
+        struct DumbBuffer *db)
+{
+    struct drm_mode_create_dumb creq;
+    memset(&creq, 0, sizeof creq);
+    memset(db, 0, sizeof *db);
+    creq.width = width;
+    creq.height = height;
+    creq.bpp = format == DRM_FORMAT_RGB565 ? 16 : 32;
+    if (drmIoctl(fd, DRM_IOCTL_MODE_CREATE_DUMB, &creq) < 0) {
+        err_msg("DRM_IOCTL_MODE_CREATE_DUMB failed: %s\n", strerror(errno));
+        return 1;
+    }
+    db->width = width;
+    db->height = height;
+    db->format = format;
+    db->handle = creq.handle;
+    db->pitch = creq.pitch;
+    db->size = creq.size;
+
+    uint32_t handles[4] = { db->handle }, pitches[4] = { db->pitch }, offsets[4] = { 0 };
+    if (drmModeAddFB2(fd, width, height, format, handles, pitches, offsets, &db->fb_id, 0)) {
+        err_msg("drmModeAddFB2 failed: %s\n", strerror(errno));
+        return 1;
+    }
+
+    struct drm_mode_map_dumb mreq;
+    memset(&mreq, 0, sizeof mreq);
+    mreq.handle = db->handle;
+    if (drmIoctl(fd, DRM_IOCTL_MODE_MAP_DUMB, &mreq) < 0) {
+        err_msg("DRM_IOCTL_MODE_MAP_DUMB failed: %s\n", strerror(errno));
+        return 1;
+    }
+    db->map = mmap(0, db->size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, mreq.offset);
+    if (db->map == MAP_FAILED) {
+        db->map = NULL;
+        err_msg("mmap failed: %s\n", strerror(errno));
+        return 1;
+    }
+    memset(db->map, 0, db->size);
+    return 0;
+}
+
+static void dumb_destroy(int fd, struct DumbBuffer *db)
+{
+    if (db->map) munmap(db->map, db->size);
+    if (db->fb_id) drmModeRmFB(fd, db->fb_id);
+    if (db->handle) {
+        struct drm_mode_destroy_dumb dreq = { db->handle };
+        drmIoctl(fd, DRM_IOCTL_MODE_DESTROY_DUMB, &dreq);
+    }
+    memset(db, 0, sizeof *db);
+}
+
+/**
+ * every mode of every connected connector: time the modeset, then flip
+ * between two dumb buffers for a while to measure the real refresh rate.
+ */
+static int TestModeSweep()
+{
+    const int flips = 30;
+    struct MultiHead mh;
+    memset(&mh, 0, sizeof mh);
+
+    if (!drmAvailable()) {
+        err_msg("drm not loaded\n");
+        return 1;
+    }
+    mh.fd = open_first_card();
+    if (mh.fd < 0) {
+        err_msg("can not open any drm devices\n");
+        return 1;
+    }
+    if (find_outputs(&mh) == 0) {
+        err_msg("No active connector found!\n");
+        close(mh.fd);
+        return 0;
+    }
+
+    int ret = 0;
+    for (int i = 0; !ret && i < mh.count; i++) {
+        struct Output *out = &mh.outputs[i];
+        drmModeConnector *conn = drmModeGetConnector(mh.fd, out->conn);
+        if (!conn) continue;
+
+        err_msg("connector %u on crtc %u: %d modes\n", out->conn, out->crtc,
+                conn->count_modes);
+        for (int m = 0; !ret && m < conn->count_modes; m++) {
+            drmModeModeInfo *mode = &conn->modes[m];
+            struct DumbBuffer bufs[2];
+            memset(bufs, 0, sizeof bufs);
+            if (dumb_create(mh.fd, mode->hdisplay, mode->vdisplay, DRM_FORMAT_XRGB8888,
+                        &bufs[0]) ||
+                    dumb_create(mh.fd, mode->hdisplay, mode->vdisplay, DRM_FORMAT_XRGB8888,
+                        &bufs[1])) {
+                ret = 1;
+            }
+
+            uint64_t t0 = bench_now_ns();
+            if (!ret && drmModeSetCrtc(mh.fd, out->crtc, bufs[0].fb_id, 0, 0,
+                        &out->conn, 1, mode)) {
+                err_msg("modeset %s failed: %s\n", mode->name, strerror(errno));
+                ret = 1;
+            }
+            double modeset_ms = bench_ns_to_ms(bench_now_ns() - t0);
+
+            out->frames = 0;
+            out->last_flip_us = 0;
+            out->n_intervals = 0;
+            free(out->intervals);
+            out->intervals = calloc(flips + 1, sizeof(double));
+            for (int f = 0; !ret && f < flips; f++) {
+                out->pflip_pending = 1;
+                if (drmModePageFlip(mh.fd, out->crtc, bufs[(f + 1) & 1].fb_id,
+                            DRM_MODE_PAGE_FLIP_EVENT, out)) {
+                    err_msg("page flip failed: %s\n", strerror(errno));
+                    out->pflip_pending = 0;
+                    ret = 1;
+                } else if (wait_flips(mh.fd, out, 1, 1000)) {
+                    err_msg("page flip timed out\n");
+                    ret = 1;
+                }
+            }
+
+            if (!ret) {
+                struct bench_stats st;
+                bench_stats_compute(out->intervals, out->n_intervals, &st);
+                printf("conn %u %-12s %4ux%-4u@%-3u modeset %8.2f ms, measured %.2f Hz\n",
+                        out->conn, mode->name, mode->hdisplay, mode->vdisplay,
+                        mode->vrefresh, modeset_ms, st.median > 0 ? 1000.0 / st.median : 0.0);
+            }
+
+            // move scanout off the buffers before freeing them
+            if (out->saved_crtc) {
+                drmModeCrtc *saved = out->saved_crtc;
+                drmModeSetCrtc(mh.fd, saved->crtc_id, saved->buffer_id, saved->x,
+                        saved->y, &out->conn, saved->mode_valid ? 1 : 0,
+                        saved->mode_valid ? &saved->mode : NULL);
+            }
+            dumb_destroy(mh.fd, &bufs[0]);
+            dumb_destroy(mh.fd, &bufs[1]);
+        }
+        drmModeFreeConnector(conn);
+    }
+
+    restore_outputs(&mh);
+    drmDropMaster(mh.fd);
+    close(mh.fd);
+    return ret;
+}
+
+/**
+ * software scanout as the boot splash and recovery ui do it: frames drawn
+ * by the cpu into mapped dumb buffers (XRGB8888 and RGB565) and flipped
+ * through dc and modeset_page_flip_event. every kernel runs in its scalar
+ * and vectorized version, after checking they agree bit for bit.
+ */
+enum {
+    SW_FILL,
+    SW_COPY,
+    SW_SWIZZLE,
+    SW_BLEND,
+    SW_KERNELS,
+};
+
+static const char *sw_kernel_names[] = { "fill", "copy", "rgba-swizzle", "blend" };
+
+// what the frames are drawn from, in system memory
+struct SwSources {
+    uint8_t *rgba;          // decoded image, R,G,B,A bytes
+    uint8_t *native;        // the same in the buffer format
+    uint32_t *overlay;      // premultiplied ARGB8888 ui layer
+};
+
+static int sw_sources_create(struct SwSources *src, uint32_t w, uint32_t h, uint32_t format)
+{
+    size_t n = (size_t)w * h;
+    src->rgba = malloc(n * 4);
+    src->native = malloc(n * 4);
+    src->overlay = malloc(n * 4);
+    if (!src->rgba || !src->native || !src->overlay) return 1;
+
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) {
+            uint8_t *p = src->rgba + ((size_t)y * w + x) * 4;
+            p[0] = x * 255 / w;
+            p[1] = y * 255 / h;
+            p[2] = (x ^ y) & 0xff;
+            p[3] = 0xff;
+            // a translucent panel with an opaque border, like a dialog
+            uint32_t a = (x % 256 < 8 || y % 256 < 8) ? 0xff : 0x60;
+            src->overlay[(size_t)y * w + x] = a << 24 | (0x20 * a / 255) << 16 |
+                (0x40 * a / 255) << 8 | (0x80 * a / 255);
+        }
+    }
+    if (format == DRM_FORMAT_RGB565) {
+        px_scalar.rgba_to_rgb565((uint16_t *)src->native, src->rgba, n);
+    } else {
+        px_scalar.rgba_to_xrgb((uint32_t *)src->native, src->rgba, n);
+    }
+    return 0;
+}
+
+static void sw_sources_release(struct SwSources *src)
+{
+    free(src->rgba);
+    free(src->native);
+    free(src->overlay);
+    memset(src, 0, sizeof *src);
+}
+
+// one frame into db, the content scrolls with the frame number
+static void sw_render(const struct px_kernels *k, int kernel, struct DumbBuffer *db,
+        const struct SwSources *src, int frame)
+{
+    int rgb565 = db->format == DRM_FORMAT_RGB565;
+    size_t bpp = rgb565 ? 2 : 4;
+    uint32_t color = 0xff000000u | (frame * 0x010305u & 0xffffff);
+    uint16_t color16 = (color >> 8 & 0xf800) | (color >> 5 & 0x07e0) | (color >> 3 & 0x1f);
+
+    for (uint32_t y = 0; y < db->height; y++) {
+        uint8_t *row = (uint8_t *)db->map + (size_t)y * db->pitch;
+        size_t sy = (size_t)((y + frame * 4) % db->height) * db->width;
+        switch (kernel) {
+        case SW_FILL:
+            if (rgb565) k->fill16((uint16_t *)row, db->width, color16);
+            else k->fill32((uint32_t *)row, db->width, color);
+            break;
+        case SW_COPY:
+            k->copy(row, src->native + sy * bpp, db->width * bpp);
+            break;
+        case SW_SWIZZLE:
+            if (rgb565) k->rgba_to_rgb565((uint16_t *)row, src->rgba + sy * 4, db->width);
+            else k->rgba_to_xrgb((uint32_t *)row, src->rgba + sy * 4, db->width);
+            break;
+        case SW_BLEND:
+            if (rgb565) k->over_rgb565((uint16_t *)row, src->overlay + sy, db->width);
+            else k->over_xrgb((uint32_t *)row, src->overlay + sy, db->width);
+            break;
+        }
+    }
+}
+
+static int dc_page_flip(uint32_t fb_id)
+{
+    drmEventContext ev;
+    memset(&ev, 0, sizeof ev);
+    ev.version = DRM_EVENT_CONTEXT_VERSION;
+    ev.page_flip_handler = modeset_page_flip_event;
+
+    dc.pflip_pending = 1;
+    if (drmModePageFlip(dc.fd, dc.crtc, fb_id, DRM_MODE_PAGE_FLIP_EVENT, NULL)) {
+        err_msg("page flip failed: %s\n", strerror(errno));
+        dc.pflip_pending = 0;
+        return 1;
+    }
+    // dc.fd is non blocking
+    struct pollfd pfd = { dc.fd, POLLIN, 0 };
+    while (dc.pflip_pending) {
+        if (poll(&pfd, 1, 1000) <= 0) {
+            err_msg("page flip timed out\n");
+            return 1;
+        }
+        drmHandleEvent(dc.fd, &ev);
+    }
+    return 0;
+}
+
+static int sw_run(const drmModeModeInfo *mode, uint32_t format, const char *format_name)
+{
+    const int frames = 30;
+    struct DumbBuffer bufs[2];
+    struct SwSources src;
+    memset(bufs, 0, sizeof bufs);
+    memset(&src, 0, sizeof src);
+
+    if (dumb_create(dc.fd, mode->hdisplay, mode->vdisplay, format, &bufs[0]) ||
+            dumb_create(dc.fd, mode->hdisplay, mode->vdisplay, format, &bufs[1])) {
+        printf("%ux%u %-8s not supported for scanout, skipped\n", mode->hdisplay,
+                mode->vdisplay, format_name);
+        dumb_destroy(dc.fd, &bufs[0]);
+        dumb_destroy(dc.fd, &bufs[1]);
+        return 0;
+    }
+
+    int ret = sw_sources_create(&src, mode->hdisplay, mode->vdisplay, format);
+    if (ret) err_msg("out of memory for %ux%u sources\n", mode->hdisplay, mode->vdisplay);
+    if (!ret && drmModeSetCrtc(dc.fd, dc.crtc, bufs[0].fb_id, 0, 0, &dc.conn, 1,
+                (drmModeModeInfo *)mode)) {
+        err_msg("modeset %s failed: %s\n", mode->name, strerror(errno));
+        ret = 1;
+    }
+
+    const struct px_kernels *impls[] = { &px_scalar, &px_simd };
+    for (int kernel = 0; !ret && kernel < SW_KERNELS; kernel++) {
+        double scalar_ms = 0;
+        for (int i = 0; !ret && i < 2; i++) {
+            double cpu_ms[frames];
+            int back = 1;
+            uint64_t start = bench_now_ns();
+            for (int f = 0; !ret && f < frames; f++) {
+                uint64_t t0 = bench_now_ns();
+                sw_render(impls[i], kernel, &bufs[back], &src, f);
+                cpu_ms[f] = bench_ns_to_ms(bench_now_ns() - t0);
+                ret = dc_page_flip(bufs[back].fb_id);
+                back ^= 1;
+            }
+            if (ret) break;
+            double fps = frames / ((bench_now_ns() - start) / 1e9);
+
+            char label[96];
+            snprintf(label, sizeof label, "swscanout %ux%u %s %s %s", mode->hdisplay,
+                    mode->vdisplay, format_name, sw_kernel_names[kernel], impls[i]->name);
+            bench_result_record("drm_test", label, "ms", 1, cpu_ms, frames);
+
+            struct bench_stats st;
+            bench_stats_compute(cpu_ms, frames, &st);
+            if (i == 0) scalar_ms = st.median;
+            printf("%ux%u %-8s %-12s %-6s cpu %7.2f ms/frame (p95 %7.2f), %6.1f fps "
+                    "cpu bound, %5.1f fps flipped", mode->hdisplay, mode->vdisplay,
+                    format_name, sw_kernel_names[kernel], impls[i]->name, st.median, st.p95,
+                    st.median > 0 ? 1000.0 / st.median : 0.0, fps);
+            if (i == 1 && st.median > 0) printf(", x%.1f", scalar_ms / st.median);
+            printf("\n");
+        }
+    }
+
+    // move scanout off the buffers before freeing them
+    if (dc.saved_crtc) {
+        drmModeSetCrtc(dc.fd, dc.saved_crtc->crtc_id, dc.saved_crtc->buffer_id,
+                dc.saved_crtc->x, dc.saved_crtc->y, &dc.conn,
+                dc.saved_crtc->mode_valid ? 1 : 0,
+                dc.saved_crtc->mode_valid ? &dc.saved_crtc->mode : NULL);
+    }
+    dumb_destroy(dc.fd, &bufs[0]);
+    dumb_destroy(dc.fd, &bufs[1]);
+    sw_sources_release(&src);
+    return ret;
+}
+
+static int TestSwScanout()
+{
+    // the preferred mode and the common sizes the connector offers
+    static const uint16_t sizes[][2] = {
+        {1280, 720}, {1920, 1080}, {2560, 1440}, {3840, 2160},
+    };
+
+    const char *bad = px_validate(&px_simd);
+    if (bad) {
+        err_msg("%s %s differs from the scalar reference\n", px_simd.name, bad);
+        return 1;
+    }
+
+    memset(&dc, 0, sizeof dc);
+    dc.fd = -1;
+    if (setup_drm())
+        return 1;
+    if (dc.fd < 0)
+        return 0;
+    if (drmSetMaster(dc.fd))
+        err_msg("not drm master (%s), modesets may fail\n", strerror(errno));
+
+    drmModeConnector *conn = drmModeGetConnector(dc.fd, dc.conn);
+    if (!conn) {
+        cleanup();
+        return 1;
+    }
+
+    const drmModeModeInfo *modes[5];
+    int nmodes = 0;
+    modes[nmodes++] = preferred_mode(conn);
+    for (int s = 0; s < 4; s++) {
+        for (int m = 0; m < conn->count_modes; m++) {
+            const drmModeModeInfo *mode = &conn->modes[m];
+            if (mode->hdisplay != sizes[s][0] || mode->vdisplay != sizes[s][1]) continue;
+            int dup = 0;
+            for (int i = 0; i < nmodes; i++) {
+                dup |= modes[i]->hdisplay == mode->hdisplay &&
+                    modes[i]->vdisplay == mode->vdisplay;
+            }
+            if (!dup) modes[nmodes++] = mode;
+            break;
+        }
+    }
+
+    printf("software scanout on crtc %u with %s kernels\n", dc.crtc, px_simd.name);
+    int ret = 0;
+    for (int i = 0; !ret && i < nmodes; i++) {
+        printf("%s @ %u Hz\n", modes[i]->name, modes[i]->vrefresh);
+        ret = sw_run(modes[i], DRM_FORMAT_XRGB8888, "XRGB8888");
+        if (!ret) ret = sw_run(modes[i], DRM_FORMAT_RGB565, "RGB565");
+        memstat_sample(&mem, "swscanout");
+    }
+
+    drmModeFreeConnector(conn);
+    cleanup();
+    return ret;
+}
+
+static void usage(const char *prog)
+{
+    err_quit("usage: %s [-t trace.json] [test...]\n"
+            "tests: devs kms gem rendering (default), modesweep multicrtc gemchurn "
+            "swscanout formats pacing rendernodes\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    
+    typedef int (*TestFunc)();
+
+    struct TestCase {
+        const char* key;
+        const char* name; 
+        TestFunc cb;
+        int by_default;
+    } tests[] = {
+        {"devs", "test open all drm devices", TestDevs, 1},
+        {"kms", "test kms", TestKMS, 1},
+        {"gem", "test gem", TestGEM, 1},
+        {"rendering", "test rendering", TestRendering, 1},
+        {"modesweep", "test kms mode sweep", TestModeSweep, 0},
+        {"multicrtc", "test concurrent multi-crtc scanout", TestMultiCrtc, 0},
+        {"gemchurn", "test gem allocator churn", TestGEMChurn, 0},
+        {"swscanout", "test software rendered scanout", TestSwScanout, 0},
+        {"formats", "test scanout formats and modifiers", TestFormatSweep, 0},
+        {"pacing", "test frames in flight against latency", TestFramePacing, 0},
+        {"rendernodes", "test headless rendering on every render node", TestRenderNodes, 0},
+    };
+    const int ntests = sizeof tests / sizeof tests[0];
+
+    int c;
+    while ((c = getopt(argc, argv, "t:")) != -1) {
+        switch (c) {
+            case 't': trace_path = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (trace_path) {
+        trace_name_track(&trace, TRACK_CPU, "cpu");
+        trace_name_track(&trace, TRACK_GPU, "gpu");
+    }
+
+    for (int i = optind; i < argc; i++) {
+        int found = 0;
+        for (int t = 0; t < ntests; t++) found |= !strcmp(argv[i], tests[t].key);
+        if (!found) usage(argv[0]);
+    }
+    
+    int success = 0;
+    for (struct TestCase* tc = &tests[0]; tc != &tests[ntests]; tc++) {
+        int selected = optind == argc ? tc->by_default : 0;
+        for (int i = optind; i < argc; i++) selected |= !strcmp(argv[i], tc->key);
+        if (!selected) continue;
+
+        err_msg("\e[38;5;226mstart %s\e[00m\n", tc->name);
+        memstat_sample(&mem, tc->key);
+        // clocks and power state of the card each test opens, see power_attach
+        power_test = tc->key;
+        uint64_t t0 = bench_now_ns();
+        success = tc->cb();
+        if (trace_path)
+            trace_complete(&trace, TRACK_CPU, tc->key, TRACE_NO_FRAME, t0, bench_now_ns());
+        power_detach();
+        memstat_sample(&mem, tc->key);
+        if (success) {
+            err_msg("\e[38;5;160m%s failed\e[00m\n", tc->name);
+            break;
+        } 
+    }
+
+    memstat_report(&mem, "drm_test");
+    memstat_release(&mem);
+    powerstat_release(&power);
+
+    if (trace_path) {
+        if (trace_write(&trace, "drm_test", trace_path))
+            err_msg("cannot write trace to %s\n", trace_path);
+        else
+            printf("trace with %zu events written to %s\n", trace.n, trace_path);
+        trace_release(&trace);
+    }
     return success;
 }
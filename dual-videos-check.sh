@@ -364,6 +364,7 @@ test_switch() {
     fi
 }
 
+# needs X and glxinfo, `drm_test rendernodes` measures every gpu headless
 test_offload_rendering() {
     local provider sink offloading_capable dri
 
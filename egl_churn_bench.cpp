@@ -0,0 +1,413 @@
+/**
+ * creates and tears down EGL objects thousands of times, the way previews
+ * and thumbnailers do. "full" churn initializes and terminates the display
+ * every iteration, "context" churn keeps the display and recreates
+ * context and surface only. every step is timed on its own and the open
+ * fd count and memory are sampled along the way, so leaks that only show
+ * up under churn stand out. runs on the headless display (llvmpipe, with
+ * pbuffers) and on gbm window surfaces, which vgem is enough for.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <glob.h>
+#include <unistd.h>
+#include <vector>
+#include <string>
+
+#include <gbm.h>
+
+#include "glutil.h"
+#include "eglutil.h"
+#include "benchutil.h"
+#include "memstat.h"
+#include "benchresult.h"
+
+#define err_msg(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+} while (0)
+
+#define err_quit(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+    exit(1); \
+} while (0)
+
+using namespace std;
+
+enum Step {
+    STEP_INIT,
+    STEP_CONFIG,
+    STEP_CONTEXT,
+    STEP_SURFACE,
+    STEP_CURRENT,
+    STEP_DRAW,
+    STEP_RELEASE,
+    STEP_DESTROY_SURFACE,
+    STEP_DESTROY_CONTEXT,
+    STEP_TERMINATE,
+    STEP_COUNT,
+};
+
+static const char* step_names[] = {
+    "initialize", "choose config", "create context", "create surface",
+    "make current", "first frame", "release current", "destroy surface",
+    "destroy context", "terminate",
+};
+
+static struct {
+    int iterations;
+    int width, height;
+    const char* platform;
+    const char* mode;
+    const char* device;
+} opts = {
+    1000, 256, 256, "all", "all", NULL,
+};
+
+struct Churn {
+    const char* platform;
+    struct gbm_device* gbm {nullptr};
+    EGLDisplay display {EGL_NO_DISPLAY};
+    EGLConfig config {nullptr};
+    EGLint error {EGL_SUCCESS};         // of the last failed iteration
+    vector<double> step_us[STEP_COUNT];
+    vector<int> fds;
+};
+
+static int count_fds()
+{
+    DIR* dir = opendir("/proc/self/fd");
+    if (!dir) return -1;
+    int n = 0;
+    for (struct dirent* d; (d = readdir(dir)); ) {
+        if (d->d_name[0] != '.') n++;
+    }
+    closedir(dir);
+    // the fd of the directory itself
+    return n - 1;
+}
+
+static bool open_display(Churn& c)
+{
+    if (!c.gbm) {
+        c.display = egl_open_headless_display();
+    } else {
+        EGLint major, minor;
+        c.display = eglGetDisplay((EGLNativeDisplayType)c.gbm);
+        if (c.display != EGL_NO_DISPLAY && !eglInitialize(c.display, &major, &minor))
+            c.display = EGL_NO_DISPLAY;
+    }
+    return c.display != EGL_NO_DISPLAY && eglBindAPI(EGL_OPENGL_ES_API);
+}
+
+static bool choose_config(Churn& c)
+{
+    const EGLint conf_att[] = {
+        EGL_SURFACE_TYPE, c.gbm ? EGL_WINDOW_BIT : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_NONE,
+    };
+    EGLConfig confs[64];
+    int num_conf = 0;
+    c.config = nullptr;
+    if (!eglChooseConfig(c.display, conf_att, confs, 64, &num_conf)) return false;
+    for (int i = 0; i < num_conf && !c.config; i++) {
+        EGLint id = 0;
+        // gbm surfaces are XRGB8888, the config has to match
+        if (!c.gbm || (eglGetConfigAttrib(c.display, confs[i], EGL_NATIVE_VISUAL_ID, &id)
+                    && (uint32_t)id == GBM_FORMAT_XRGB8888))
+            c.config = confs[i];
+    }
+    return c.config != nullptr;
+}
+
+static void record(Churn& c, Step step, uint64_t t0)
+{
+    c.step_us[step].push_back((bench_now_ns() - t0) / 1e3);
+}
+
+static void terminate_display(Churn& c)
+{
+    eglTerminate(c.display);
+    eglReleaseThread();
+    c.display = EGL_NO_DISPLAY;
+}
+
+// tears down what a failed cycle created so far, so a failure is not
+// reported as a leak as well. keeps the egl error of the failing step
+static bool abandon(Churn& c, bool full, EGLContext ctx, EGLSurface surface,
+        struct gbm_surface* gs)
+{
+    c.error = eglGetError();
+    if (c.display != EGL_NO_DISPLAY) {
+        eglMakeCurrent(c.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (surface != EGL_NO_SURFACE) eglDestroySurface(c.display, surface);
+        if (ctx != EGL_NO_CONTEXT) eglDestroyContext(c.display, ctx);
+        if (full) terminate_display(c);
+    }
+    if (gs) gbm_surface_destroy(gs);
+    return false;
+}
+
+// one create/use/destroy cycle, returns false on the first failing step
+static bool iterate(Churn& c, bool full)
+{
+    static const EGLint ctx_att[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+    uint64_t t0;
+
+    if (full) {
+        t0 = bench_now_ns();
+        if (!open_display(c)) return abandon(c, full, EGL_NO_CONTEXT, EGL_NO_SURFACE, nullptr);
+        record(c, STEP_INIT, t0);
+
+        t0 = bench_now_ns();
+        if (!choose_config(c)) return abandon(c, full, EGL_NO_CONTEXT, EGL_NO_SURFACE, nullptr);
+        record(c, STEP_CONFIG, t0);
+    }
+
+    t0 = bench_now_ns();
+    EGLContext ctx = eglCreateContext(c.display, c.config, EGL_NO_CONTEXT, ctx_att);
+    if (ctx == EGL_NO_CONTEXT) return abandon(c, full, ctx, EGL_NO_SURFACE, nullptr);
+    record(c, STEP_CONTEXT, t0);
+
+    struct gbm_surface* gs = nullptr;
+    EGLSurface surface = EGL_NO_SURFACE;
+    t0 = bench_now_ns();
+    if (c.gbm) {
+        gs = gbm_surface_create(c.gbm, opts.width, opts.height, GBM_FORMAT_XRGB8888,
+                GBM_BO_USE_RENDERING);
+        if (gs) surface = eglCreateWindowSurface(c.display, c.config,
+                (EGLNativeWindowType)gs, NULL);
+    } else {
+        const EGLint pb_att[] = {
+            EGL_WIDTH, opts.width,
+            EGL_HEIGHT, opts.height,
+            EGL_NONE
+        };
+        surface = eglCreatePbufferSurface(c.display, c.config, pb_att);
+    }
+    if (surface == EGL_NO_SURFACE) return abandon(c, full, ctx, surface, gs);
+    record(c, STEP_SURFACE, t0);
+
+    t0 = bench_now_ns();
+    if (!eglMakeCurrent(c.display, surface, surface, ctx))
+        return abandon(c, full, ctx, surface, gs);
+    record(c, STEP_CURRENT, t0);
+
+    // buffers are allocated lazily, the first frame pays for them
+    t0 = bench_now_ns();
+    glClearColor(0.2f, 0.4f, 0.6f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (gs) {
+        eglSwapBuffers(c.display, surface);
+        struct gbm_bo* bo = gbm_surface_lock_front_buffer(gs);
+        if (bo) gbm_surface_release_buffer(gs, bo);
+    } else {
+        glFinish();
+    }
+    if (glGetError() != GL_NO_ERROR) return abandon(c, full, ctx, surface, gs);
+    record(c, STEP_DRAW, t0);
+
+    t0 = bench_now_ns();
+    eglMakeCurrent(c.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    record(c, STEP_RELEASE, t0);
+
+    t0 = bench_now_ns();
+    eglDestroySurface(c.display, surface);
+    if (gs) gbm_surface_destroy(gs);
+    record(c, STEP_DESTROY_SURFACE, t0);
+
+    t0 = bench_now_ns();
+    eglDestroyContext(c.display, ctx);
+    record(c, STEP_DESTROY_CONTEXT, t0);
+
+    if (full) {
+        t0 = bench_now_ns();
+        terminate_display(c);
+        record(c, STEP_TERMINATE, t0);
+    }
+    return true;
+}
+
+static int run_mode(Churn& c, bool full, struct memstat* mem)
+{
+    const char* mode = full ? "full" : "context";
+    // memstat labels outlive the run, one loop series per platform and mode
+    const char* series = c.gbm ? (full ? "gbm full" : "gbm context") :
+        (full ? "headless full" : "headless context");
+    int ret = 0;
+
+    for (auto& v: c.step_us) v.clear();
+    c.fds.clear();
+
+    if (!full && (!open_display(c) || !choose_config(c))) {
+        err_msg("%s: cannot set up the display\n", c.platform);
+        if (c.display != EGL_NO_DISPLAY) terminate_display(c);
+        return 1;
+    }
+
+    // the first iterations load the driver and warm its caches
+    const int warmup = 10;
+    uint64_t cold_ns = bench_now_ns();
+    for (int i = 0; i < warmup && !ret; i++) {
+        if (!iterate(c, full)) ret = 1;
+        if (i == 0) cold_ns = bench_now_ns() - cold_ns;
+    }
+    for (auto& v: c.step_us) v.clear();
+
+    int every = opts.iterations / 64 > 0 ? opts.iterations / 64 : 1;
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < opts.iterations && !ret; i++) {
+        if (!iterate(c, full)) {
+            err_msg("%s %s: iteration %d failed (egl error 0x%x)\n", c.platform, mode, i,
+                    c.error);
+            ret = 1;
+        }
+        if (i % every == 0) {
+            c.fds.push_back(count_fds());
+            memstat_sample(mem, series);
+        }
+    }
+    double secs = (bench_now_ns() - start) / 1e9;
+    c.fds.push_back(count_fds());
+
+    printf("%s %s churn: %zu iterations in %.2f s, %.1f/s, first one %.2f ms\n",
+            c.platform, mode, c.step_us[STEP_CONTEXT].size(), secs,
+            c.step_us[STEP_CONTEXT].size() / secs, bench_ns_to_ms(cold_ns));
+    for (int s = 0; s < STEP_COUNT; s++) {
+        vector<double>& v = c.step_us[s];
+        if (v.empty()) continue;
+        char label[96];
+        snprintf(label, sizeof label, "%s %s %s", c.platform, mode, step_names[s]);
+        bench_result_record("egl_churn_bench", label, "us", 1, v.data(), v.size());
+
+        struct bench_stats st;
+        snprintf(label, sizeof label, "  %s", step_names[s]);
+        bench_stats_compute(v.data(), v.size(), &st);
+        bench_stats_print(label, "us", &st);
+    }
+
+    // a steady leak shows up as a climb between the first and last sample
+    int first = c.fds.front(), last = c.fds.back();
+    printf("  open fds %d -> %d%s\n", first, last,
+            last > first ? ", LEAKING" : "");
+    if (last > first) ret = 1;
+
+    if (!full) terminate_display(c);
+    return ret;
+}
+
+// the given device, or the first render node (then card) gbm accepts
+static int open_gbm_device(const char* path, struct gbm_device** gbm)
+{
+    glob_t g;
+    vector<string> paths;
+    if (path) {
+        paths.push_back(path);
+    } else {
+        if (glob("/dev/dri/renderD*", 0, NULL, &g) == 0) {
+            paths.insert(paths.end(), g.gl_pathv, g.gl_pathv + g.gl_pathc);
+            globfree(&g);
+        }
+        if (glob("/dev/dri/card*", 0, NULL, &g) == 0) {
+            paths.insert(paths.end(), g.gl_pathv, g.gl_pathv + g.gl_pathc);
+            globfree(&g);
+        }
+    }
+
+    for (auto& p: paths) {
+        int fd = open(p.c_str(), O_RDWR | O_CLOEXEC);
+        if (fd < 0) continue;
+        *gbm = gbm_create_device(fd);
+        if (*gbm) {
+            printf("gbm on %s (%s)\n", p.c_str(), gbm_device_get_backend_name(*gbm));
+            return fd;
+        }
+        close(fd);
+    }
+    return -1;
+}
+
+static void usage(const char* prog)
+{
+    err_quit("usage: %s [-n iterations] [-s WxH] [-p all|headless,gbm] "
+            "[-m all|full,context] [-d /dev/dri/node]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    int c;
+    while ((c = getopt(argc, argv, "n:s:p:m:d:")) != -1) {
+        switch (c) {
+            case 'n': opts.iterations = atoi(optarg); break;
+            case 's':
+                if (sscanf(optarg, "%dx%d", &opts.width, &opts.height) != 2)
+                    usage(argv[0]);
+                break;
+            case 'p': opts.platform = optarg; break;
+            case 'm': opts.mode = optarg; break;
+            case 'd': opts.device = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (opts.iterations <= 0 || opts.width <= 0 || opts.height <= 0) usage(argv[0]);
+
+    struct memstat mem = {0};
+    int ret = 0;
+    for (int p = 0; p < 2; p++) {
+        Churn churn;
+        int fd = -1;
+        churn.platform = p == 0 ? "headless" : "gbm";
+        if (!bench_selected(opts.platform, churn.platform)) continue;
+
+        if (p == 1) {
+            fd = open_gbm_device(opts.device, &churn.gbm);
+            if (fd < 0) {
+                printf("gbm: no usable drm device, skipped\n");
+                if (opts.device) ret = 1;
+                continue;
+            }
+        }
+
+        // identify the driver once, outside of the measurements
+        {
+            if (!open_display(churn) || !choose_config(churn)) {
+                err_msg("%s: no usable EGL display\n", churn.platform);
+                ret = 1;
+            } else {
+                char driver[256];
+                snprintf(driver, sizeof driver, "%s %s",
+                        eglQueryString(churn.display, EGL_VENDOR),
+                        eglQueryString(churn.display, EGL_VERSION));
+                printf("%s: %s\n", churn.platform, driver);
+                bench_result_driver(driver);
+            }
+            if (churn.display != EGL_NO_DISPLAY) eglTerminate(churn.display);
+            eglReleaseThread();
+            churn.display = EGL_NO_DISPLAY;
+        }
+
+        for (int m = 0; m < 2 && churn.config; m++) {
+            bool full = m == 0;
+            if (!bench_selected(opts.mode, full ? "full" : "context")) continue;
+            ret |= run_mode(churn, full, &mem);
+        }
+
+        if (churn.gbm) gbm_device_destroy(churn.gbm);
+        if (fd >= 0) close(fd);
+    }
+
+    memstat_sample(&mem, "end");
+    if (memstat_report(&mem, "egl_churn_bench")) ret = 1;
+    memstat_release(&mem);
+    return ret;
+}
@@ -0,0 +1,35 @@
+#include <pthread.h>
+
+#include "benchutil.h"
+#include "eglfence.h"
+
+static struct egl_fence_procs procs;
+static pthread_once_t procs_once = PTHREAD_ONCE_INIT;
+
+static void load_procs(void)
+{
+    procs.CreateSync = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+    procs.DestroySync = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+    procs.ClientWaitSync = (PFNEGLCLIENTWAITSYNCKHRPROC)
+        eglGetProcAddress("eglClientWaitSyncKHR");
+    // all or nothing
+    if (!procs.CreateSync || !procs.DestroySync || !procs.ClientWaitSync) {
+        procs.CreateSync = NULL;
+        procs.DestroySync = NULL;
+        procs.ClientWaitSync = NULL;
+    }
+}
+
+const struct egl_fence_procs *egl_fence_procs(void)
+{
+    pthread_once(&procs_once, load_procs);
+    return &procs;
+}
+
+int egl_fence_supported(EGLDisplay display)
+{
+    if (display == EGL_NO_DISPLAY) return 0;
+    if (!extension_list_has(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_fence_sync"))
+        return 0;
+    return egl_fence_procs()->CreateSync != NULL;
+}
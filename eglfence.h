@@ -0,0 +1,32 @@
+#ifndef _EGL_FENCE_H
+#define _EGL_FENCE_H
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * EGL_KHR_fence_sync entry points, shared by the frame pacer and the gl
+ * stream buffers. the pointers are looked up once per process, but the
+ * extension is per display: check egl_fence_supported for every display
+ * before using them on it.
+ */
+struct egl_fence_procs {
+    PFNEGLCREATESYNCKHRPROC CreateSync;
+    PFNEGLDESTROYSYNCKHRPROC DestroySync;
+    PFNEGLCLIENTWAITSYNCKHRPROC ClientWaitSync;
+};
+
+/* safe to call from any thread, members are NULL when libEGL lacks them */
+const struct egl_fence_procs *egl_fence_procs(void);
+/* non-zero when display has EGL_KHR_fence_sync and the entry points loaded */
+int egl_fence_supported(EGLDisplay display);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,164 @@
+#include <string.h>
+#include <iostream>
+
+#include "glutil.h"
+#include "eglutil.h"
+
+using namespace std;
+
+EGLDisplay egl_open_headless_display()
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLint major, minor;
+
+    const char *client_ext = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (extension_list_has(client_ext, "EGL_MESA_platform_surfaceless")) {
+        auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+            eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (get_platform_display) {
+            display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                    EGL_DEFAULT_DISPLAY, NULL);
+        }
+        if (display != EGL_NO_DISPLAY && !eglInitialize(display, &major, &minor)) {
+            display = EGL_NO_DISPLAY;
+        }
+    }
+
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+            cerr << "cannot initialize a headless EGL display" << endl;
+            return EGL_NO_DISPLAY;
+        }
+    }
+
+    return display;
+}
+
+EGLOffscreen::~EGLOffscreen()
+{
+    release();
+}
+
+bool EGLOffscreen::create(int width, int height, EGLDisplay display,
+        EGLContext share)
+{
+    _width = width;
+    _height = height;
+
+    if (display == EGL_NO_DISPLAY) {
+        display = egl_open_headless_display();
+        if (display == EGL_NO_DISPLAY) return false;
+        _own_display = true;
+    }
+    _display = display;
+
+    if (!eglBindAPI(EGL_OPENGL_ES_API)) {
+        cerr << "EGL_OPENGL_ES_API is not supported." << endl;
+        return false;
+    }
+
+    bool surfaceless = has_extension("EGL_KHR_surfaceless_context");
+    const EGLint conf_att[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE,
+    };
+    int num_conf;
+    if (!eglChooseConfig(_display, conf_att, &_config, 1, &num_conf) || num_conf != 1) {
+        cerr << "cannot find a proper EGL framebuffer configuration" << endl;
+        return false;
+    }
+
+    static const EGLint ctx_att[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+    _context = eglCreateContext(_display, _config, share, ctx_att);
+    if (_context == EGL_NO_CONTEXT) {
+        cerr << "no context created." << endl;
+        return false;
+    }
+
+    if (!surfaceless) {
+        static const EGLint pb_att[] = {
+            EGL_WIDTH, 1,
+            EGL_HEIGHT, 1,
+            EGL_NONE
+        };
+        _surface = eglCreatePbufferSurface(_display, _config, pb_att);
+        if (_surface == EGL_NO_SURFACE) {
+            cerr << "cannot create EGL pbuffer surface" << endl;
+            return false;
+        }
+    }
+
+    if (!make_current()) {
+        cerr << "cannot activate EGL context" << endl;
+        return false;
+    }
+
+    glGenTextures(1, &_color_tex);
+    glBindTexture(GL_TEXTURE_2D, _color_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+            GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, _color_tex, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "offscreen framebuffer incomplete" << endl;
+        return false;
+    }
+    glViewport(0, 0, width, height);
+
+    return true;
+}
+
+void EGLOffscreen::release()
+{
+    if (_context != EGL_NO_CONTEXT) {
+        if (make_current()) {
+            if (_fbo) glDeleteFramebuffers(1, &_fbo);
+            if (_color_tex) glDeleteTextures(1, &_color_tex);
+        }
+        done_current();
+        eglDestroyContext(_display, _context);
+    }
+    _fbo = _color_tex = 0;
+    _context = EGL_NO_CONTEXT;
+
+    if (_surface != EGL_NO_SURFACE) {
+        eglDestroySurface(_display, _surface);
+        _surface = EGL_NO_SURFACE;
+    }
+
+    if (_own_display && _display != EGL_NO_DISPLAY) {
+        eglTerminate(_display);
+    }
+    _own_display = false;
+    _display = EGL_NO_DISPLAY;
+}
+
+bool EGLOffscreen::make_current()
+{
+    return eglMakeCurrent(_display, _surface, _surface, _context) == EGL_TRUE;
+}
+
+void EGLOffscreen::done_current()
+{
+    eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+bool EGLOffscreen::has_extension(const char *name) const
+{
+    return extension_list_has(eglQueryString(_display, EGL_EXTENSIONS), name);
+}
@@ -0,0 +1,53 @@
+#ifndef _EGL_UTIL_H
+#define _EGL_UTIL_H
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+
+/**
+ * headless GLES2 context rendering into a fbo of the requested size.
+ * tries the mesa surfaceless platform first and falls back to a pbuffer
+ * on the default display, so it works without X or drm master.
+ */
+class EGLOffscreen {
+public:
+    EGLOffscreen() = default;
+    ~EGLOffscreen();
+
+    EGLOffscreen(const EGLOffscreen&) = delete;
+    EGLOffscreen& operator=(const EGLOffscreen&) = delete;
+
+    // share: context of another EGLOffscreen on the same display, or
+    // EGL_NO_CONTEXT. display: reuse an initialized display.
+    bool create(int width, int height, EGLDisplay display = EGL_NO_DISPLAY,
+            EGLContext share = EGL_NO_CONTEXT);
+    void release();
+
+    bool make_current();
+    void done_current();
+
+    bool has_extension(const char *name) const;
+
+    EGLDisplay display() const { return _display; }
+    EGLContext context() const { return _context; }
+    EGLConfig config() const { return _config; }
+    GLuint fbo() const { return _fbo; }
+    GLuint color_texture() const { return _color_tex; }
+    int width() const { return _width; }
+    int height() const { return _height; }
+
+private:
+    EGLDisplay _display {EGL_NO_DISPLAY};
+    EGLContext _context {EGL_NO_CONTEXT};
+    EGLSurface _surface {EGL_NO_SURFACE};
+    EGLConfig _config {nullptr};
+    bool _own_display {false};
+
+    GLuint _fbo {0}, _color_tex {0};
+    int _width {0}, _height {0};
+};
+
+EGLDisplay egl_open_headless_display();
+
+#endif
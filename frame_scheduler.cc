@@ -0,0 +1,106 @@
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <iostream>
+
+#include "benchutil.h"
+#include "frame_scheduler.h"
+
+using namespace std;
+
+FrameScheduler::FrameScheduler(Mode mode, int event_fd, double rate_hz)
+    :_mode(mode), _event_fd(event_fd), _rate_hz(rate_hz)
+{
+}
+
+FrameScheduler::~FrameScheduler()
+{
+    if (_timer_fd >= 0) close(_timer_fd);
+}
+
+const char* FrameScheduler::mode_name(Mode mode)
+{
+    return mode == VSync ? "vsync" : "fixed";
+}
+
+bool FrameScheduler::start()
+{
+    if (_mode == VSync) return true;
+
+    if (_rate_hz <= 0) {
+        cerr << "invalid frame rate " << _rate_hz << endl;
+        return false;
+    }
+
+    _timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (_timer_fd < 0) {
+        cerr << "timerfd_create: " << strerror(errno) << endl;
+        return false;
+    }
+
+    uint64_t period = (uint64_t)(1e9 / _rate_hz);
+    struct itimerspec its;
+    its.it_interval.tv_sec = period / 1000000000ull;
+    its.it_interval.tv_nsec = period % 1000000000ull;
+    its.it_value = its.it_interval;
+    if (timerfd_settime(_timer_fd, 0, &its, NULL) < 0) {
+        cerr << "timerfd_settime: " << strerror(errno) << endl;
+        return false;
+    }
+    return true;
+}
+
+uint64_t FrameScheduler::next_frame_ns() const
+{
+    uint64_t now = bench_now_ns();
+    if (_timer_fd < 0) return now;
+
+    // an expiration not read yet is a frame that is already due
+    struct pollfd pfd = { _timer_fd, POLLIN, 0 };
+    struct itimerspec its;
+    if (poll(&pfd, 1, 0) != 0 || timerfd_gettime(_timer_fd, &its) < 0) return now;
+    return now + its.it_value.tv_sec * 1000000000ull + its.it_value.tv_nsec;
+}
+
+FrameScheduler::Wake FrameScheduler::wait(uint64_t deadline_ns)
+{
+    for (;;) {
+        uint64_t now = bench_now_ns();
+        if (now >= deadline_ns) return Deadline;
+
+        struct pollfd fds[2];
+        int nfds = 0;
+        fds[nfds].fd = _event_fd;
+        fds[nfds++].events = POLLIN;
+        if (_timer_fd >= 0) {
+            fds[nfds].fd = _timer_fd;
+            fds[nfds++].events = POLLIN;
+        }
+
+        // in vsync mode only peek for events, the swap blocks for us
+        int timeout = 0;
+        if (_mode == FixedRate) {
+            timeout = (int)((deadline_ns - now + 999999) / 1000000);
+        }
+
+        int ret = poll(fds, nfds, timeout);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            cerr << "poll: " << strerror(errno) << endl;
+            return Deadline;
+        }
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) return Events;
+        if (_mode == VSync) return Frame;
+
+        if (nfds > 1 && (fds[1].revents & POLLIN)) {
+            uint64_t expirations = 0;
+            if (read(_timer_fd, &expirations, sizeof expirations) == sizeof expirations) {
+                if (expirations > 1) _missed += expirations - 1;
+                return Frame;
+            }
+        }
+    }
+}
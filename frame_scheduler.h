@@ -0,0 +1,45 @@
+#ifndef _FRAME_SCHEDULER_H
+#define _FRAME_SCHEDULER_H
+
+#include <stdint.h>
+
+/**
+ * decides when the next frame is due without spinning. the caller's event
+ * fd (e.g. ConnectionNumber of the X display) and, in FixedRate mode, a
+ * timerfd are waited on with poll(). in VSync mode frames are due back to
+ * back and the swap itself (swap interval 1) does the throttling.
+ */
+class FrameScheduler {
+public:
+    enum Mode { FixedRate, VSync };
+    enum Wake { Frame, Events, Deadline };
+
+    FrameScheduler(Mode mode, int event_fd, double rate_hz = 60.0);
+    ~FrameScheduler();
+
+    FrameScheduler(const FrameScheduler&) = delete;
+    FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+    static const char* mode_name(Mode mode);
+
+    bool start();
+    // blocks until a frame is due, event_fd is readable or the monotonic
+    // deadline (bench_now_ns() clock) has passed. events already queued
+    // in the client library must be drained before calling this.
+    Wake wait(uint64_t deadline_ns);
+    // when the next frame is due, now in vsync mode where the swap blocks
+    uint64_t next_frame_ns() const;
+
+    Mode mode() const { return _mode; }
+    // timer periods that elapsed without a frame being rendered
+    uint64_t missed() const { return _missed; }
+
+private:
+    Mode _mode;
+    int _event_fd;
+    int _timer_fd {-1};
+    double _rate_hz;
+    uint64_t _missed {0};
+};
+
+#endif
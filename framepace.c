@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GLES2/gl2.h>
+
+#include "benchutil.h"
+#include "eglfence.h"
+#include "framepace.h"
+
+void pacer_init(struct frame_pacer *p, EGLDisplay display, int max_in_flight,
+        int present_events)
+{
+    memset(p, 0, sizeof *p);
+    p->display = display;
+    p->max_in_flight = max_in_flight < 1 ? 1 :
+        max_in_flight > PACER_MAX_FRAMES ? PACER_MAX_FRAMES : max_in_flight;
+    p->present_events = present_events;
+    p->have_fences = egl_fence_supported(display);
+    for (int i = 0; i < PACER_MAX_FRAMES; i++) p->frames[i].fence = EGL_NO_SYNC_KHR;
+}
+
+int pacer_in_flight(const struct frame_pacer *p)
+{
+    return p->head - p->tail;
+}
+
+static void add_latency(struct frame_pacer *p, double ms)
+{
+    if (p->n_latency == p->cap_latency) {
+        size_t cap = p->cap_latency ? p->cap_latency * 2 : 1024;
+        double *d = realloc(p->latency_ms, cap * sizeof *d);
+        if (!d) return;
+        p->latency_ms = d;
+        p->cap_latency = cap;
+    }
+    p->latency_ms[p->n_latency++] = ms;
+}
+
+static void drop_fence(struct frame_pacer *p, struct paced_frame *f)
+{
+    if (f->fence != EGL_NO_SYNC_KHR)
+        egl_fence_procs()->DestroySync(p->display, f->fence);
+    f->fence = EGL_NO_SYNC_KHR;
+}
+
+static void retire(struct frame_pacer *p, uint64_t ns)
+{
+    struct paced_frame *f = &p->frames[p->tail++ % PACER_MAX_FRAMES];
+    drop_fence(p, f);
+    add_latency(p, bench_ns_to_ms(ns > f->start_ns ? ns - f->start_ns : 0));
+}
+
+static int fence_wait(struct frame_pacer *p, struct paced_frame *f, EGLTimeKHR timeout)
+{
+    if (f->fence == EGL_NO_SYNC_KHR) return 1;
+    return egl_fence_procs()->ClientWaitSync(p->display, f->fence,
+            EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, timeout) == EGL_CONDITION_SATISFIED_KHR;
+}
+
+void pacer_wait(struct frame_pacer *p, uint64_t until_ns)
+{
+    if (p->present_events) return;
+    while (p->tail != p->head) {
+        uint64_t now = bench_now_ns();
+        EGLTimeKHR timeout = until_ns > now ? until_ns - now : 0;
+        if (!fence_wait(p, &p->frames[p->tail % PACER_MAX_FRAMES], timeout)) break;
+        retire(p, bench_now_ns());
+    }
+}
+
+unsigned pacer_begin_frame(struct frame_pacer *p)
+{
+    if (!p->present_events) {
+        pacer_wait(p, 0);
+        if (pacer_in_flight(p) >= p->max_in_flight) p->blocked++;
+        while (pacer_in_flight(p) >= p->max_in_flight) {
+            fence_wait(p, &p->frames[p->tail % PACER_MAX_FRAMES], EGL_FOREVER_KHR);
+            retire(p, bench_now_ns());
+        }
+    }
+
+    struct paced_frame *f = &p->frames[p->head % PACER_MAX_FRAMES];
+    drop_fence(p, f);
+    f->start_ns = bench_now_ns();
+    return p->head++;
+}
+
+void pacer_end_frame(struct frame_pacer *p)
+{
+    struct paced_frame *f = &p->frames[(p->head - 1) % PACER_MAX_FRAMES];
+    if (p->have_fences) {
+        f->fence = egl_fence_procs()->CreateSync(p->display, EGL_SYNC_FENCE_KHR, NULL);
+        return;
+    }
+    // no fences: the frame is done when it returns, one frame in flight
+    glFinish();
+    if (!p->present_events) retire(p, bench_now_ns());
+}
+
+int pacer_frame_done(struct frame_pacer *p, unsigned seq)
+{
+    if (seq - p->tail >= (unsigned)pacer_in_flight(p)) return 1;
+    return fence_wait(p, &p->frames[seq % PACER_MAX_FRAMES], 0);
+}
+
+void pacer_presented(struct frame_pacer *p, uint64_t ns)
+{
+    if (p->tail != p->head) retire(p, ns);
+}
+
+void pacer_print(struct frame_pacer *p, const char *label)
+{
+    struct bench_stats st;
+    bench_stats_compute(p->latency_ms, p->n_latency, &st);
+    bench_stats_print(label, "ms", &st);
+    printf("%-24s %d in flight, %s, %lu frames waited for the cap\n", "",
+            p->max_in_flight, p->have_fences ? "EGL_KHR_fence_sync" : "glFinish",
+            p->blocked);
+}
+
+void pacer_release(struct frame_pacer *p)
+{
+    for (int i = 0; i < PACER_MAX_FRAMES; i++) drop_fence(p, &p->frames[i]);
+    free(p->latency_ms);
+    memset(p, 0, sizeof *p);
+}
@@ -0,0 +1,65 @@
+#ifndef _FRAME_PACE_H
+#define _FRAME_PACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * bounds the frames the driver queues ahead with one EGL_KHR_fence_sync per
+ * frame. a frame is in flight from pacer_begin_frame, which stands for the
+ * input sample, until it retires: when its fence signals (swap completion)
+ * or, with present events, when the caller reports its page flip. latency
+ * is input sample to retirement. a retirement is only seen while the
+ * pacer waits on a fence: call pacer_wait for the idle time between frames,
+ * otherwise it shows up when the next frame starts and latency includes the
+ * idle time.
+ */
+#define PACER_MAX_FRAMES 8
+
+struct paced_frame {
+    uint64_t start_ns;
+    EGLSyncKHR fence;
+};
+
+struct frame_pacer {
+    EGLDisplay display;
+    int max_in_flight;
+    int present_events;
+    int have_fences;                // glFinish per frame without the extension
+    struct paced_frame frames[PACER_MAX_FRAMES];
+    unsigned head, tail;            // next frame to start and oldest in flight
+    unsigned long blocked;          // frames that had to wait for the cap
+    double *latency_ms;
+    size_t n_latency, cap_latency;
+};
+
+/* the context has to be current. max_in_flight is clamped to 1..PACER_MAX_FRAMES */
+void pacer_init(struct frame_pacer *p, EGLDisplay display, int max_in_flight,
+        int present_events);
+int pacer_in_flight(const struct frame_pacer *p);
+/* without present events waits until fewer than max_in_flight frames are in
+ * flight. takes the input sample and returns the sequence number of the frame */
+unsigned pacer_begin_frame(struct frame_pacer *p);
+/* without present events retires the frames in flight as their fences
+ * signal, until none is left or the monotonic until_ns has passed */
+void pacer_wait(struct frame_pacer *p, uint64_t until_ns);
+/* fences the frame, after its swap */
+void pacer_end_frame(struct frame_pacer *p);
+/* non-zero once the gpu has finished frame seq, never blocks */
+int pacer_frame_done(struct frame_pacer *p, unsigned seq);
+/* present events: the oldest frame in flight reached the screen at ns */
+void pacer_presented(struct frame_pacer *p, uint64_t ns);
+void pacer_print(struct frame_pacer *p, const char *label);
+void pacer_release(struct frame_pacer *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
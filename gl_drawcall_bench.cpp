@@ -0,0 +1,356 @@
+/**
+ * cpu cost of issuing draws: plain draw calls, uniform updates with and
+ * without cached locations, program switches and texture binds, against
+ * batching all quads into one draw or one instanced draw.
+ *
+ * only submission is timed. the gpu is drained between frames outside the
+ * timed region and quads are tiny so rasterization stays negligible.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "glutil.h"
+#include "eglutil.h"
+#include "benchutil.h"
+#include "memstat.h"
+#include "benchresult.h"
+
+#define err_msg(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+} while (0)
+
+#define err_quit(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+    exit(1); \
+} while (0)
+
+using namespace std;
+
+static const char* vert_shader = R"(
+attribute vec2 position;
+uniform vec2 offset;
+
+void main() {
+    gl_Position = vec4(position.xy + offset, 0.0, 1.0);
+}
+)";
+static const char* frag_shader = R"(
+precision mediump float;
+uniform vec4 color;
+uniform sampler2D tex;
+void main() {
+    gl_FragColor = color * texture2D(tex, vec2(0.5));
+}
+)";
+// same quads, positioned from gl_InstanceIDEXT instead of a uniform
+static const char* instanced_vert_shader = R"(
+#extension GL_EXT_draw_instanced : require
+attribute vec2 position;
+
+void main() {
+    float id = float(gl_InstanceIDEXT);
+    // the grid of quad_offset(), moved to -1..1 like the offset uniform
+    vec2 offset = vec2(mod(id, 64.0), mod(floor(id / 64.0), 64.0)) * (2.0 / 64.0) - 1.0;
+    gl_Position = vec4(position.xy + offset, 0.0, 1.0);
+}
+)";
+
+static struct {
+    int draws;
+    int frames;
+    double budget_ms;
+    const char* which;
+} opts = {
+    2000, 100, 4.0, "all",
+};
+
+static struct {
+    GLProgram prog[2];
+    GLProgram instanced;
+    GLint offset_loc[2], color_loc[2];
+    GLuint tex[2];
+    GLBuffer quad {GL_ARRAY_BUFFER};
+    GLBuffer batch {GL_ARRAY_BUFFER};
+    PFNGLDRAWARRAYSINSTANCEDEXTPROC DrawArraysInstanced;
+} gs;
+
+static const float QUAD_SIZE = 2.0f / 512;
+
+static void quad_offset(int i, float *x, float *y)
+{
+    *x = (i % 64) * (2.0f / 64);
+    *y = ((i / 64) % 64) * (2.0f / 64);
+}
+
+static void bind_geometry(const GLProgram& prog, const GLBuffer& vbo)
+{
+    vbo.bind();
+    GLint pos = prog.attrib("position");
+    glEnableVertexAttribArray(pos);
+    glVertexAttribPointer(pos, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+}
+
+static void use_program(int idx)
+{
+    gs.prog[idx].use();
+    glUniform2f(gs.offset_loc[idx], -1.0f, -1.0f);
+    glUniform4f(gs.color_loc[idx], 1.0f, 0.5f, 0.25f, 1.0f);
+    bind_geometry(gs.prog[idx], gs.quad);
+}
+
+static void frame_draw(int draws)
+{
+    for (int i = 0; i < draws; i++) {
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+}
+
+// what opengl_test's render() used to do on every frame
+static void frame_uniform_lookup(int draws)
+{
+    GLuint program = gs.prog[0].id();
+    for (int i = 0; i < draws; i++) {
+        float x, y;
+        quad_offset(i, &x, &y);
+        glUniform2f(glGetUniformLocation(program, "offset"), x - 1.0f, y - 1.0f);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+}
+
+static void frame_uniform_cached(int draws)
+{
+    GLint loc = gs.offset_loc[0];
+    for (int i = 0; i < draws; i++) {
+        float x, y;
+        quad_offset(i, &x, &y);
+        glUniform2f(loc, x - 1.0f, y - 1.0f);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+}
+
+static void frame_program_switch(int draws)
+{
+    for (int i = 0; i < draws; i++) {
+        gs.prog[i & 1].use();
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+}
+
+static void frame_texture_bind(int draws)
+{
+    for (int i = 0; i < draws; i++) {
+        glBindTexture(GL_TEXTURE_2D, gs.tex[i & 1]);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+}
+
+static void frame_batched(int draws)
+{
+    glDrawArrays(GL_TRIANGLES, 0, 6 * draws);
+}
+
+static void frame_instanced(int draws)
+{
+    gs.DrawArraysInstanced(GL_TRIANGLES, 0, 6, draws);
+}
+
+static bool setup_plain()
+{
+    use_program(0);
+    glBindTexture(GL_TEXTURE_2D, gs.tex[0]);
+    return true;
+}
+
+static bool setup_switch()
+{
+    // state of both programs is set up front, only glUseProgram is timed
+    use_program(1);
+    use_program(0);
+    glBindTexture(GL_TEXTURE_2D, gs.tex[0]);
+    return true;
+}
+
+static bool setup_batched()
+{
+    vector<GLfloat> verts;
+    verts.reserve(opts.draws * 12);
+    for (int i = 0; i < opts.draws; i++) {
+        float x, y;
+        quad_offset(i, &x, &y);
+        float s = QUAD_SIZE;
+        GLfloat q[] = { x, y, x, y+s, x+s, y+s, x+s, y+s, x+s, y, x, y };
+        verts.insert(verts.end(), q, q + 12);
+    }
+    gs.batch.data(verts.size() * sizeof(GLfloat), verts.data(), GL_STATIC_DRAW);
+
+    gs.prog[0].use();
+    glUniform2f(gs.offset_loc[0], -1.0f, -1.0f);
+    glUniform4f(gs.color_loc[0], 1.0f, 0.5f, 0.25f, 1.0f);
+    bind_geometry(gs.prog[0], gs.batch);
+    glBindTexture(GL_TEXTURE_2D, gs.tex[0]);
+    return true;
+}
+
+static bool setup_instanced()
+{
+    if (!gs.DrawArraysInstanced || !gs.instanced.valid()) return false;
+
+    gs.instanced.use();
+    bind_geometry(gs.instanced, gs.quad);
+    glBindTexture(GL_TEXTURE_2D, gs.tex[0]);
+    return true;
+}
+
+struct Case {
+    const char* name;
+    bool (*setup)();
+    void (*frame)(int draws);
+};
+
+static const Case cases[] = {
+    {"draw", setup_plain, frame_draw},
+    {"uniform-lookup", setup_plain, frame_uniform_lookup},
+    {"uniform-cached", setup_plain, frame_uniform_cached},
+    {"program-switch", setup_switch, frame_program_switch},
+    {"texture-bind", setup_plain, frame_texture_bind},
+    {"batched", setup_batched, frame_batched},
+    {"instanced", setup_instanced, frame_instanced},
+};
+
+static int run_case(const Case& c)
+{
+    if (!c.setup()) {
+        printf("%-24s unsupported by this context, skipped\n", c.name);
+        return 0;
+    }
+
+    // one untimed frame to get shaders and state compiled
+    c.frame(opts.draws);
+    glFinish();
+
+    vector<double> ns_per_draw;
+    ns_per_draw.reserve(opts.frames);
+    for (int frame = 0; frame < opts.frames; frame++) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        uint64_t t0 = bench_now_ns();
+        c.frame(opts.draws);
+        uint64_t t1 = bench_now_ns();
+        glFinish();
+        ns_per_draw.push_back((double)(t1 - t0) / opts.draws);
+    }
+
+    if (glGetError() != GL_NO_ERROR) {
+        err_msg("%s: gl error\n", c.name);
+        return 1;
+    }
+
+    struct bench_stats st;
+    bench_stats_compute(ns_per_draw.data(), ns_per_draw.size(), &st);
+    bench_stats_print(c.name, "ns/quad", &st);
+    bench_result_record("gl_drawcall_bench", c.name, "ns/quad", 1, ns_per_draw.data(),
+            ns_per_draw.size());
+    printf("%-24s %.0f quads/s, %.0f quads within a %.1f ms cpu budget\n", "",
+            1e9 / st.median, opts.budget_ms * 1e6 / st.median, opts.budget_ms);
+    return 0;
+}
+
+static bool setup_objects()
+{
+    for (int i = 0; i < 2; i++) {
+        gs.prog[i] = GLProgram(vert_shader, frag_shader);
+        if (!gs.prog[i].valid()) return false;
+        gs.offset_loc[i] = gs.prog[i].uniform("offset");
+        gs.color_loc[i] = gs.prog[i].uniform("color");
+    }
+
+    if (gl_has_extension("GL_EXT_draw_instanced")) {
+        gs.DrawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDEXTPROC)
+            eglGetProcAddress("glDrawArraysInstancedEXT");
+        gs.instanced = GLProgram(instanced_vert_shader, frag_shader);
+        if (gs.instanced.valid()) {
+            gs.instanced.use();
+            glUniform4f(gs.instanced.uniform("color"), 0.25f, 0.5f, 1.0f, 1.0f);
+        }
+    }
+
+    float s = QUAD_SIZE;
+    GLfloat quad[] = { 0, 0, 0, s, s, s, s, s, s, 0, 0, 0 };
+    gs.quad.data(sizeof quad, quad, GL_STATIC_DRAW);
+
+    glGenTextures(2, gs.tex);
+    for (int i = 0; i < 2; i++) {
+        GLubyte px[4] = { (GLubyte)(i ? 255 : 128), 255, 255, 255 };
+        glBindTexture(GL_TEXTURE_2D, gs.tex[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+                GL_UNSIGNED_BYTE, px);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    return true;
+}
+
+static void release_objects()
+{
+    glDeleteTextures(2, gs.tex);
+    gs.prog[0].reset();
+    gs.prog[1].reset();
+    gs.instanced.reset();
+    gs.quad = GLBuffer(GL_ARRAY_BUFFER);
+    gs.batch = GLBuffer(GL_ARRAY_BUFFER);
+}
+
+static void usage(const char* prog)
+{
+    err_quit("usage: %s [-n draws] [-f frames] [-b budget_ms] [-c case]\n"
+            "cases: all draw uniform-lookup uniform-cached program-switch "
+            "texture-bind batched instanced\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    int c;
+    while ((c = getopt(argc, argv, "n:f:b:c:")) != -1) {
+        switch (c) {
+            case 'n': opts.draws = atoi(optarg); break;
+            case 'f': opts.frames = atoi(optarg); break;
+            case 'b': opts.budget_ms = atof(optarg); break;
+            case 'c': opts.which = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (opts.draws <= 0 || opts.frames <= 0 || opts.budget_ms <= 0) usage(argv[0]);
+
+    EGLOffscreen egl;
+    if (!egl.create(512, 512)) {
+        err_quit("cannot create offscreen context\n");
+    }
+    if (!setup_objects()) err_quit("cannot build programs\n");
+
+    printf("renderer: %s, %d quads per frame, %d frames\n",
+            glGetString(GL_RENDERER), opts.draws, opts.frames);
+    bench_result_gl_driver();
+
+    struct memstat mem = {0};
+    int ret = 0;
+    bool matched = false;
+    for (auto& tc: cases) {
+        if (strcmp(opts.which, "all") && strcmp(opts.which, tc.name))
+            continue;
+        matched = true;
+        memstat_sample(&mem, tc.name);
+        ret |= run_case(tc);
+        memstat_sample(&mem, tc.name);
+    }
+
+    release_objects();
+    egl.release();
+    memstat_sample(&mem, "end");
+    memstat_report(&mem, "gl_drawcall_bench");
+    memstat_release(&mem);
+    if (!matched) usage(argv[0]);
+    return ret;
+}
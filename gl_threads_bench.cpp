@@ -0,0 +1,324 @@
+/**
+ * renders the same workload from 1..N threads at once, each thread owning
+ * an offscreen EGL context on one shared display. in shared mode all
+ * contexts share the vertex buffer and texture of a root context, in
+ * unshared mode every context builds its own. programs are always per
+ * thread: uniforms are program state, one shared program would have the
+ * threads overwrite each other's values. reports per-thread frame times, aggregate
+ * throughput and scaling efficiency against the single thread run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "glutil.h"
+#include "eglutil.h"
+#include "benchutil.h"
+#include "memstat.h"
+#include "benchresult.h"
+
+#define err_msg(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+} while (0)
+
+#define err_quit(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+    exit(1); \
+} while (0)
+
+using namespace std;
+
+static const char* vert_shader = R"(
+attribute vec2 position;
+varying vec2 v_uv;
+
+void main() {
+    v_uv = position * 0.5 + 0.5;
+    gl_Position = vec4(position.xy, 0.0, 1.0);
+}
+)";
+// a few dependent texture fetches and some alu per pixel, roughly what a
+// compositor does for a decorated window
+static const char* frag_shader = R"(
+precision mediump float;
+uniform sampler2D tex;
+uniform float phase;
+varying vec2 v_uv;
+
+void main() {
+    vec4 c = texture2D(tex, v_uv);
+    c += texture2D(tex, v_uv + vec2(c.r, c.g) * 0.01);
+    c.rgb = c.rgb * 0.5 + 0.25 * sin(v_uv.xyx * 6.0 + phase);
+    gl_FragColor = c;
+}
+)";
+
+static struct {
+    int max_threads;
+    int frames;
+    int width, height;
+    int quads;
+    const char* variant;
+} opts = {
+    0, 200, 640, 480, 16, "all",
+};
+
+// geometry and texture a thread renders with, owned either by the thread
+// or by the root context in shared mode
+struct Scene {
+    GLBuffer vbo;
+    GLuint tex {0};
+
+    bool build()
+    {
+        vector<GLfloat> verts;
+        for (int i = 0; i < opts.quads; i++) {
+            // overlapping layers, each a bit smaller than the previous one
+            float s = 1.0f - (float)i / (opts.quads + 1);
+            GLfloat q[] = { -s, -s, -s, s, s, s, s, s, s, -s, -s, -s };
+            verts.insert(verts.end(), q, q + 12);
+        }
+        vbo.data(verts.size() * sizeof(GLfloat), verts.data(), GL_STATIC_DRAW);
+
+        const int tw = 256, th = 256;
+        vector<GLubyte> pixels(tw * th * 4);
+        for (int i = 0; i < tw * th; i++) {
+            pixels[i*4+0] = i & 0xff;
+            pixels[i*4+1] = (i >> 8) & 0xff;
+            pixels[i*4+2] = (i * 7) & 0xff;
+            pixels[i*4+3] = 0xff;
+        }
+        glGenTextures(1, &tex);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tw, th, 0, GL_RGBA,
+                GL_UNSIGNED_BYTE, pixels.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glFinish();
+        return true;
+    }
+
+    void release()
+    {
+        if (tex) glDeleteTextures(1, &tex);
+        tex = 0;
+        vbo = GLBuffer(GL_ARRAY_BUFFER);
+    }
+};
+
+// C++11 has no std::barrier
+class StartGate {
+public:
+    explicit StartGate(int count) :_waiting(count) {}
+
+    void arrive_and_wait()
+    {
+        unique_lock<mutex> lk(_lock);
+        if (--_waiting == 0) {
+            _start_ns = bench_now_ns();
+            _cond.notify_all();
+        } else {
+            _cond.wait(lk, [this] { return _waiting == 0; });
+        }
+    }
+
+    uint64_t start_ns() const { return _start_ns; }
+
+private:
+    mutex _lock;
+    condition_variable _cond;
+    int _waiting;
+    uint64_t _start_ns {0};
+};
+
+struct Worker {
+    int id;
+    vector<double> frame_ms;
+    bool failed {false};
+};
+
+static void draw_scene(const GLProgram& prog, const Scene& scene, int frame)
+{
+    prog.use();
+    glUniform1i(prog.uniform("tex"), 0);
+    glUniform1f(prog.uniform("phase"), frame * 0.05f);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, scene.tex);
+
+    scene.vbo.bind();
+    GLint pos = prog.attrib("position");
+    glEnableVertexAttribArray(pos);
+    glVertexAttribPointer(pos, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDrawArrays(GL_TRIANGLES, 0, opts.quads * 6);
+}
+
+static void worker_main(Worker* w, EGLDisplay display, EGLContext share,
+        const Scene* shared_scene, StartGate* gate)
+{
+    EGLOffscreen egl;
+    GLProgram prog;
+    Scene own;
+    const Scene* scene = shared_scene;
+
+    if (!egl.create(opts.width, opts.height, display, share)) {
+        w->failed = true;
+    } else {
+        prog = GLProgram(vert_shader, frag_shader);
+        w->failed = !prog.valid();
+        if (!w->failed && !shared_scene) {
+            w->failed = !own.build();
+            scene = &own;
+        }
+    }
+
+    gate->arrive_and_wait();
+
+    if (!w->failed) {
+        w->frame_ms.reserve(opts.frames);
+        for (int frame = 0; frame < opts.frames; frame++) {
+            uint64_t t0 = bench_now_ns();
+            draw_scene(prog, *scene, frame);
+            // stands in for the swap: the frame is done when the gpu is
+            glFinish();
+            w->frame_ms.push_back(bench_ns_to_ms(bench_now_ns() - t0));
+        }
+        if (glGetError() != GL_NO_ERROR) w->failed = true;
+    }
+
+    prog.reset();
+    own.release();
+    egl.release();
+    eglReleaseThread();
+}
+
+// returns aggregate frames per second, or a negative value on failure
+static double run(int nthreads, bool shared, EGLDisplay display,
+        EGLOffscreen& root, const Scene& root_scene)
+{
+    vector<Worker> workers(nthreads);
+    vector<thread> threads;
+    StartGate gate(nthreads + 1);
+
+    for (int i = 0; i < nthreads; i++) {
+        workers[i].id = i;
+        threads.push_back(thread(worker_main, &workers[i], display,
+                    shared ? root.context() : EGL_NO_CONTEXT,
+                    shared ? &root_scene : nullptr, &gate));
+    }
+
+    gate.arrive_and_wait();
+    for (auto& t: threads) t.join();
+    double wall_s = (bench_now_ns() - gate.start_ns()) / 1e9;
+
+    long frames = 0;
+    for (auto& w: workers) {
+        if (w.failed) {
+            err_msg("thread %d failed\n", w.id);
+            return -1.0;
+        }
+        frames += w.frame_ms.size();
+    }
+
+    vector<double> all_ms;
+    for (auto& w: workers) {
+        struct bench_stats st;
+        char label[64];
+        all_ms.insert(all_ms.end(), w.frame_ms.begin(), w.frame_ms.end());
+        snprintf(label, sizeof label, "  thread %d", w.id);
+        bench_stats_compute(w.frame_ms.data(), w.frame_ms.size(), &st);
+        bench_stats_print(label, "ms/frame", &st);
+    }
+    char metric[64];
+    snprintf(metric, sizeof metric, "%s %d threads", shared ? "shared" : "unshared", nthreads);
+    bench_result_record("gl_threads_bench", metric, "ms/frame", 1, all_ms.data(),
+            all_ms.size());
+
+    return frames / wall_s;
+}
+
+static void usage(const char* prog)
+{
+    err_quit("usage: %s [-t max_threads] [-f frames] [-s WxH] [-q quads] "
+            "[-m all|shared|unshared]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    int c;
+    while ((c = getopt(argc, argv, "t:f:s:q:m:")) != -1) {
+        switch (c) {
+            case 't': opts.max_threads = atoi(optarg); break;
+            case 'f': opts.frames = atoi(optarg); break;
+            case 's':
+                if (sscanf(optarg, "%dx%d", &opts.width, &opts.height) != 2)
+                    usage(argv[0]);
+                break;
+            case 'q': opts.quads = atoi(optarg); break;
+            case 'm': opts.variant = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (opts.max_threads <= 0) opts.max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (opts.frames <= 0 || opts.quads <= 0) usage(argv[0]);
+
+    bool do_shared = !strcmp(opts.variant, "all") || !strcmp(opts.variant, "shared");
+    bool do_unshared = !strcmp(opts.variant, "all") || !strcmp(opts.variant, "unshared");
+    if (!do_shared && !do_unshared) usage(argv[0]);
+
+    EGLDisplay display = egl_open_headless_display();
+    if (display == EGL_NO_DISPLAY) err_quit("no EGL display\n");
+
+    struct memstat mem = {0};
+    int ret = 0;
+    {
+        EGLOffscreen root;
+        Scene root_scene;
+        if (!root.create(opts.width, opts.height, display) || !root_scene.build())
+            err_quit("cannot create root context\n");
+        printf("renderer: %s, %d frames of %d quads at %dx%d per thread\n",
+                glGetString(GL_RENDERER), opts.frames, opts.quads,
+                opts.width, opts.height);
+        bench_result_gl_driver();
+        if (getenv("LP_NUM_THREADS"))
+            printf("LP_NUM_THREADS=%s\n", getenv("LP_NUM_THREADS"));
+        root.done_current();
+
+        for (int pass = 0; pass < 2; pass++) {
+            bool shared = pass == 0;
+            if ((shared && !do_shared) || (!shared && !do_unshared)) continue;
+
+            double base = 0.0;
+            for (int n = 1; n <= opts.max_threads; n++) {
+                memstat_sample(&mem, "run");
+                printf("%s contexts, %d thread(s):\n", shared ? "shared" : "unshared", n);
+                double fps = run(n, shared, display, root, root_scene);
+                if (fps < 0) {
+                    ret = 1;
+                    break;
+                }
+                if (n == 1) base = fps;
+                printf("  aggregate %.1f fps, %.1f fps/thread, scaling efficiency %.0f%%\n",
+                        fps, fps / n, base > 0 ? 100.0 * fps / (n * base) : 0.0);
+            }
+        }
+
+        root.make_current();
+        root_scene.release();
+    }
+
+    eglTerminate(display);
+    memstat_sample(&mem, "end");
+    memstat_report(&mem, "gl_threads_bench");
+    memstat_release(&mem);
+    return ret;
+}
@@ -0,0 +1,270 @@
+/**
+ * compares ways of streaming per-frame ui geometry into a vertex buffer:
+ * glBufferData orphaning, glBufferSubData into one buffer, and the
+ * GLStreamBuffer ring in each mode the context supports.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include <string>
+
+#include "glutil.h"
+#include "eglutil.h"
+#include "benchutil.h"
+#include "memstat.h"
+#include "benchresult.h"
+
+#define err_msg(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+} while (0)
+
+#define err_quit(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+    exit(1); \
+} while (0)
+
+using namespace std;
+
+struct Vertex {
+    GLfloat x, y;
+    GLubyte rgba[4];
+};
+
+static const int VERTS_PER_QUAD = 6;
+
+static const char* vert_shader = R"(
+attribute vec2 position;
+attribute vec4 color;
+varying vec4 v_color;
+
+void main() {
+    v_color = color;
+    gl_Position = vec4(position.xy, 0.0, 1.0);
+}
+)";
+static const char* frag_shader = R"(
+varying mediump vec4 v_color;
+void main() {
+    gl_FragColor = v_color;
+}
+)";
+
+static struct {
+    int quads;
+    int frames;
+    int warmup;
+    int width, height;
+    const char* strategy;
+} opts = {
+    4096, 600, 30, 1280, 720, "all",
+};
+
+enum Strategy {
+    Orphan,
+    SubDataInPlace,
+    RingSubData,
+    RingMapRange,
+    RingPersistent,
+    StrategyCount,
+};
+
+static struct memstat mem;
+
+static const char* strategy_names[] = {
+    "orphan", "subdata", "ring-subdata", "ring-maprange", "ring-persistent",
+};
+
+// lays out a grid of small quads that drift a bit every frame, like a
+// toolkit relayouting and rebuilding all of its widgets
+static void build_geometry(Vertex *v, int quads, int frame)
+{
+    int cols = 64;
+    float cell = 2.0f / cols;
+    float size = cell * 0.8f;
+    float drift = (frame % 64) * cell * 0.002f;
+
+    for (int i = 0; i < quads; i++) {
+        float x0 = -1.0f + (i % cols) * cell + drift;
+        float y0 = -1.0f + ((i / cols) % cols) * cell;
+        float x1 = x0 + size, y1 = y0 + size;
+        GLubyte r = (GLubyte)(i * 37), g = (GLubyte)(frame * 3), b = (GLubyte)(i >> 4);
+
+        const float xy[VERTS_PER_QUAD][2] = {
+            {x0, y0}, {x0, y1}, {x1, y1},
+            {x1, y1}, {x1, y0}, {x0, y0},
+        };
+        for (int k = 0; k < VERTS_PER_QUAD; k++, v++) {
+            v->x = xy[k][0];
+            v->y = xy[k][1];
+            v->rgba[0] = r;
+            v->rgba[1] = g;
+            v->rgba[2] = b;
+            v->rgba[3] = 255;
+        }
+    }
+}
+
+static void set_layout(const GLProgram& prog, GLintptr offset)
+{
+    GLint pos = prog.attrib("position");
+    GLint color = prog.attrib("color");
+    glEnableVertexAttribArray(pos);
+    glVertexAttribPointer(pos, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+            (const void*)(offset + offsetof(Vertex, x)));
+    glEnableVertexAttribArray(color);
+    glVertexAttribPointer(color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+            (const void*)(offset + offsetof(Vertex, rgba)));
+}
+
+static int run_strategy(Strategy strategy, const GLProgram& prog)
+{
+    size_t frame_bytes = sizeof(Vertex) * VERTS_PER_QUAD * opts.quads;
+    GLsizei count = VERTS_PER_QUAD * opts.quads;
+
+    vector<Vertex> staging(VERTS_PER_QUAD * opts.quads);
+    GLBuffer vbo(GL_ARRAY_BUFFER);
+    GLStreamBuffer* ring = nullptr;
+
+    if (strategy == SubDataInPlace) {
+        vbo.data(frame_bytes, NULL, GL_STREAM_DRAW);
+    } else if (strategy >= RingSubData) {
+        GLStreamBuffer::Mode want = (GLStreamBuffer::Mode)(strategy - RingSubData);
+        ring = new GLStreamBuffer(frame_bytes, 3, want);
+        if (ring->mode() != want) {
+            printf("%-16s unsupported by this context, skipped\n",
+                    strategy_names[strategy]);
+            delete ring;
+            return 0;
+        }
+    }
+
+    vector<double> frame_ms;
+    frame_ms.reserve(opts.frames);
+
+    glFinish();
+    uint64_t start = 0;
+    int total = opts.warmup + opts.frames;
+    for (int frame = 0; frame < total; frame++) {
+        if (frame == opts.warmup) {
+            glFinish();
+            start = bench_now_ns();
+        }
+        uint64_t t0 = bench_now_ns();
+
+        glClear(GL_COLOR_BUFFER_BIT);
+        if (ring) {
+            GLintptr offset;
+            Vertex *dst = (Vertex*)ring->begin_frame(&offset);
+            build_geometry(dst, opts.quads, frame);
+            ring->commit(frame_bytes);
+            set_layout(prog, offset);
+            glDrawArrays(GL_TRIANGLES, 0, count);
+            ring->end_frame();
+        } else {
+            build_geometry(staging.data(), opts.quads, frame);
+            if (strategy == Orphan) {
+                // drop the old storage so the driver can hand out a new one
+                vbo.data(frame_bytes, NULL, GL_STREAM_DRAW);
+                vbo.sub_data(0, frame_bytes, staging.data());
+            } else {
+                vbo.sub_data(0, frame_bytes, staging.data());
+            }
+            set_layout(prog, 0);
+            glDrawArrays(GL_TRIANGLES, 0, count);
+        }
+        glFlush();
+
+        if (frame >= opts.warmup) {
+            frame_ms.push_back(bench_ns_to_ms(bench_now_ns() - t0));
+            if (frame % 30 == 0) memstat_sample(&mem, strategy_names[strategy]);
+        }
+    }
+    glFinish();
+    double wall_s = (bench_now_ns() - start) / 1e9;
+
+    GLenum err = glGetError();
+    unsigned long stalls = ring ? ring->stalls() : 0;
+    unsigned long map_failures = ring ? ring->map_failures() : 0;
+    delete ring;
+    if (err != GL_NO_ERROR) {
+        err_msg("%s: gl error 0x%x, %lu failed maps\n", strategy_names[strategy], err,
+                map_failures);
+        return 1;
+    }
+
+    struct bench_stats st;
+    bench_stats_compute(frame_ms.data(), frame_ms.size(), &st);
+    bench_stats_print(strategy_names[strategy], "ms/frame(cpu)", &st);
+    bench_result_record("gl_upload_bench", strategy_names[strategy], "ms/frame(cpu)", 1,
+            frame_ms.data(), frame_ms.size());
+    printf("%-24s %.1f fps, %.1f MB/s uploaded, %lu ring stalls\n", "",
+            opts.frames / wall_s, frame_bytes * opts.frames / wall_s / 1e6,
+            stalls);
+    if (map_failures)
+        printf("%-24s %lu failed maps staged through glBufferSubData\n", "",
+                map_failures);
+    return 0;
+}
+
+static void usage(const char* prog)
+{
+    err_quit("usage: %s [-n quads] [-f frames] [-w warmup] [-s WxH] [-m strategy]\n"
+            "strategies: all orphan subdata ring-subdata ring-maprange ring-persistent\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    int c;
+    while ((c = getopt(argc, argv, "n:f:w:s:m:")) != -1) {
+        switch (c) {
+            case 'n': opts.quads = atoi(optarg); break;
+            case 'f': opts.frames = atoi(optarg); break;
+            case 'w': opts.warmup = atoi(optarg); break;
+            case 's':
+                if (sscanf(optarg, "%dx%d", &opts.width, &opts.height) != 2)
+                    usage(argv[0]);
+                break;
+            case 'm': opts.strategy = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (opts.quads <= 0 || opts.frames <= 0 || opts.warmup < 0) usage(argv[0]);
+
+    EGLOffscreen egl;
+    if (!egl.create(opts.width, opts.height)) {
+        err_quit("cannot create offscreen context\n");
+    }
+
+    printf("renderer: %s\n", glGetString(GL_RENDERER));
+    bench_result_gl_driver();
+    printf("%d quads/frame (%zu bytes), %d frames at %dx%d\n", opts.quads,
+            sizeof(Vertex) * VERTS_PER_QUAD * opts.quads, opts.frames,
+            opts.width, opts.height);
+
+    memstat_sample(&mem, "setup");
+    int ret = 0;
+    {
+        GLProgram prog(vert_shader, frag_shader);
+        if (!prog.valid()) err_quit("cannot build program\n");
+        prog.use();
+
+        bool matched = false;
+        for (int i = 0; i < StrategyCount; i++) {
+            if (strcmp(opts.strategy, "all") && strcmp(opts.strategy, strategy_names[i]))
+                continue;
+            matched = true;
+            ret |= run_strategy((Strategy)i, prog);
+        }
+        if (!matched) usage(argv[0]);
+    }
+
+    egl.release();
+    memstat_sample(&mem, "end");
+    memstat_report(&mem, "gl_upload_bench");
+    memstat_release(&mem);
+    return ret;
+}
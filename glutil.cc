@@ -1,6 +1,7 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <string.h>
 
 using namespace std;
 
@@ -45,6 +46,26 @@ static GLuint create_shader(GLenum type, const char *source)
     return shader_id;
 }
 
+static GLuint link_program(GLuint vertex_shader_id, GLuint frag_shader_id)
+{
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex_shader_id);
+    glAttachShader(program, frag_shader_id);
+    glLinkProgram(program);
+
+    GLint ret;
+    glGetProgramiv(program, GL_LINK_STATUS, &ret);
+    if (ret == GL_FALSE) {
+        char buf[512];
+        glGetProgramInfoLog(program, sizeof buf - 1, NULL, buf);
+        cerr << buf << endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
 GLProcess* glprocess_create(const char *vertex_path, const char *frag_path,
         bool inmemory)
 {
@@ -63,28 +84,317 @@ GLProcess* glprocess_create(const char *vertex_path, const char *frag_path,
 
 
     GLProcess* proc = new GLProcess;
+    proc->vbo = 0;
     proc->vertex_shader_id = create_shader(GL_VERTEX_SHADER, vertex_shader.c_str());
     proc->frag_shader_id= create_shader(GL_FRAGMENT_SHADER, frag_shader.c_str());
     if (proc->vertex_shader_id == 0 || proc->frag_shader_id == 0) {
+        glDeleteShader(proc->vertex_shader_id);
+        glDeleteShader(proc->frag_shader_id);
         delete proc;
         return nullptr;
     }
 
-    GLuint program = glCreateProgram();
-    glAttachShader(program, proc->vertex_shader_id);
-    glAttachShader(program, proc->frag_shader_id);
-    glLinkProgram(program);
-    //TODO: check link error
-
+    proc->program = link_program(proc->vertex_shader_id, proc->frag_shader_id);
+    if (proc->program == 0) {
+        glDeleteShader(proc->vertex_shader_id);
+        glDeleteShader(proc->frag_shader_id);
+        delete proc;
+        return nullptr;
+    }
 
-    proc->program = program;
     return proc;
 }
 
 void glprocess_release(GLProcess* proc)
 {
-    glDeleteBuffers(1, &proc->vbo);
+    if (!proc) return;
+
+    if (proc->vbo) glDeleteBuffers(1, &proc->vbo);
     glDeleteShader(proc->vertex_shader_id);
     glDeleteShader(proc->frag_shader_id);
     glDeleteProgram(proc->program);
+    delete proc;
+}
+
+bool gl_has_extension(const char *name)
+{
+    return extension_list_has((const char*)glGetString(GL_EXTENSIONS), name);
+}
+
+GLProgram::GLProgram(const char *vertex_src, const char *frag_src)
+{
+    _vertex_shader_id = create_shader(GL_VERTEX_SHADER, vertex_src);
+    _frag_shader_id = create_shader(GL_FRAGMENT_SHADER, frag_src);
+    if (_vertex_shader_id && _frag_shader_id) {
+        _program = link_program(_vertex_shader_id, _frag_shader_id);
+    }
+
+    if (!_program) reset();
+}
+
+GLProgram GLProgram::from_files(const char *vertex_path, const char *frag_path)
+{
+    string vertex_shader = load_shader(vertex_path);
+    string frag_shader = load_shader(frag_path);
+    if (vertex_shader.empty() || frag_shader.empty()) {
+        return GLProgram();
+    }
+
+    return GLProgram(vertex_shader.c_str(), frag_shader.c_str());
+}
+
+GLProgram::~GLProgram()
+{
+    reset();
+}
+
+GLProgram::GLProgram(GLProgram&& other)
+{
+    *this = std::move(other);
+}
+
+GLProgram& GLProgram::operator=(GLProgram&& other)
+{
+    if (this != &other) {
+        reset();
+        swap(_program, other._program);
+        swap(_vertex_shader_id, other._vertex_shader_id);
+        swap(_frag_shader_id, other._frag_shader_id);
+    }
+    return *this;
+}
+
+GLint GLProgram::uniform(const char *name) const
+{
+    return glGetUniformLocation(_program, name);
+}
+
+GLint GLProgram::attrib(const char *name) const
+{
+    return glGetAttribLocation(_program, name);
+}
+
+void GLProgram::reset()
+{
+    if (_vertex_shader_id) glDeleteShader(_vertex_shader_id);
+    if (_frag_shader_id) glDeleteShader(_frag_shader_id);
+    if (_program) glDeleteProgram(_program);
+    _program = _vertex_shader_id = _frag_shader_id = 0;
+}
+
+GLBuffer::GLBuffer(GLenum target)
+    :_target(target)
+{
+}
+
+GLBuffer::~GLBuffer()
+{
+    if (_id) glDeleteBuffers(1, &_id);
+}
+
+GLBuffer::GLBuffer(GLBuffer&& other)
+    :_target(other._target), _id(other._id)
+{
+    other._id = 0;
+}
+
+GLBuffer& GLBuffer::operator=(GLBuffer&& other)
+{
+    if (this != &other) {
+        if (_id) glDeleteBuffers(1, &_id);
+        _target = other._target;
+        _id = other._id;
+        other._id = 0;
+    }
+    return *this;
+}
+
+void GLBuffer::bind() const
+{
+    if (!_id) glGenBuffers(1, &_id);
+    glBindBuffer(_target, _id);
+}
+
+void GLBuffer::data(size_t size, const void *ptr, GLenum usage)
+{
+    bind();
+    glBufferData(_target, size, ptr, usage);
+}
+
+void GLBuffer::sub_data(size_t offset, size_t size, const void *ptr)
+{
+    bind();
+    glBufferSubData(_target, offset, size, ptr);
+}
+
+static struct {
+    bool loaded;
+    PFNGLBUFFERSTORAGEEXTPROC BufferStorage;
+    PFNGLMAPBUFFERRANGEEXTPROC MapBufferRange;
+    PFNGLUNMAPBUFFEROESPROC UnmapBuffer;
+} stream_procs;
+
+static void load_stream_procs()
+{
+    if (stream_procs.loaded) return;
+    stream_procs.loaded = true;
+
+    if (gl_has_extension("GL_EXT_buffer_storage")) {
+        stream_procs.BufferStorage = (PFNGLBUFFERSTORAGEEXTPROC)
+            eglGetProcAddress("glBufferStorageEXT");
+    }
+    if (gl_has_extension("GL_EXT_map_buffer_range")) {
+        stream_procs.MapBufferRange = (PFNGLMAPBUFFERRANGEEXTPROC)
+            eglGetProcAddress("glMapBufferRangeEXT");
+        // EXT_map_buffer_range reuses OES_mapbuffer's unmap entry point
+        stream_procs.UnmapBuffer = (PFNGLUNMAPBUFFEROESPROC)
+            eglGetProcAddress("glUnmapBufferOES");
+    }
+}
+
+const char* GLStreamBuffer::mode_name(Mode mode)
+{
+    switch (mode) {
+        case SubData: return "subdata";
+        case MapRange: return "maprange";
+        case Persistent: return "persistent";
+    }
+    return "unknown";
+}
+
+GLStreamBuffer::GLStreamBuffer(size_t segment_size, int segments,
+        Mode preferred)
+    :_buffer(GL_ARRAY_BUFFER), _mode(SubData),
+    _segment_size(segment_size), _segments(segments)
+{
+    load_stream_procs();
+
+    bool can_map = stream_procs.MapBufferRange && stream_procs.UnmapBuffer;
+    if (preferred >= Persistent && can_map && stream_procs.BufferStorage) {
+        _mode = Persistent;
+    } else if (preferred >= MapRange && can_map) {
+        _mode = MapRange;
+    }
+
+    size_t total = _segment_size * _segments;
+    _buffer.bind();
+    if (_mode == Persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT_EXT | GL_MAP_PERSISTENT_BIT_EXT |
+            GL_MAP_COHERENT_BIT_EXT;
+        stream_procs.BufferStorage(GL_ARRAY_BUFFER, total, NULL, flags);
+        _persistent = (char*)stream_procs.MapBufferRange(GL_ARRAY_BUFFER, 0,
+                total, flags);
+        if (!_persistent) {
+            // storage is immutable now, start over with a fresh name
+            cerr << "persistent map failed, falling back" << endl;
+            _buffer = GLBuffer(GL_ARRAY_BUFFER);
+            _buffer.bind();
+            _mode = MapRange;
+        }
+    }
+
+    if (_mode != Persistent) {
+        glBufferData(GL_ARRAY_BUFFER, total, NULL, GL_STREAM_DRAW);
+    }
+    if (_mode == SubData) {
+        _staging = new char[_segment_size];
+    }
+
+    _fences = new EGLSyncKHR[_segments];
+    for (int i = 0; i < _segments; i++) _fences[i] = EGL_NO_SYNC_KHR;
+    _fence_display = eglGetCurrentDisplay();
+    if (egl_fence_supported(_fence_display)) _fence = egl_fence_procs();
+}
+
+GLStreamBuffer::~GLStreamBuffer()
+{
+    if (_mapped || _persistent) {
+        _buffer.bind();
+        stream_procs.UnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    for (int i = 0; i < _segments; i++) {
+        if (_fences[i] != EGL_NO_SYNC_KHR)
+            _fence->DestroySync(_fence_display, _fences[i]);
+    }
+    delete[] _fences;
+    delete[] _staging;
+}
+
+void GLStreamBuffer::wait_segment(int idx)
+{
+    if (_mode == SubData) return; // the driver orders subdata against draws
+
+    if (!_fence) {
+        // no fences: only wrapping around into in-flight data is unsafe
+        if (idx == 0 && _current >= 0) {
+            glFinish();
+            _stalls++;
+        }
+        return;
+    }
+
+    EGLSyncKHR fence = _fences[idx];
+    if (fence == EGL_NO_SYNC_KHR) return;
+
+    EGLint ret = _fence->ClientWaitSync(_fence_display, fence,
+            EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, 0);
+    if (ret == EGL_TIMEOUT_EXPIRED_KHR) {
+        _stalls++;
+        _fence->ClientWaitSync(_fence_display, fence,
+                EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, EGL_FOREVER_KHR);
+    }
+    _fence->DestroySync(_fence_display, fence);
+    _fences[idx] = EGL_NO_SYNC_KHR;
+}
+
+void* GLStreamBuffer::begin_frame(GLintptr *offset)
+{
+    int next = (_current + 1) % _segments;
+    wait_segment(next);
+    _current = next;
+
+    GLintptr base = (GLintptr)_segment_size * _current;
+    *offset = base;
+
+    switch (_mode) {
+        case Persistent:
+            return _persistent + base;
+
+        case MapRange:
+            _buffer.bind();
+            _mapped = (char*)stream_procs.MapBufferRange(GL_ARRAY_BUFFER,
+                    base, _segment_size,
+                    GL_MAP_WRITE_BIT_EXT | GL_MAP_INVALIDATE_RANGE_BIT_EXT |
+                    GL_MAP_UNSYNCHRONIZED_BIT_EXT);
+            if (_mapped) return _mapped;
+            // out of memory, or the driver refused an unsynchronized map:
+            // this frame goes through a staging copy instead
+            _map_failures++;
+            if (!_staging) _staging = new char[_segment_size];
+            return _staging;
+
+        case SubData:
+            return _staging;
+    }
+    return nullptr;
+}
+
+void GLStreamBuffer::commit(size_t used)
+{
+    _buffer.bind();
+    if (_mode == MapRange && _mapped) {
+        stream_procs.UnmapBuffer(GL_ARRAY_BUFFER);
+        _mapped = nullptr;
+    } else if (_mode != Persistent && used) {
+        glBufferSubData(GL_ARRAY_BUFFER, _segment_size * _current, used, _staging);
+    }
+}
+
+void GLStreamBuffer::end_frame()
+{
+    if (_mode == SubData || !_fence) return;
+
+    _fences[_current] = _fence->CreateSync(_fence_display,
+            EGL_SYNC_FENCE_KHR, NULL);
 }
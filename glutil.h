@@ -1,17 +1,141 @@
 #ifndef _GL_UTIL_H
-#define _GL_UTIL_H 
+#define _GL_UTIL_H
 
+#include <stddef.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "benchutil.h"
+#include "eglfence.h"
 
 struct GLProcess {
     GLuint program, vertex_shader_id, frag_shader_id;
     GLuint vbo;
 };
 
-GLProcess* glprocess_create(const char *vertex_path, const char *frag_path, 
+GLProcess* glprocess_create(const char *vertex_path, const char *frag_path,
         bool inmemory = false);
+// releases the gl objects and frees proc itself
 void glprocess_release(GLProcess* proc);
 
+// extension_list_has() of the current context's GL_EXTENSIONS
+bool gl_has_extension(const char *name);
+
+/**
+ * owning wrapper of a linked program and its shaders, movable but not
+ * copyable. the gl context must be current when it is destroyed.
+ */
+class GLProgram {
+public:
+    GLProgram() = default;
+    GLProgram(const char *vertex_src, const char *frag_src);
+    ~GLProgram();
+
+    GLProgram(GLProgram&& other);
+    GLProgram& operator=(GLProgram&& other);
+    GLProgram(const GLProgram&) = delete;
+    GLProgram& operator=(const GLProgram&) = delete;
+
+    static GLProgram from_files(const char *vertex_path, const char *frag_path);
+
+    bool valid() const { return _program != 0; }
+    GLuint id() const { return _program; }
+    void use() const { glUseProgram(_program); }
+    GLint uniform(const char *name) const;
+    GLint attrib(const char *name) const;
+
+    void reset();
+
+private:
+    GLuint _program {0}, _vertex_shader_id {0}, _frag_shader_id {0};
+};
+
+// the name is generated on first bind, so a GLBuffer may be declared
+// before a context is current
+class GLBuffer {
+public:
+    explicit GLBuffer(GLenum target = GL_ARRAY_BUFFER);
+    ~GLBuffer();
+
+    GLBuffer(GLBuffer&& other);
+    GLBuffer& operator=(GLBuffer&& other);
+    GLBuffer(const GLBuffer&) = delete;
+    GLBuffer& operator=(const GLBuffer&) = delete;
+
+    GLuint id() const { return _id; }
+    GLenum target() const { return _target; }
+    void bind() const;
+
+    void data(size_t size, const void *ptr, GLenum usage);
+    void sub_data(size_t offset, size_t size, const void *ptr);
+
+private:
+    GLenum _target;
+    mutable GLuint _id {0};
+};
+
+/**
+ * ring of per-frame segments inside one vertex buffer for geometry that is
+ * rebuilt every frame. a segment is reused only after the fence of the frame
+ * that last read it has signaled, so writes never stall on the gpu.
+ *
+ * Persistent maps the whole buffer once (GL_EXT_buffer_storage), MapRange
+ * maps each segment unsynchronized (GL_EXT_map_buffer_range) and SubData
+ * stages in client memory and uploads with glBufferSubData. the best mode
+ * the context exposes not above the requested one is used.
+ */
+class GLStreamBuffer {
+public:
+    enum Mode { SubData, MapRange, Persistent };
+
+    GLStreamBuffer(size_t segment_size, int segments = 3,
+            Mode preferred = Persistent);
+    ~GLStreamBuffer();
+
+    GLStreamBuffer(const GLStreamBuffer&) = delete;
+    GLStreamBuffer& operator=(const GLStreamBuffer&) = delete;
+
+    static const char* mode_name(Mode mode);
+
+    Mode mode() const { return _mode; }
+    GLuint id() const { return _buffer.id(); }
+    size_t segment_size() const { return _segment_size; }
+
+    // waits for the next segment to be free and returns a write pointer to
+    // it. *offset receives the byte offset of the segment in the buffer.
+    // never NULL, a frame whose map fails is staged and uploaded instead.
+    void* begin_frame(GLintptr *offset);
+    // makes the first used bytes of the segment visible to the gpu, must be
+    // called before drawing from it. the buffer is left bound.
+    void commit(size_t used);
+    // fences the segment after the frame's draws are submitted
+    void end_frame();
+
+    // frames in which begin_frame had to block on a fence
+    unsigned long stalls() const { return _stalls; }
+    // MapRange frames that fell back to staging because the map failed
+    unsigned long map_failures() const { return _map_failures; }
+
+private:
+    void wait_segment(int idx);
+
+    GLBuffer _buffer;
+    Mode _mode;
+    size_t _segment_size;
+    int _segments;
+    int _current {-1};
+
+    char *_persistent {nullptr};
+    char *_mapped {nullptr};
+    char *_staging {nullptr};
+    EGLSyncKHR *_fences {nullptr};
+    EGLDisplay _fence_display {EGL_NO_DISPLAY};
+    // NULL when _fence_display has no EGL_KHR_fence_sync
+    const struct egl_fence_procs *_fence {nullptr};
+    unsigned long _stalls {0};
+    unsigned long _map_failures {0};
+};
 
 #endif
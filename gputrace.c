@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <EGL/egl.h>
+
+#include "benchutil.h"
+#include "gputrace.h"
+
+// gpu and cpu clocks drift apart, remap them this often
+#define RECALIBRATE_NS 1000000000ull
+
+static struct trace_event *trace_push(struct trace *t)
+{
+    if (t->n == t->cap) {
+        size_t cap = t->cap ? t->cap * 2 : 1024;
+        struct trace_event *p = realloc(t->events, cap * sizeof *p);
+        if (!p) return NULL;
+        t->events = p;
+        t->cap = cap;
+    }
+    return &t->events[t->n++];
+}
+
+void trace_name_track(struct trace *t, int tid, const char *name)
+{
+    struct trace_track *p = realloc(t->tracks, (t->ntracks + 1) * sizeof *p);
+    if (!p) return;
+    t->tracks = p;
+    t->tracks[t->ntracks].tid = tid;
+    t->tracks[t->ntracks].name = strdup(name);
+    t->ntracks++;
+}
+
+void trace_complete(struct trace *t, int tid, const char *name, long frame,
+        uint64_t begin_ns, uint64_t end_ns)
+{
+    struct trace_event *e = trace_push(t);
+    if (!e) return;
+    e->name = name;
+    e->ph = 'X';
+    e->tid = tid;
+    e->ts_ns = begin_ns;
+    e->dur_ns = end_ns > begin_ns ? end_ns - begin_ns : 0;
+    e->frame = frame;
+}
+
+void trace_instant(struct trace *t, int tid, const char *name, long frame,
+        uint64_t ts_ns)
+{
+    struct trace_event *e = trace_push(t);
+    if (!e) return;
+    e->name = name;
+    e->ph = 'i';
+    e->tid = tid;
+    e->ts_ns = ts_ns;
+    e->dur_ns = 0;
+    e->frame = frame;
+}
+
+int trace_write(const struct trace *t, const char *process, const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) return 1;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+            "\"args\":{\"name\":\"%s\"}}", process);
+    for (size_t i = 0; i < t->ntracks; i++) {
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"name\":\"%s\"}}", t->tracks[i].tid, t->tracks[i].name);
+        // keep tracks in the order they were named
+        fprintf(f, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"sort_index\":%zu}}", t->tracks[i].tid, i);
+    }
+
+    for (size_t i = 0; i < t->n; i++) {
+        const struct trace_event *e = &t->events[i];
+        // microseconds, the unit of the format
+        fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f",
+                e->name, e->ph, e->tid, e->ts_ns / 1e3);
+        if (e->ph == 'X') fprintf(f, ",\"dur\":%.3f", e->dur_ns / 1e3);
+        else fprintf(f, ",\"s\":\"t\"");
+        if (e->frame != TRACE_NO_FRAME) fprintf(f, ",\"args\":{\"frame\":%ld}", e->frame);
+        fprintf(f, "}");
+    }
+    fprintf(f, "\n]}\n");
+
+    int err = ferror(f);
+    return fclose(f) || err;
+}
+
+void trace_release(struct trace *t)
+{
+    for (size_t i = 0; i < t->ntracks; i++) free(t->tracks[i].name);
+    free(t->tracks);
+    free(t->events);
+    memset(t, 0, sizeof *t);
+}
+
+static struct {
+    int loaded;
+    PFNGLGENQUERIESEXTPROC GenQueries;
+    PFNGLDELETEQUERIESEXTPROC DeleteQueries;
+    PFNGLBEGINQUERYEXTPROC BeginQuery;
+    PFNGLENDQUERYEXTPROC EndQuery;
+    PFNGLQUERYCOUNTEREXTPROC QueryCounter;
+    PFNGLGETQUERYIVEXTPROC GetQueryiv;
+    PFNGLGETQUERYOBJECTUIVEXTPROC GetQueryObjectuiv;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC GetQueryObjectui64v;
+    // only in later revisions of the extension
+    PFNGLGETINTEGER64VEXTPROC GetInteger64v;
+} timer_procs;
+
+static int load_timer_procs()
+{
+    if (timer_procs.loaded) return timer_procs.QueryCounter != NULL;
+    timer_procs.loaded = 1;
+
+    if (!extension_list_has((const char *)glGetString(GL_EXTENSIONS),
+                "GL_EXT_disjoint_timer_query"))
+        return 0;
+    timer_procs.GenQueries = (PFNGLGENQUERIESEXTPROC)eglGetProcAddress("glGenQueriesEXT");
+    timer_procs.DeleteQueries = (PFNGLDELETEQUERIESEXTPROC)eglGetProcAddress("glDeleteQueriesEXT");
+    timer_procs.BeginQuery = (PFNGLBEGINQUERYEXTPROC)eglGetProcAddress("glBeginQueryEXT");
+    timer_procs.EndQuery = (PFNGLENDQUERYEXTPROC)eglGetProcAddress("glEndQueryEXT");
+    timer_procs.GetQueryiv = (PFNGLGETQUERYIVEXTPROC)eglGetProcAddress("glGetQueryivEXT");
+    timer_procs.GetQueryObjectuiv = (PFNGLGETQUERYOBJECTUIVEXTPROC)
+        eglGetProcAddress("glGetQueryObjectuivEXT");
+    timer_procs.GetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VEXTPROC)
+        eglGetProcAddress("glGetQueryObjectui64vEXT");
+    timer_procs.GetInteger64v = (PFNGLGETINTEGER64VEXTPROC)
+        eglGetProcAddress("glGetInteger64vEXT");
+    timer_procs.QueryCounter = (PFNGLQUERYCOUNTEREXTPROC)eglGetProcAddress("glQueryCounterEXT");
+    return timer_procs.QueryCounter != NULL;
+}
+
+static int gpu_disjoint()
+{
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    return disjoint;
+}
+
+static void calibrate(struct gpu_timer *gt)
+{
+    if (gt->mode != GPU_TIMER_TIMESTAMP) return;
+
+    GLint64 gpu = 0;
+    uint64_t before, after;
+    if (timer_procs.GetInteger64v) {
+        before = bench_now_ns();
+        timer_procs.GetInteger64v(GL_TIMESTAMP_EXT, &gpu);
+        after = bench_now_ns();
+    } else {
+        // the counter lands once the pipe is idle, biased by the finish latency
+        GLuint64 result = 0;
+        timer_procs.QueryCounter(gt->calibration_query, GL_TIMESTAMP_EXT);
+        glFinish();
+        before = after = bench_now_ns();
+        timer_procs.GetQueryObjectui64v(gt->calibration_query, GL_QUERY_RESULT_EXT, &result);
+        gpu = result;
+    }
+    gt->offset_ns = (int64_t)(before + (after - before) / 2) - gpu;
+    gt->calibrated_ns = after;
+}
+
+enum gpu_timer_mode gpu_timer_init(struct gpu_timer *gt, struct trace *t, int tid)
+{
+    memset(gt, 0, sizeof *gt);
+    gt->trace = t;
+    gt->tid = tid;
+    if (!load_timer_procs()) return gt->mode;
+
+    GLint bits = 0;
+    timer_procs.GetQueryiv(GL_TIMESTAMP_EXT, GL_QUERY_COUNTER_BITS_EXT, &bits);
+    if (bits > 0) {
+        gt->mode = GPU_TIMER_TIMESTAMP;
+    } else {
+        timer_procs.GetQueryiv(GL_TIME_ELAPSED_EXT, GL_QUERY_COUNTER_BITS_EXT, &bits);
+        if (bits > 0) gt->mode = GPU_TIMER_ELAPSED;
+    }
+    if (gt->mode == GPU_TIMER_NONE) return gt->mode;
+
+    for (int i = 0; i < GPU_TIMER_SPANS; i++) {
+        timer_procs.GenQueries(2, gt->spans[i].query);
+    }
+    timer_procs.GenQueries(1, &gt->calibration_query);
+    gpu_disjoint(); // reading the flag clears it
+    calibrate(gt);
+    return gt->mode;
+}
+
+void gpu_timer_begin(struct gpu_timer *gt, const char *name, long frame)
+{
+    if (gt->mode == GPU_TIMER_NONE) return;
+    if (gt->head - gt->tail == GPU_TIMER_SPANS) gpu_timer_collect(gt, 0);
+    if (gt->head - gt->tail == GPU_TIMER_SPANS) {
+        gt->dropped++;
+        return;
+    }
+
+    struct gpu_span *s = &gt->spans[gt->head % GPU_TIMER_SPANS];
+    s->name = name;
+    s->frame = frame;
+    s->submit_ns = bench_now_ns();
+    if (gt->mode == GPU_TIMER_TIMESTAMP) {
+        timer_procs.QueryCounter(s->query[0], GL_TIMESTAMP_EXT);
+    } else {
+        timer_procs.BeginQuery(GL_TIME_ELAPSED_EXT, s->query[0]);
+    }
+    gt->open = 1;
+}
+
+void gpu_timer_end(struct gpu_timer *gt)
+{
+    if (!gt->open) return;
+    struct gpu_span *s = &gt->spans[gt->head % GPU_TIMER_SPANS];
+    if (gt->mode == GPU_TIMER_TIMESTAMP) {
+        timer_procs.QueryCounter(s->query[1], GL_TIMESTAMP_EXT);
+    } else {
+        timer_procs.EndQuery(GL_TIME_ELAPSED_EXT);
+    }
+    gt->open = 0;
+    gt->head++;
+}
+
+static void push_gpu_ms(struct gpu_timer *gt, double ms)
+{
+    if (gt->n_gpu_ms == gt->cap_gpu_ms) {
+        size_t cap = gt->cap_gpu_ms ? gt->cap_gpu_ms * 2 : 256;
+        double *p = realloc(gt->gpu_ms, cap * sizeof *p);
+        if (!p) return;
+        gt->gpu_ms = p;
+        gt->cap_gpu_ms = cap;
+    }
+    gt->gpu_ms[gt->n_gpu_ms++] = ms;
+}
+
+void gpu_timer_collect(struct gpu_timer *gt, int wait)
+{
+    if (gt->mode == GPU_TIMER_NONE) return;
+
+    // a power state change or gpu reset invalidated everything in flight
+    if (gpu_disjoint()) {
+        gt->disjoints++;
+        gt->dropped += gt->head - gt->tail;
+        gt->tail = gt->head;
+        calibrate(gt);
+        return;
+    }
+
+    while (gt->tail != gt->head) {
+        struct gpu_span *s = &gt->spans[gt->tail % GPU_TIMER_SPANS];
+        GLuint last = s->query[gt->mode == GPU_TIMER_TIMESTAMP ? 1 : 0];
+        if (!wait) {
+            GLuint available = 0;
+            timer_procs.GetQueryObjectuiv(last, GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+            if (!available) break;
+        }
+
+        uint64_t begin, end;
+        if (gt->mode == GPU_TIMER_TIMESTAMP) {
+            GLuint64 t0 = 0, t1 = 0;
+            timer_procs.GetQueryObjectui64v(s->query[0], GL_QUERY_RESULT_EXT, &t0);
+            timer_procs.GetQueryObjectui64v(s->query[1], GL_QUERY_RESULT_EXT, &t1);
+            begin = t0 + gt->offset_ns;
+            end = t1 + gt->offset_ns;
+        } else {
+            GLuint64 elapsed = 0;
+            timer_procs.GetQueryObjectui64v(s->query[0], GL_QUERY_RESULT_EXT, &elapsed);
+            begin = s->submit_ns;
+            end = begin + elapsed;
+        }
+        if (gt->trace) trace_complete(gt->trace, gt->tid, s->name, s->frame, begin, end);
+        push_gpu_ms(gt, bench_ns_to_ms(end - begin));
+        gt->tail++;
+    }
+
+    if (gt->tail == gt->head && timer_procs.GetInteger64v
+            && bench_now_ns() - gt->calibrated_ns > RECALIBRATE_NS) {
+        calibrate(gt);
+    }
+}
+
+void gpu_timer_print(struct gpu_timer *gt, const char *label)
+{
+    if (gt->mode == GPU_TIMER_NONE) {
+        printf("%-24s no GL_EXT_disjoint_timer_query, gpu time not measured\n", label);
+        return;
+    }
+
+    struct bench_stats st;
+    bench_stats_compute(gt->gpu_ms, gt->n_gpu_ms, &st);
+    bench_stats_print(label, "ms(gpu)", &st);
+    printf("%-24s %s queries, %lu spans dropped, %lu disjoint events\n", "",
+            gpu_timer_mode_name(gt->mode), gt->dropped, gt->disjoints);
+}
+
+void gpu_timer_release(struct gpu_timer *gt)
+{
+    if (gt->mode != GPU_TIMER_NONE) {
+        for (int i = 0; i < GPU_TIMER_SPANS; i++) {
+            timer_procs.DeleteQueries(2, gt->spans[i].query);
+        }
+        timer_procs.DeleteQueries(1, &gt->calibration_query);
+    }
+    free(gt->gpu_ms);
+    memset(gt, 0, sizeof *gt);
+}
+
+const char *gpu_timer_mode_name(enum gpu_timer_mode mode)
+{
+    switch (mode) {
+        case GPU_TIMER_NONE: return "none";
+        case GPU_TIMER_ELAPSED: return "elapsed";
+        case GPU_TIMER_TIMESTAMP: return "timestamp";
+    }
+    return "unknown";
+}
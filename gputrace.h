@@ -0,0 +1,124 @@
+#ifndef _GPU_TRACE_H
+#define _GPU_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * chrome trace event format (chrome://tracing, ui.perfetto.dev). every
+ * event lives on a track (tid): cpu work, gpu execution and swaps/flips go
+ * to separate tracks, and all carry the frame id they belong to so one
+ * frame can be followed across them. timestamps are bench_now_ns().
+ */
+#define TRACE_NO_FRAME (-1L)
+
+struct trace_event {
+    const char *name;
+    char ph;                        // 'X' complete, 'i' instant
+    int tid;
+    uint64_t ts_ns, dur_ns;
+    long frame;
+};
+
+struct trace_track {
+    int tid;
+    char *name;
+};
+
+struct trace {
+    struct trace_event *events;
+    size_t n, cap;
+    struct trace_track *tracks;
+    size_t ntracks;
+};
+
+void trace_name_track(struct trace *t, int tid, const char *name);
+/* event names are not copied and must outlive the trace */
+void trace_complete(struct trace *t, int tid, const char *name, long frame,
+        uint64_t begin_ns, uint64_t end_ns);
+void trace_instant(struct trace *t, int tid, const char *name, long frame,
+        uint64_t ts_ns);
+int trace_write(const struct trace *t, const char *process, const char *path);
+void trace_release(struct trace *t);
+
+/*
+ * gpu spans from GL_EXT_disjoint_timer_query. with timestamp counters the
+ * gpu clock is mapped onto the cpu clock, otherwise elapsed time queries
+ * are used and the span is placed at its cpu submission time. results are
+ * read back a few frames late so collecting them never stalls the pipe.
+ */
+enum gpu_timer_mode {
+    GPU_TIMER_NONE,
+    GPU_TIMER_ELAPSED,
+    GPU_TIMER_TIMESTAMP,
+};
+
+#define GPU_TIMER_SPANS 64
+
+struct gpu_span {
+    const char *name;
+    long frame;
+    uint64_t submit_ns;
+    GLuint query[2];
+};
+
+struct gpu_timer {
+    enum gpu_timer_mode mode;
+    struct trace *trace;
+    int tid;
+    int64_t offset_ns;              // cpu clock minus gpu clock
+    uint64_t calibrated_ns;
+    GLuint calibration_query;
+    struct gpu_span spans[GPU_TIMER_SPANS];
+    unsigned head, tail;            // issued and oldest pending span
+    int open;
+    unsigned long dropped, disjoints;
+    double *gpu_ms;                 // every span read back, for the summary
+    size_t n_gpu_ms, cap_gpu_ms;
+};
+
+/* the context has to be current, returns the mode actually in use */
+enum gpu_timer_mode gpu_timer_init(struct gpu_timer *gt, struct trace *t, int tid);
+void gpu_timer_begin(struct gpu_timer *gt, const char *name, long frame);
+void gpu_timer_end(struct gpu_timer *gt);
+/* reads back finished spans, with wait set drains everything in flight */
+void gpu_timer_collect(struct gpu_timer *gt, int wait);
+void gpu_timer_print(struct gpu_timer *gt, const char *label);
+void gpu_timer_release(struct gpu_timer *gt);
+const char *gpu_timer_mode_name(enum gpu_timer_mode mode);
+
+#ifdef __cplusplus
+}
+
+#include "benchutil.h"
+
+// cpu side event covering the enclosing scope
+class TraceScope {
+public:
+    TraceScope(struct trace *t, int tid, const char *name, long frame)
+        :_trace(t), _tid(tid), _name(name), _frame(frame),
+        _begin(t ? bench_now_ns() : 0) {}
+    ~TraceScope()
+    {
+        if (_trace) trace_complete(_trace, _tid, _name, _frame, _begin, bench_now_ns());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    struct trace *_trace;
+    int _tid;
+    const char *_name;
+    long _frame;
+    uint64_t _begin;
+};
+#endif
+
+#endif
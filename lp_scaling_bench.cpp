@@ -0,0 +1,493 @@
+/**
+ * sizes llvmpipe on machines that render in software (the DRISWRAST
+ * fallback xorg_test flags, VMs without a virtual gpu). checks that the
+ * renderer is llvmpipe and runs the standard workloads once
+ * per LP_NUM_THREADS value from 1 to the number of usable cores. llvmpipe
+ * reads the variable once when its screen is created, so every value runs
+ * in a fresh process. reports throughput, cpu time per frame and scaling
+ * efficiency against one rasterizer thread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <vector>
+#include <string>
+
+#include "glutil.h"
+#include "eglutil.h"
+#include "benchutil.h"
+#include "memstat.h"
+#include "benchresult.h"
+
+#define err_msg(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+} while (0)
+
+#define err_quit(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+    exit(1); \
+} while (0)
+
+using namespace std;
+
+static const char* vert_shader = R"(
+attribute vec2 position;
+uniform vec4 rect;
+varying vec2 v_uv;
+
+void main() {
+    v_uv = position;
+    gl_Position = vec4(rect.xy + position * rect.zw, 0.0, 1.0);
+}
+)";
+// dependent fetch and some alu, what a compositor does per window pixel
+static const char* composite_shader = R"(
+precision mediump float;
+uniform sampler2D tex;
+uniform float phase;
+varying vec2 v_uv;
+
+void main() {
+    vec4 c = texture2D(tex, v_uv);
+    c += texture2D(tex, v_uv + vec2(c.r, c.g) * 0.01);
+    c.rgb = c.rgb * 0.5 + 0.25 * sin(v_uv.xyx * 6.0 + phase);
+    gl_FragColor = c;
+}
+)";
+static const char* texture_shader = R"(
+precision mediump float;
+uniform sampler2D tex;
+uniform float alpha;
+varying vec2 v_uv;
+
+void main() {
+    gl_FragColor = texture2D(tex, v_uv) * alpha;
+}
+)";
+static const char* color_shader = R"(
+precision mediump float;
+uniform vec4 color;
+
+void main() {
+    gl_FragColor = color;
+}
+)";
+
+static struct {
+    int max_threads;
+    int frames;
+    int width, height;
+    const char* workloads;
+    bool force_software;
+    bool child;
+} opts = {
+    0, 100, 1280, 720, "all", false, false,
+};
+
+struct Scene {
+    GLProgram composite, texture, color;
+    GLBuffer quad, tris;
+    GLuint pattern_tex {0}, upload_tex {0};
+    vector<GLubyte> pixels;
+    int ntris {0};
+
+    bool build();
+    void release();
+    void draw_quad(const GLProgram& prog, float x, float y, float w, float h) const;
+};
+
+bool Scene::build()
+{
+    composite = GLProgram(vert_shader, composite_shader);
+    texture = GLProgram(vert_shader, texture_shader);
+    color = GLProgram(vert_shader, color_shader);
+    if (!composite.valid() || !texture.valid() || !color.valid()) return false;
+
+    GLfloat q[] = { 0, 0, 1, 0, 0, 1, 1, 1 };
+    quad.data(sizeof q, q, GL_STATIC_DRAW);
+
+    // a grid of small triangles over the whole target, setup bound
+    const int cols = 200, rows = 125;
+    vector<GLfloat> verts;
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < cols; x++) {
+            float x0 = -1.0f + 2.0f * x / cols, y0 = -1.0f + 2.0f * y / rows;
+            float dx = 1.6f / cols, dy = 1.6f / rows;
+            GLfloat t[] = { x0, y0, x0 + dx, y0, x0, y0 + dy,
+                x0 + dx, y0, x0 + dx, y0 + dy, x0, y0 + dy };
+            verts.insert(verts.end(), t, t + 12);
+        }
+    }
+    ntris = cols * rows * 2;
+    tris.data(verts.size() * sizeof(GLfloat), verts.data(), GL_STATIC_DRAW);
+
+    const int tw = 256, th = 256;
+    vector<GLubyte> pattern(tw * th * 4);
+    for (int i = 0; i < tw * th; i++) {
+        pattern[i*4+0] = i & 0xff;
+        pattern[i*4+1] = (i >> 8) & 0xff;
+        pattern[i*4+2] = (i * 7) & 0xff;
+        pattern[i*4+3] = 0xff;
+    }
+    glGenTextures(1, &pattern_tex);
+    glBindTexture(GL_TEXTURE_2D, pattern_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tw, th, 0, GL_RGBA,
+            GL_UNSIGNED_BYTE, pattern.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    // full target sized frame, like a video or a client buffer
+    pixels.assign((size_t)opts.width * opts.height * 4, 0x80);
+    glGenTextures(1, &upload_tex);
+    glBindTexture(GL_TEXTURE_2D, upload_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, opts.width, opts.height, 0, GL_RGBA,
+            GL_UNSIGNED_BYTE, pixels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glFinish();
+    return glGetError() == GL_NO_ERROR;
+}
+
+void Scene::release()
+{
+    if (pattern_tex) glDeleteTextures(1, &pattern_tex);
+    if (upload_tex) glDeleteTextures(1, &upload_tex);
+    pattern_tex = upload_tex = 0;
+    composite.reset();
+    texture.reset();
+    color.reset();
+    quad = GLBuffer(GL_ARRAY_BUFFER);
+    tris = GLBuffer(GL_ARRAY_BUFFER);
+}
+
+// x, y, w, h in normalized device coordinates
+void Scene::draw_quad(const GLProgram& prog, float x, float y, float w, float h) const
+{
+    glUniform4f(prog.uniform("rect"), x, y, w, h);
+    quad.bind();
+    GLint pos = prog.attrib("position");
+    glEnableVertexAttribArray(pos);
+    glVertexAttribPointer(pos, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+// layered full screen windows, fragment bound
+static void draw_composite(Scene& s, int frame)
+{
+    glDisable(GL_BLEND);
+    glClear(GL_COLOR_BUFFER_BIT);
+    s.composite.use();
+    glUniform1i(s.composite.uniform("tex"), 0);
+    glUniform1f(s.composite.uniform("phase"), frame * 0.05f);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, s.pattern_tex);
+    for (int i = 0; i < 8; i++) {
+        float inset = i * 0.1f;
+        s.draw_quad(s.composite, -1.0f + inset, -1.0f + inset, 2.0f - 2 * inset,
+                2.0f - 2 * inset);
+    }
+}
+
+// overlapping translucent windows, blend bandwidth bound
+static void draw_blend(Scene& s, int frame)
+{
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glClear(GL_COLOR_BUFFER_BIT);
+    s.texture.use();
+    glUniform1i(s.texture.uniform("tex"), 0);
+    glUniform1f(s.texture.uniform("alpha"), 0.6f);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, s.pattern_tex);
+    for (int i = 0; i < 16; i++) {
+        float off = ((i * 7 + frame) % 16) * 0.05f;
+        s.draw_quad(s.texture, -1.0f + off, -1.0f + off * 0.5f, 1.2f, 1.2f);
+    }
+    glDisable(GL_BLEND);
+}
+
+// many small triangles, vertex processing and setup bound
+static void draw_triangles(Scene& s, int frame)
+{
+    glClear(GL_COLOR_BUFFER_BIT);
+    s.color.use();
+    glUniform4f(s.color.uniform("rect"), 0, 0, 1, 1);
+    glUniform4f(s.color.uniform("color"), (frame % 256) / 255.0f, 0.5f, 0.2f, 1.0f);
+    s.tris.bind();
+    GLint pos = s.color.attrib("position");
+    glEnableVertexAttribArray(pos);
+    glVertexAttribPointer(pos, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+    glDrawArrays(GL_TRIANGLES, 0, s.ntris * 3);
+}
+
+// a new full screen frame every frame, copy bound
+static void draw_upload(Scene& s, int frame)
+{
+    memset(s.pixels.data(), frame & 0xff, opts.width * 4);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, s.upload_tex);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, opts.width, opts.height, GL_RGBA,
+            GL_UNSIGNED_BYTE, s.pixels.data());
+    s.texture.use();
+    glUniform1i(s.texture.uniform("tex"), 0);
+    glUniform1f(s.texture.uniform("alpha"), 1.0f);
+    s.draw_quad(s.texture, -1, -1, 2, 2);
+}
+
+struct Workload {
+    const char* name;
+    void (*draw)(Scene& s, int frame);
+};
+
+static const Workload workloads[] = {
+    { "composite", draw_composite },
+    { "blend", draw_blend },
+    { "triangles", draw_triangles },
+    { "upload", draw_upload },
+};
+static const int n_workloads = sizeof workloads / sizeof workloads[0];
+
+// softpipe and swrast are software too but single threaded, they ignore
+// LP_NUM_THREADS
+static bool is_llvmpipe(const char* renderer)
+{
+    return renderer && strstr(renderer, "llvmpipe");
+}
+
+// the process for one LP_NUM_THREADS value, one result line per workload
+static int run_child()
+{
+    const char* lp = getenv("LP_NUM_THREADS");
+    struct memstat mem = {0};
+    EGLOffscreen egl;
+    Scene scene;
+    if (!egl.create(opts.width, opts.height) || !scene.build())
+        err_quit("cannot create context and scene\n");
+    bench_result_gl_driver();
+    glViewport(0, 0, opts.width, opts.height);
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+
+    int ret = 0;
+    for (int i = 0; i < n_workloads; i++) {
+        const Workload& w = workloads[i];
+        if (!bench_selected(opts.workloads, w.name)) continue;
+
+        for (int frame = 0; frame < 5; frame++) w.draw(scene, frame);
+        glFinish();
+
+        vector<double> frame_ms;
+        frame_ms.reserve(opts.frames);
+        struct bench_cpu_usage cpu0, cpu1;
+        bench_cpu_sample(&cpu0);
+        for (int frame = 0; frame < opts.frames; frame++) {
+            uint64_t t0 = bench_now_ns();
+            w.draw(scene, frame);
+            glFinish();
+            frame_ms.push_back(bench_ns_to_ms(bench_now_ns() - t0));
+            if (frame % 32 == 0) memstat_sample(&mem, w.name);
+        }
+        bench_cpu_sample(&cpu1);
+        if (glGetError() != GL_NO_ERROR) {
+            err_msg("%s: gl error\n", w.name);
+            ret = 1;
+            continue;
+        }
+
+        char metric[64];
+        snprintf(metric, sizeof metric, "%s lp%s", w.name, lp ? lp : "default");
+        bench_result_record("lp_scaling_bench", metric, "ms/frame", 1, frame_ms.data(),
+                frame_ms.size());
+
+        double wall_s = (cpu1.wall_ns - cpu0.wall_ns) / 1e9;
+        double cpu_ms = (cpu1.user_ns - cpu0.user_ns + cpu1.sys_ns - cpu0.sys_ns) / 1e6;
+        struct bench_stats st;
+        bench_stats_compute(frame_ms.data(), frame_ms.size(), &st);
+        printf("result\t%s\t%.3f\t%.4f\t%.4f\n", w.name, opts.frames / wall_s,
+                cpu_ms / opts.frames, st.p95);
+        fflush(stdout);
+    }
+
+    scene.release();
+    egl.release();
+    memstat_sample(&mem, "end");
+    memstat_report(&mem, "lp_scaling_bench");
+    memstat_release(&mem);
+    return ret;
+}
+
+struct Sample {
+    int threads;
+    double fps, cpu_ms, p95_ms;
+};
+
+// runs the child for one LP_NUM_THREADS value and collects its results
+static int run_threads(const char* prog, int threads, vector<vector<Sample>>& results)
+{
+    int fds[2];
+    if (pipe(fds)) return 1;
+
+    char frames[16], size[32];
+    snprintf(frames, sizeof frames, "%d", opts.frames);
+    snprintf(size, sizeof size, "%dx%d", opts.width, opts.height);
+
+    pid_t pid = fork();
+    if (pid < 0) return 1;
+    if (pid == 0) {
+        char lp[16];
+        snprintf(lp, sizeof lp, "%d", threads);
+        setenv("LP_NUM_THREADS", lp, 1);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execl("/proc/self/exe", prog, "-x", "-f", frames, "-s", size,
+                "-w", opts.workloads, (char*)NULL);
+        _exit(127);
+    }
+    close(fds[1]);
+
+    FILE* f = fdopen(fds[0], "r");
+    char line[512];
+    while (fgets(line, sizeof line, f)) {
+        char name[64];
+        Sample s = { threads, 0, 0, 0 };
+        if (sscanf(line, "result\t%63s\t%lf\t%lf\t%lf", name, &s.fps, &s.cpu_ms,
+                    &s.p95_ms) != 4) {
+            // memory report and errors of the child
+            printf("  %s", line);
+            continue;
+        }
+        for (int i = 0; i < n_workloads; i++) {
+            if (!strcmp(workloads[i].name, name)) results[i].push_back(s);
+        }
+    }
+    fclose(f);
+
+    int status;
+    waitpid(pid, &status, 0);
+    return !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+static void print_scaling(const Workload& w, const vector<Sample>& samples)
+{
+    if (samples.empty()) return;
+    // the one thread run failing leaves nothing to scale against
+    const Sample* one = NULL;
+    for (auto& s: samples) {
+        if (s.threads == 1) one = &s;
+    }
+    double peak = 0;
+    int peak_threads = 0;
+    for (auto& s: samples) {
+        if (s.fps > peak) {
+            peak = s.fps;
+            peak_threads = s.threads;
+        }
+    }
+
+    printf("%s:\n  %7s %9s %8s %10s %13s %10s\n", w.name, "threads", "fps",
+            "speedup", "efficiency", "cpu ms/frame", "p95 ms");
+    int enough = 0;
+    for (auto& s: samples) {
+        if (one && one->fps > 0) {
+            double speedup = s.fps / one->fps;
+            printf("  %7d %9.1f %8.2f %9.0f%% %13.2f %10.2f\n", s.threads, s.fps, speedup,
+                    100.0 * speedup / s.threads, s.cpu_ms, s.p95_ms);
+        } else {
+            printf("  %7d %9.1f %8s %10s %13.2f %10.2f\n", s.threads, s.fps, "n/a", "n/a",
+                    s.cpu_ms, s.p95_ms);
+        }
+        if (!enough && s.fps >= 0.9 * peak) enough = s.threads;
+    }
+    // past the knee more threads mostly burn cpu
+    printf("  peak %.1f fps at %d threads, 90%% of it with %d threads\n", peak,
+            peak_threads, enough);
+}
+
+static int usable_cores()
+{
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof set, &set) == 0) return CPU_COUNT(&set);
+    return sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+static void usage(const char* prog)
+{
+    err_quit("usage: %s [-t max_threads] [-f frames] [-s WxH] "
+            "[-w all|composite,blend,triangles,upload] [-S]\n"
+            "  -S: force llvmpipe (LIBGL_ALWAYS_SOFTWARE) on machines with a gpu\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    int c;
+    while ((c = getopt(argc, argv, "t:f:s:w:Sx")) != -1) {
+        switch (c) {
+            case 't': opts.max_threads = atoi(optarg); break;
+            case 'f': opts.frames = atoi(optarg); break;
+            case 's':
+                if (sscanf(optarg, "%dx%d", &opts.width, &opts.height) != 2)
+                    usage(argv[0]);
+                break;
+            case 'w': opts.workloads = optarg; break;
+            case 'S': opts.force_software = true; break;
+            case 'x': opts.child = true; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (opts.frames <= 0 || opts.width <= 0 || opts.height <= 0) usage(argv[0]);
+    if (opts.child) return run_child();
+
+    int cores = usable_cores();
+    if (opts.max_threads <= 0) opts.max_threads = cores;
+
+    if (opts.force_software) {
+        setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+        setenv("GALLIUM_DRIVER", "llvmpipe", 0);
+    }
+    // the children record into one run
+    if (!getenv("BENCH_RUN_ID")) {
+        char id[64];
+        snprintf(id, sizeof id, "%ld-%d", (long)time(NULL), (int)getpid());
+        setenv("BENCH_RUN_ID", id, 1);
+    }
+
+    string renderer;
+    {
+        EGLOffscreen probe;
+        if (!probe.create(16, 16)) err_quit("no EGL context\n");
+        const char* r = (const char*)glGetString(GL_RENDERER);
+        renderer = r ? r : "unknown";
+    }
+    if (!is_llvmpipe(renderer.c_str())) {
+        printf("renderer %s is not llvmpipe, LP_NUM_THREADS has no "
+                "effect (run with -S to force llvmpipe), skipped\n", renderer.c_str());
+        return 0;
+    }
+
+    printf("renderer: %s, %d usable cores, %d frames at %dx%d per workload\n",
+            renderer.c_str(), cores, opts.frames, opts.width, opts.height);
+
+    int ret = 0;
+    vector<vector<Sample>> results(n_workloads);
+    for (int n = 1; n <= opts.max_threads; n++) {
+        printf("LP_NUM_THREADS=%d\n", n);
+        fflush(stdout);
+        if (run_threads(argv[0], n, results)) {
+            err_msg("run with LP_NUM_THREADS=%d failed\n", n);
+            ret = 1;
+        }
+    }
+
+    for (int i = 0; i < n_workloads; i++) print_scaling(workloads[i], results[i]);
+    return ret;
+}
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "benchutil.h"
+#include "memstat.h"
+
+// growth smaller than this is allocator noise, not a leak
+#define GROWTH_MIN_KB 1024
+#define GROWTH_MIN_RATIO 0.02
+
+#define MAX_DRM_CLIENTS 32
+
+static uint64_t parse_kb(const char *value)
+{
+    char unit[16] = {0};
+    unsigned long long v = 0;
+    if (sscanf(value, "%llu %15s", &v, unit) < 1) return 0;
+
+    if (!strcmp(unit, "KiB") || !strcmp(unit, "kB")) return v;
+    if (!strcmp(unit, "MiB")) return v * 1024;
+    if (!strcmp(unit, "GiB")) return v * 1024 * 1024;
+    return v / 1024; // plain bytes
+}
+
+static void read_smaps(struct mem_sample *s)
+{
+    char line[256];
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    if (!f) {
+        // pre 4.14 kernels: rss only
+        f = fopen("/proc/self/status", "r");
+        if (!f) return;
+        while (fgets(line, sizeof line, f)) {
+            if (!strncmp(line, "VmRSS:", 6)) s->rss_kb = parse_kb(line + 6);
+        }
+        s->pss_kb = s->rss_kb;
+        fclose(f);
+        return;
+    }
+
+    while (fgets(line, sizeof line, f)) {
+        if (!strncmp(line, "Rss:", 4)) s->rss_kb = parse_kb(line + 4);
+        else if (!strncmp(line, "Pss:", 4)) s->pss_kb = parse_kb(line + 4);
+    }
+    fclose(f);
+}
+
+// sums the gpu memory of one drm fd, returns its drm-client-id or 0
+static unsigned long long read_fdinfo(const char *fd_name, uint64_t *memory_kb,
+        uint64_t *total_kb)
+{
+    char path[300], line[256];
+    unsigned long long client_id = 0;
+
+    snprintf(path, sizeof path, "/proc/self/fdinfo/%s", fd_name);
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+
+    while (fgets(line, sizeof line, f)) {
+        char *colon = strchr(line, ':');
+        if (!colon) continue;
+
+        if (!strncmp(line, "drm-client-id:", 14)) {
+            client_id = strtoull(colon + 1, NULL, 10);
+        } else if (!strncmp(line, "drm-memory-", 11)) {
+            *memory_kb += parse_kb(colon + 1);
+        } else if (!strncmp(line, "drm-total-", 10)) {
+            *total_kb += parse_kb(colon + 1);
+        }
+    }
+    fclose(f);
+    return client_id;
+}
+
+static void read_drm_fds(struct mem_sample *s)
+{
+    unsigned long long seen[MAX_DRM_CLIENTS];
+    int nseen = 0;
+
+    DIR *dir = opendir("/proc/self/fd");
+    if (!dir) return;
+
+    struct dirent *de;
+    while ((de = readdir(dir))) {
+        char path[300], target[128];
+        if (de->d_name[0] == '.') continue;
+
+        snprintf(path, sizeof path, "/proc/self/fd/%s", de->d_name);
+        ssize_t len = readlink(path, target, sizeof target - 1);
+        if (len <= 0) continue;
+        target[len] = 0;
+        if (strncmp(target, "/dev/dri/", 9)) continue;
+
+        uint64_t memory = 0, total = 0;
+        unsigned long long id = read_fdinfo(de->d_name, &memory, &total);
+
+        // dup'ed fds of one client report the same memory
+        int dup = 0;
+        for (int i = 0; id && i < nseen; i++) dup |= seen[i] == id;
+        if (dup) continue;
+        if (id && nseen < MAX_DRM_CLIENTS) seen[nseen++] = id;
+
+        s->gpu_kb += memory ? memory : total;
+        s->drm_clients++;
+    }
+    closedir(dir);
+}
+
+int mem_sample_read(struct mem_sample *s)
+{
+    const char *label = s->label;
+    memset(s, 0, sizeof *s);
+    s->label = label;
+
+    read_smaps(s);
+    read_drm_fds(s);
+    return s->rss_kb ? 0 : 1;
+}
+
+void memstat_sample(struct memstat *ms, const char *label)
+{
+    if (ms->n == ms->cap) {
+        size_t cap = ms->cap ? ms->cap * 2 : 64;
+        struct mem_sample *p = realloc(ms->samples, cap * sizeof *p);
+        if (!p) return;
+        ms->samples = p;
+        ms->cap = cap;
+    }
+
+    struct mem_sample *s = &ms->samples[ms->n++];
+    s->label = label;
+    mem_sample_read(s);
+}
+
+static double median_of(const struct mem_sample **v, size_t n, int gpu)
+{
+    double *tmp = malloc(n * sizeof(double));
+    for (size_t i = 0; i < n; i++) tmp[i] = gpu ? v[i]->gpu_kb : v[i]->pss_kb;
+
+    struct bench_stats st;
+    bench_stats_compute(tmp, n, &st);
+    free(tmp);
+    return st.median;
+}
+
+// compares the first and last quarter of the samples sharing a label
+static int report_growth(const struct memstat *ms, const char *label)
+{
+    int growing = 0;
+    const struct mem_sample **iter = malloc(ms->n * sizeof *iter);
+    size_t n = 0;
+    for (size_t i = 0; i < ms->n; i++) {
+        if (!strcmp(ms->samples[i].label, label)) iter[n++] = &ms->samples[i];
+    }
+
+    if (n >= 8) {
+        size_t q = n / 4;
+        for (int gpu = 0; gpu < 2; gpu++) {
+            double early = median_of(iter, q, gpu);
+            double late = median_of(iter + n - q, q, gpu);
+            double growth = late - early;
+            int leak = growth > GROWTH_MIN_KB && growth > early * GROWTH_MIN_RATIO;
+            printf("  %-14s %s steady %.0f kB -> %.0f kB over %zu samples (%+.0f kB)%s\n",
+                    label, gpu ? "gpu" : "pss", early, late, n, growth,
+                    leak ? ", GROWING" : "");
+            growing += leak;
+        }
+    }
+    free(iter);
+    return growing;
+}
+
+int memstat_report(const struct memstat *ms, const char *title)
+{
+    int growing = 0;
+    if (ms->n == 0) return 0;
+
+    struct mem_sample peak;
+    memset(&peak, 0, sizeof peak);
+    printf("memory: %s\n", title);
+    for (size_t i = 0; i < ms->n; i++) {
+        const struct mem_sample *s = &ms->samples[i];
+        if (s->rss_kb > peak.rss_kb) peak.rss_kb = s->rss_kb;
+        if (s->pss_kb > peak.pss_kb) peak.pss_kb = s->pss_kb;
+        if (s->gpu_kb > peak.gpu_kb) peak.gpu_kb = s->gpu_kb;
+
+        // print phase boundaries, not every loop iteration
+        int first = i == 0 || strcmp(ms->samples[i-1].label, s->label);
+        int last = i + 1 == ms->n || strcmp(ms->samples[i+1].label, s->label);
+        if (first || last) {
+            printf("  %-14s rss %8llu kB  pss %8llu kB  gpu %8llu kB (%d drm fds)\n",
+                    s->label, (unsigned long long)s->rss_kb,
+                    (unsigned long long)s->pss_kb, (unsigned long long)s->gpu_kb,
+                    s->drm_clients);
+        }
+    }
+    printf("  %-14s rss %8llu kB  pss %8llu kB  gpu %8llu kB\n", "peak",
+            (unsigned long long)peak.rss_kb, (unsigned long long)peak.pss_kb,
+            (unsigned long long)peak.gpu_kb);
+
+    for (size_t i = 0; i < ms->n; i++) {
+        int seen = 0;
+        for (size_t j = 0; j < i; j++) seen |= !strcmp(ms->samples[j].label, ms->samples[i].label);
+        if (!seen) growing += report_growth(ms, ms->samples[i].label);
+    }
+    return growing;
+}
+
+void memstat_release(struct memstat *ms)
+{
+    free(ms->samples);
+    memset(ms, 0, sizeof *ms);
+}
@@ -0,0 +1,41 @@
+#ifndef _MEM_STAT_H
+#define _MEM_STAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * process memory (smaps_rollup) and gpu memory of every drm fd the process
+ * holds (fdinfo drm-memory-* keys, drm-total-* on newer kernels), in kB.
+ * the drm fds opened behind our back by mesa are found through /proc too.
+ */
+struct mem_sample {
+    const char *label;
+    uint64_t rss_kb, pss_kb;
+    uint64_t gpu_kb;
+    int drm_clients;
+};
+
+struct memstat {
+    struct mem_sample *samples;
+    size_t n, cap;
+};
+
+int mem_sample_read(struct mem_sample *s);
+
+/* label must outlive the memstat, samples sharing a label are treated as
+ * iterations of one loop when looking for growth */
+void memstat_sample(struct memstat *ms, const char *label);
+/* prints phases, peaks and steady state, returns how many series grew */
+int memstat_report(const struct memstat *ms, const char *title);
+void memstat_release(struct memstat *ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
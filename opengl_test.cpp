@@ -1,14 +1,24 @@
 #include <sys/stat.h>
-#include <sys/time.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include <random>
+#include <vector>
+#include <algorithm>
 
 #include <X11/Xlib.h>
+#include <X11/Xutil.h>
 //#include <GL/gl.h>
 
 #include "glutil.h"
+#include "benchutil.h"
+#include "frame_scheduler.h"
+#include "memstat.h"
+#include "gputrace.h"
+#include "benchresult.h"
+#include "framepace.h"
+#include "powerstat.h"
 #include <EGL/egl.h>
 
 #define err_msg(...) do { \
@@ -35,6 +45,10 @@ struct context_ {
     Window window;
 
     GLProcess* proc;
+    GLint red_loc;
+
+    struct trace* trace;
+    struct gpu_timer gpu;
 } dc = {
     0, 400, 300,
 };
@@ -137,27 +151,85 @@ static void setup_egl()
 
 }
 
-static void render()
+enum {
+    TRACK_CPU = 1,
+    TRACK_GPU,
+};
+
+// the drm device file of the gpu behind the display (EGL_EXT_device_query),
+// opened for powerstat. -1 for software rendering or without the extension
+static int open_egl_device(EGLDisplay display)
 {
+    PFNEGLQUERYDISPLAYATTRIBEXTPROC query_display =
+        (PFNEGLQUERYDISPLAYATTRIBEXTPROC)eglGetProcAddress("eglQueryDisplayAttribEXT");
+    PFNEGLQUERYDEVICESTRINGEXTPROC query_device =
+        (PFNEGLQUERYDEVICESTRINGEXTPROC)eglGetProcAddress("eglQueryDeviceStringEXT");
+    if (!query_display || !query_device) return -1;
+
+    EGLAttrib device;
+    if (!query_display(display, EGL_DEVICE_EXT, &device)) return -1;
+    const char *exts = query_device((EGLDeviceEXT)device, EGL_EXTENSIONS);
+    if (!exts || !extension_list_has(exts, "EGL_EXT_device_drm")) return -1;
+
+    const char *file = query_device((EGLDeviceEXT)device, EGL_DRM_DEVICE_FILE_EXT);
+    if (!file) return -1;
+    return open(file, O_RDONLY|O_CLOEXEC);
+}
+
+static void render(long frame)
+{
+    TraceScope scope(dc.trace, TRACK_CPU, "render", frame);
     static float red = 0.0;
+    gpu_timer_begin(&dc.gpu, "draw", frame);
     glClear(GL_COLOR_BUFFER_BIT);
-    glUniform1f(glGetUniformLocation(dc.proc->program, "red"), red);
+    glUniform1f(dc.red_loc, red);
     red += 0.01;
     if (red > 1.0) red = 0.0;
 
     glDrawArrays(GL_TRIANGLES, 0, 6);
+    gpu_timer_end(&dc.gpu);
 }
 
-static long get_time()
+static void usage(const char* prog)
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    err_quit("usage: %s [-m fixed|vsync] [-r rate_hz] [-d duration_ms] "
+            "[-f frames_in_flight] [-t trace.json]\n"
+            "  -f caps the frames queued ahead with a fence per frame and reports\n"
+            "     the latency from frame start to swap completion\n", prog);
 }
 
 int main(int argc, char *argv[])
 {
+    FrameScheduler::Mode mode = FrameScheduler::FixedRate;
+    double rate_hz = 1000.0 / 30;
+    long duration_ms = 3000;
+    const char* trace_path = NULL;
+    int max_in_flight = 0;
+
+    int c;
+    while ((c = getopt(argc, argv, "m:r:d:f:t:")) != -1) {
+        switch (c) {
+            case 'm':
+                if (!strcmp(optarg, "vsync")) mode = FrameScheduler::VSync;
+                else if (strcmp(optarg, "fixed")) usage(argv[0]);
+                break;
+            case 'r': rate_hz = atof(optarg); break;
+            case 'd': duration_ms = atol(optarg); break;
+            case 'f':
+                max_in_flight = atoi(optarg);
+                if (max_in_flight < 1 || max_in_flight > PACER_MAX_FRAMES) usage(argv[0]);
+                break;
+            case 't': trace_path = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+
+    struct memstat mem = {0};
+    memstat_sample(&mem, "start");
+
     setup_egl();
+    // in fixed mode the timer paces frames, swaps must not block on vblank
+    eglSwapInterval(dc.display, mode == FrameScheduler::VSync ? 1 : 0);
 
     glViewport(0, 0, dc.width, dc.height);
     
@@ -181,15 +253,43 @@ int main(int argc, char *argv[])
     glBufferData(GL_ARRAY_BUFFER, sizeof vertex_data, vertex_data, GL_STATIC_DRAW);
 
     glUseProgram(dc.proc->program);
+    dc.red_loc = glGetUniformLocation(dc.proc->program, "red");
 
     GLint pos_attrib = glGetAttribLocation(dc.proc->program, "position");
     glEnableVertexAttribArray(pos_attrib);
     glVertexAttribPointer(pos_attrib, 2, GL_FLOAT, GL_FALSE, 0, NULL);
 
-    long ts = get_time();
-    long start = ts;
-    int stop = 0;
-    while (!stop && get_time() - start < 3000) {
+    struct trace trace = {0};
+    if (trace_path) {
+        dc.trace = &trace;
+        trace_name_track(&trace, TRACK_CPU, "cpu");
+        trace_name_track(&trace, TRACK_GPU, "gpu");
+    }
+    gpu_timer_init(&dc.gpu, dc.trace, TRACK_GPU);
+    bench_result_gl_driver();
+
+    struct frame_pacer pacer;
+    if (max_in_flight) pacer_init(&pacer, dc.display, max_in_flight, 0);
+
+    memstat_sample(&mem, "setup");
+
+    FrameScheduler sched(mode, ConnectionNumber(dc.xdisplay), rate_hz);
+    if (!sched.start()) err_quit("cannot start frame scheduler\n");
+
+    struct powerstat power;
+    int drm_fd = open_egl_device(dc.display);
+    if (drm_fd < 0) err_msg("no drm device behind the egl display, cpu clocks only\n");
+    int have_power = !powerstat_open_fd(&power, NULL, drm_fd);
+    if (drm_fd >= 0) close(drm_fd);
+    if (have_power) powerstat_start(&power, 50);
+
+    vector<double> intervals, frame_times;
+    struct bench_cpu_usage cpu_begin, cpu_end;
+    bench_cpu_sample(&cpu_begin);
+
+    uint64_t deadline = cpu_begin.wall_ns + duration_ms * 1000000ull;
+    uint64_t last_frame = 0;
+    for (;;) {
         XEvent ev;
         while (XPending(dc.xdisplay)) {
             XNextEvent(dc.xdisplay, &ev);
@@ -200,14 +300,70 @@ int main(int argc, char *argv[])
             }
         }
 
-        long duration = get_time() - ts;
-        if (duration >= 30) {
-            render();
+        // retire frames while idle, when their fences signal, not when the
+        // next frame starts
+        if (max_in_flight) pacer_wait(&pacer, min(sched.next_frame_ns(), deadline));
+        FrameScheduler::Wake wake = sched.wait(deadline);
+        if (wake == FrameScheduler::Deadline) break;
+        if (wake == FrameScheduler::Events) continue;
+
+        long frame = frame_times.size();
+        if (max_in_flight) {
+            TraceScope scope(dc.trace, TRACK_CPU, "pace", frame);
+            pacer_begin_frame(&pacer);
+        }
+        uint64_t t0 = bench_now_ns();
+        render(frame);
+        {
+            TraceScope scope(dc.trace, TRACK_CPU, "swap", frame);
             eglSwapBuffers(dc.display, dc.surface);
-            ts = get_time();
         }
+        if (max_in_flight) pacer_end_frame(&pacer);
+        uint64_t t1 = bench_now_ns();
+        if (dc.trace) trace_complete(dc.trace, TRACK_CPU, "frame", frame, t0, t1);
+        gpu_timer_collect(&dc.gpu, 0);
+
+        if (last_frame) intervals.push_back(bench_ns_to_ms(t0 - last_frame));
+        frame_times.push_back(bench_ns_to_ms(t1 - t0));
+        last_frame = t0;
+
+        // outside of the timed region, reading /proc is not free
+        if (frame_times.size() % 10 == 0) memstat_sample(&mem, "frames");
     }
 
+    bench_cpu_sample(&cpu_end);
+    if (have_power) powerstat_stop(&power);
+    gpu_timer_collect(&dc.gpu, 1);
+    printf("%s mode, %zu frames, %llu missed timer periods\n",
+            FrameScheduler::mode_name(mode), frame_times.size(),
+            (unsigned long long)sched.missed());
+
+    struct bench_stats st;
+    bench_stats_compute(intervals.data(), intervals.size(), &st);
+    bench_stats_print("frame interval", "ms", &st);
+    bench_stats_compute(frame_times.data(), frame_times.size(), &st);
+    bench_stats_print("render+swap", "ms", &st);
+    bench_result_record("opengl_test", "render+swap", "ms", 1, frame_times.data(),
+            frame_times.size());
+    gpu_timer_print(&dc.gpu, "draw");
+    bench_cpu_print("cpu usage", &cpu_begin, &cpu_end);
+    if (have_power) {
+        powerstat_report(&power, "opengl_test", "render");
+        powerstat_release(&power);
+    }
+
+    if (max_in_flight) {
+        char metric[64];
+        snprintf(metric, sizeof metric, "latency %d in flight", max_in_flight);
+        bench_result_record("opengl_test", metric, "ms", 1, pacer.latency_ms,
+                pacer.n_latency);
+        pacer_print(&pacer, "input to swap done");
+        printf("%-24s %.1f fps\n", "throughput",
+                frame_times.size() / ((cpu_end.wall_ns - cpu_begin.wall_ns) / 1e9));
+        pacer_release(&pacer);
+    }
+
+    gpu_timer_release(&dc.gpu);
     glprocess_release(dc.proc);
 
     eglDestroySurface(dc.display, dc.surface);
@@ -216,5 +372,17 @@ int main(int argc, char *argv[])
 
     XDestroyWindow(dc.xdisplay, dc.window);
     XCloseDisplay(dc.xdisplay);
+
+    memstat_sample(&mem, "end");
+    memstat_report(&mem, "opengl_test");
+    memstat_release(&mem);
+
+    if (dc.trace) {
+        if (trace_write(dc.trace, "opengl_test", trace_path))
+            err_msg("cannot write trace to %s\n", trace_path);
+        else
+            printf("trace with %zu events written to %s\n", dc.trace->n, trace_path);
+        trace_release(dc.trace);
+    }
     return 0;
 }
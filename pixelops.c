@@ -0,0 +1,348 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "pixelops.h"
+
+// the references should stay scalar, whatever -O level they are built at
+#if defined(__GNUC__) && !defined(__clang__)
+#define PX_SCALAR __attribute__((optimize("no-tree-vectorize")))
+#else
+#define PX_SCALAR
+#endif
+
+// x / 255 rounded, exact for x in [0, 255 * 255]
+static inline uint32_t div255(uint32_t x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline uint32_t expand5(uint32_t v) { return (v << 3) | (v >> 2); }
+static inline uint32_t expand6(uint32_t v) { return (v << 2) | (v >> 4); }
+
+PX_SCALAR static void fill32_c(uint32_t *dst, size_t n, uint32_t color)
+{
+    for (size_t i = 0; i < n; i++) dst[i] = color;
+}
+
+PX_SCALAR static void fill16_c(uint16_t *dst, size_t n, uint16_t color)
+{
+    for (size_t i = 0; i < n; i++) dst[i] = color;
+}
+
+PX_SCALAR static void copy_c(void *dst, const void *src, size_t bytes)
+{
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    for (size_t i = 0; i < bytes; i++) d[i] = s[i];
+}
+
+PX_SCALAR static void rgba_to_xrgb_c(uint32_t *dst, const uint8_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++, src += 4) {
+        dst[i] = 0xff000000u | (uint32_t)src[0] << 16 | (uint32_t)src[1] << 8 | src[2];
+    }
+}
+
+PX_SCALAR static void rgba_to_rgb565_c(uint16_t *dst, const uint8_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++, src += 4) {
+        dst[i] = (src[0] >> 3) << 11 | (src[1] >> 2) << 5 | src[2] >> 3;
+    }
+}
+
+PX_SCALAR static void over_xrgb_c(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        uint32_t s = src[i], d = dst[i], inv = 255 - (s >> 24), out = 0xff000000u;
+        for (int shift = 0; shift < 24; shift += 8) {
+            uint32_t c = ((s >> shift) & 0xff) + div255(((d >> shift) & 0xff) * inv);
+            out |= (c > 255 ? 255 : c) << shift;
+        }
+        dst[i] = out;
+    }
+}
+
+PX_SCALAR static void over_rgb565_c(uint16_t *dst, const uint32_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        uint32_t s = src[i], d = dst[i], inv = 255 - (s >> 24);
+        uint32_t r = ((s >> 16) & 0xff) + div255(expand5(d >> 11) * inv);
+        uint32_t g = ((s >> 8) & 0xff) + div255(expand6((d >> 5) & 0x3f) * inv);
+        uint32_t b = (s & 0xff) + div255(expand5(d & 0x1f) * inv);
+        if (r > 255) r = 255;
+        if (g > 255) g = 255;
+        if (b > 255) b = 255;
+        dst[i] = (r >> 3) << 11 | (g >> 2) << 5 | b >> 3;
+    }
+}
+
+const struct px_kernels px_scalar = {
+    "scalar", fill32_c, fill16_c, copy_c, rgba_to_xrgb_c, rgba_to_rgb565_c,
+    over_xrgb_c, over_rgb565_c,
+};
+
+#ifdef __SSE2__
+
+// scanout memory is often write combined: stream whole lines, never read
+static void fill32_sse2(uint32_t *dst, size_t n, uint32_t color)
+{
+    size_t i = 0;
+    for (; i < n && ((uintptr_t)(dst + i) & 15); i++) dst[i] = color;
+    __m128i c = _mm_set1_epi32(color);
+    for (; i + 16 <= n; i += 16) {
+        _mm_stream_si128((__m128i *)(dst + i), c);
+        _mm_stream_si128((__m128i *)(dst + i + 4), c);
+        _mm_stream_si128((__m128i *)(dst + i + 8), c);
+        _mm_stream_si128((__m128i *)(dst + i + 12), c);
+    }
+    for (; i + 4 <= n; i += 4) _mm_stream_si128((__m128i *)(dst + i), c);
+    _mm_sfence();
+    for (; i < n; i++) dst[i] = color;
+}
+
+static void fill16_sse2(uint16_t *dst, size_t n, uint16_t color)
+{
+    size_t i = 0;
+    for (; i < n && ((uintptr_t)(dst + i) & 15); i++) dst[i] = color;
+    __m128i c = _mm_set1_epi16(color);
+    for (; i + 32 <= n; i += 32) {
+        _mm_stream_si128((__m128i *)(dst + i), c);
+        _mm_stream_si128((__m128i *)(dst + i + 8), c);
+        _mm_stream_si128((__m128i *)(dst + i + 16), c);
+        _mm_stream_si128((__m128i *)(dst + i + 24), c);
+    }
+    for (; i + 8 <= n; i += 8) _mm_stream_si128((__m128i *)(dst + i), c);
+    _mm_sfence();
+    for (; i < n; i++) dst[i] = color;
+}
+
+static void copy_sse2(void *dst, const void *src, size_t bytes)
+{
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    size_t i = 0;
+    for (; i < bytes && ((uintptr_t)(d + i) & 15); i++) d[i] = s[i];
+    for (; i + 64 <= bytes; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(s + i + 32));
+        __m128i e = _mm_loadu_si128((const __m128i *)(s + i + 48));
+        _mm_stream_si128((__m128i *)(d + i), a);
+        _mm_stream_si128((__m128i *)(d + i + 16), b);
+        _mm_stream_si128((__m128i *)(d + i + 32), c);
+        _mm_stream_si128((__m128i *)(d + i + 48), e);
+    }
+    for (; i + 16 <= bytes; i += 16)
+        _mm_stream_si128((__m128i *)(d + i), _mm_loadu_si128((const __m128i *)(s + i)));
+    _mm_sfence();
+    for (; i < bytes; i++) d[i] = s[i];
+}
+
+// 0xAABBGGRR words to 0xffRRGGBB
+static inline __m128i swap_rb(__m128i v)
+{
+    const __m128i g = _mm_set1_epi32(0x0000ff00), x = _mm_set1_epi32(0xff000000);
+    const __m128i lo = _mm_set1_epi32(0xff);
+    __m128i r = _mm_slli_epi32(_mm_and_si128(v, lo), 16);
+    __m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), lo);
+    return _mm_or_si128(_mm_or_si128(r, b), _mm_or_si128(_mm_and_si128(v, g), x));
+}
+
+static void rgba_to_xrgb_sse2(uint32_t *dst, const uint8_t *src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i * 4 + 16));
+        _mm_storeu_si128((__m128i *)(dst + i), swap_rb(a));
+        _mm_storeu_si128((__m128i *)(dst + i + 4), swap_rb(b));
+    }
+    rgba_to_xrgb_c(dst + i, src + i * 4, n - i);
+}
+
+// 0xAABBGGRR words to 565 values, still in 32 bit lanes
+static inline __m128i rgba_565_lanes(__m128i v)
+{
+    __m128i r = _mm_slli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xf8)), 8);
+    __m128i g = _mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xfc00)), 5);
+    __m128i b = _mm_and_si128(_mm_srli_epi32(v, 19), _mm_set1_epi32(0x1f));
+    return _mm_or_si128(_mm_or_si128(r, g), b);
+}
+
+// packs unsigned 16 bit values held in 32 bit lanes, packs_epi32 is signed
+static inline __m128i pack_u16(__m128i a, __m128i b)
+{
+    const __m128i bias32 = _mm_set1_epi32(0x8000), bias16 = _mm_set1_epi16((short)0x8000);
+    __m128i p = _mm_packs_epi32(_mm_sub_epi32(a, bias32), _mm_sub_epi32(b, bias32));
+    return _mm_add_epi16(p, bias16);
+}
+
+static void rgba_to_rgb565_sse2(uint16_t *dst, const uint8_t *src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i * 4 + 16));
+        _mm_storeu_si128((__m128i *)(dst + i), pack_u16(rgba_565_lanes(a), rgba_565_lanes(b)));
+    }
+    rgba_to_rgb565_c(dst + i, src + i * 4, n - i);
+}
+
+// div255 on 16 bit lanes
+static inline __m128i div255_epu16(__m128i x)
+{
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// two pixels unpacked to 16 bit lanes
+static inline __m128i over_2px(__m128i s, __m128i d)
+{
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)),
+            _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), a);
+    return _mm_add_epi16(s, div255_epu16(_mm_mullo_epi16(d, inv)));
+}
+
+static void over_xrgb_sse2(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    const __m128i zero = _mm_setzero_si128(), x = _mm_set1_epi32(0xff000000);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i lo = over_2px(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+        __m128i hi = over_2px(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(_mm_packus_epi16(lo, hi), x));
+    }
+    over_xrgb_c(dst + i, src + i, n - i);
+}
+
+static void over_rgb565_sse2(uint16_t *dst, const uint32_t *src, size_t n)
+{
+    const __m128i m5 = _mm_set1_epi16(0x1f), m6 = _mm_set1_epi16(0x3f);
+    const __m128i m8 = _mm_set1_epi32(0xff), c255 = _mm_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i s0 = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i s1 = _mm_loadu_si128((const __m128i *)(src + i + 4));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+
+        // channels of 8 pixels, one per 16 bit lane
+        __m128i sa = _mm_packs_epi32(_mm_srli_epi32(s0, 24), _mm_srli_epi32(s1, 24));
+        __m128i sr = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(s0, 16), m8),
+                _mm_and_si128(_mm_srli_epi32(s1, 16), m8));
+        __m128i sg = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(s0, 8), m8),
+                _mm_and_si128(_mm_srli_epi32(s1, 8), m8));
+        __m128i sb = _mm_packs_epi32(_mm_and_si128(s0, m8), _mm_and_si128(s1, m8));
+
+        __m128i dr = _mm_srli_epi16(d, 11);
+        __m128i dg = _mm_and_si128(_mm_srli_epi16(d, 5), m6);
+        __m128i db = _mm_and_si128(d, m5);
+        dr = _mm_or_si128(_mm_slli_epi16(dr, 3), _mm_srli_epi16(dr, 2));
+        dg = _mm_or_si128(_mm_slli_epi16(dg, 2), _mm_srli_epi16(dg, 4));
+        db = _mm_or_si128(_mm_slli_epi16(db, 3), _mm_srli_epi16(db, 2));
+
+        __m128i inv = _mm_sub_epi16(c255, sa);
+        __m128i r = _mm_min_epi16(_mm_add_epi16(sr, div255_epu16(_mm_mullo_epi16(dr, inv))), c255);
+        __m128i g = _mm_min_epi16(_mm_add_epi16(sg, div255_epu16(_mm_mullo_epi16(dg, inv))), c255);
+        __m128i b = _mm_min_epi16(_mm_add_epi16(sb, div255_epu16(_mm_mullo_epi16(db, inv))), c255);
+
+        __m128i out = _mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(r, 3), 11),
+                _mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(g, 2), 5), _mm_srli_epi16(b, 3)));
+        _mm_storeu_si128((__m128i *)(dst + i), out);
+    }
+    over_rgb565_c(dst + i, src + i, n - i);
+}
+
+const struct px_kernels px_simd = {
+    "sse2", fill32_sse2, fill16_sse2, copy_sse2, rgba_to_xrgb_sse2,
+    rgba_to_rgb565_sse2, over_xrgb_sse2, over_rgb565_sse2,
+};
+
+#else
+
+const struct px_kernels px_simd = {
+    "scalar", fill32_c, fill16_c, copy_c, rgba_to_xrgb_c, rgba_to_rgb565_c,
+    over_xrgb_c, over_rgb565_c,
+};
+
+#endif
+
+// premultiplied, so that over never has to clamp
+static uint32_t random_argb(uint32_t *seed)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    uint32_t v = *seed >> 8, a = v & 0xff;
+    if (v & 0x100) a = 0xff;
+    uint32_t r = ((v >> 9) & 0xff) * a / 255, g = ((v >> 3) & 0xff) * a / 255;
+    uint32_t b = ((v >> 12) & 0xff) * a / 255;
+    return a << 24 | r << 16 | g << 8 | b;
+}
+
+const char *px_validate(const struct px_kernels *k)
+{
+    // lengths around the vector widths, and unaligned starts
+    static const size_t lengths[] = { 0, 1, 3, 7, 8, 15, 16, 17, 31, 33, 64, 67, 1921 };
+    const size_t max = 1921 + 4;
+    uint32_t *src = malloc(max * 4), *a = malloc(max * 4), *b = malloc(max * 4);
+    const char *failed = NULL;
+    uint32_t seed = 1;
+
+    if (!src || !a || !b) failed = "out of memory";
+    for (size_t l = 0; !failed && l < sizeof lengths / sizeof lengths[0]; l++) {
+        for (size_t off = 0; !failed && off < 3; off++) {
+            size_t n = lengths[l];
+            for (size_t i = 0; i < max; i++) {
+                src[i] = random_argb(&seed);
+                a[i] = b[i] = random_argb(&seed) | 0xff000000u;
+            }
+
+            // b receives the reference, a the result under test
+            memcpy(b, a, max * 4);
+            px_scalar.fill32(b + off, n, 0x12345678);
+            k->fill32(a + off, n, 0x12345678);
+            if (!failed && memcmp(a, b, max * 4)) failed = "fill32";
+
+            memcpy(b, a, max * 4);
+            px_scalar.fill16((uint16_t *)b + off, n, 0xbeef);
+            k->fill16((uint16_t *)a + off, n, 0xbeef);
+            if (!failed && memcmp(a, b, max * 4)) failed = "fill16";
+
+            memcpy(b, a, max * 4);
+            px_scalar.copy((uint8_t *)b + off, (uint8_t *)src + 1, n * 4);
+            k->copy((uint8_t *)a + off, (uint8_t *)src + 1, n * 4);
+            if (!failed && memcmp(a, b, max * 4)) failed = "copy";
+
+            memcpy(b, a, max * 4);
+            px_scalar.rgba_to_xrgb(b + off, (uint8_t *)src + off, n);
+            k->rgba_to_xrgb(a + off, (uint8_t *)src + off, n);
+            if (!failed && memcmp(a, b, max * 4)) failed = "rgba_to_xrgb";
+
+            memcpy(b, a, max * 4);
+            px_scalar.rgba_to_rgb565((uint16_t *)b + off, (uint8_t *)src + off, n);
+            k->rgba_to_rgb565((uint16_t *)a + off, (uint8_t *)src + off, n);
+            if (!failed && memcmp(a, b, max * 4)) failed = "rgba_to_rgb565";
+
+            memcpy(b, a, max * 4);
+            px_scalar.over_xrgb(b + off, src + off, n);
+            k->over_xrgb(a + off, src + off, n);
+            if (!failed && memcmp(a, b, max * 4)) failed = "over_xrgb";
+
+            memcpy(b, a, max * 4);
+            px_scalar.over_rgb565((uint16_t *)b + off, src + off, n);
+            k->over_rgb565((uint16_t *)a + off, src + off, n);
+            if (!failed && memcmp(a, b, max * 4)) failed = "over_rgb565";
+        }
+    }
+
+    free(src);
+    free(a);
+    free(b);
+    return failed;
+}
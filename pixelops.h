@@ -0,0 +1,43 @@
+#ifndef _PIXEL_OPS_H
+#define _PIXEL_OPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * cpu pixel kernels for software rendered scanout, one row at a time.
+ * xrgb is XRGB8888 and argb premultiplied ARGB8888 as little endian
+ * words (DRM_FORMAT_*), rgba is R,G,B,A in byte order as decoders and
+ * image loaders hand it out. "over" blends argb onto the destination.
+ * /255 rounds the same way in every implementation, so results must be
+ * bit exact against the scalar set.
+ */
+struct px_kernels {
+    const char *name;
+    void (*fill32)(uint32_t *dst, size_t n, uint32_t color);
+    void (*fill16)(uint16_t *dst, size_t n, uint16_t color);
+    void (*copy)(void *dst, const void *src, size_t bytes);
+    void (*rgba_to_xrgb)(uint32_t *dst, const uint8_t *src, size_t n);
+    void (*rgba_to_rgb565)(uint16_t *dst, const uint8_t *src, size_t n);
+    void (*over_xrgb)(uint32_t *dst, const uint32_t *src, size_t n);
+    void (*over_rgb565)(uint16_t *dst, const uint32_t *src, size_t n);
+};
+
+/* plain c, the reference */
+extern const struct px_kernels px_scalar;
+/* the vectorized set of this build (sse2), px_scalar without one */
+extern const struct px_kernels px_simd;
+
+/* runs every kernel of k against px_scalar on odd lengths and offsets.
+ * returns NULL when all match, else the name of the first that differs */
+const char *px_validate(const struct px_kernels *k);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
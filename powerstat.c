@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include "benchutil.h"
+#include "benchresult.h"
+#include "powerstat.h"
+
+#define MAX_CPUS 1024
+
+// whole file into buf, returns its length or -1
+static int read_file(const char *path, char *buf, size_t len)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    size_t n = fread(buf, 1, len - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+    return n;
+}
+
+static int read_int(const char *dir, const char *name)
+{
+    char path[512], buf[64];
+    snprintf(path, sizeof path, "%s/%s", dir, name);
+    if (read_file(path, buf, sizeof buf) <= 0) return -1;
+    return atoi(buf);
+}
+
+static int path_exists(const char *dir, const char *name)
+{
+    char path[512];
+    snprintf(path, sizeof path, "%s/%s", dir, name);
+    return access(path, F_OK) == 0;
+}
+
+// "0: 500Mhz\n1: 800Mhz *\n", the current level is marked. with max set
+// the highest level is returned instead
+static int parse_dpm(const char *text, int max)
+{
+    int best = -1;
+    for (const char *line = text; line && *line; ) {
+        int level, mhz;
+        const char *end = strchr(line, '\n');
+        if (sscanf(line, "%d: %dMhz", &level, &mhz) == 2) {
+            const char *star = strchr(line, '*');
+            if (max ? mhz > best : star && (!end || star < end)) best = mhz;
+        }
+        line = end ? end + 1 : NULL;
+    }
+    return best;
+}
+
+static int read_dpm(const char *card, int max)
+{
+    char path[512], buf[1024];
+    snprintf(path, sizeof path, "%s/device/pp_dpm_sclk", card);
+    if (read_file(path, buf, sizeof buf) <= 0) return -1;
+    return parse_dpm(buf, max);
+}
+
+static void read_driver(struct powerstat *ps)
+{
+    char path[512], buf[1024];
+    snprintf(path, sizeof path, "%s/device/uevent", ps->card);
+    strcpy(ps->driver, "unknown");
+    if (read_file(path, buf, sizeof buf) <= 0) return;
+
+    const char *p = strstr(buf, "DRIVER=");
+    if (p) sscanf(p + 7, "%31[^\n]", ps->driver);
+}
+
+static void set_root(struct powerstat *ps, const char *root)
+{
+    memset(ps, 0, sizeof *ps);
+    if (!root) root = getenv("BENCH_SYSFS_ROOT");
+    if (!root || !*root) root = "/sys";
+    snprintf(ps->root, sizeof ps->root, "%s", root);
+    ps->max_mhz = -1;
+}
+
+static void set_card(struct powerstat *ps, const char *dir)
+{
+    strcpy(ps->card, dir);
+    read_driver(ps);
+    ps->max_mhz = read_int(ps->card, "gt_RP0_freq_mhz");
+    if (ps->max_mhz < 0) ps->max_mhz = read_dpm(ps->card, 1);
+}
+
+static int count_cpus(struct powerstat *ps)
+{
+    char cpus[320];
+    snprintf(cpus, sizeof cpus, "%s/devices/system/cpu", ps->root);
+    for (ps->ncpus = 0; ps->ncpus < MAX_CPUS; ps->ncpus++) {
+        char name[64];
+        snprintf(name, sizeof name, "cpu%d/cpufreq/scaling_cur_freq", ps->ncpus);
+        if (!path_exists(cpus, name)) break;
+    }
+    return !ps->card[0] && !ps->ncpus;
+}
+
+int powerstat_open(struct powerstat *ps, const char *root, int card)
+{
+    set_root(ps, root);
+    for (int i = card < 0 ? 0 : card; i < (card < 0 ? 64 : card + 1); i++) {
+        char dir[320];
+        snprintf(dir, sizeof dir, "%s/class/drm/card%d", ps->root, i);
+        if (path_exists(dir, "device")) {
+            set_card(ps, dir);
+            break;
+        }
+    }
+    return count_cpus(ps);
+}
+
+// the cardN next to the node: <root>/dev/char/MAJ:MIN/device/drm lists the
+// primary and render nodes of the device the node belongs to
+static int card_of_fd(const struct powerstat *ps, int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISCHR(st.st_mode)) return -1;
+
+    char path[320];
+    snprintf(path, sizeof path, "%s/dev/char/%u:%u/device/drm", ps->root,
+            major(st.st_rdev), minor(st.st_rdev));
+    DIR *dir = opendir(path);
+    if (!dir) return -1;
+
+    int card = -1;
+    struct dirent *e;
+    while (card < 0 && (e = readdir(dir))) {
+        char rest;
+        if (sscanf(e->d_name, "card%d%c", &card, &rest) != 1) card = -1;
+    }
+    closedir(dir);
+    return card;
+}
+
+int powerstat_open_fd(struct powerstat *ps, const char *root, int fd)
+{
+    set_root(ps, root);
+    int card = card_of_fd(ps, fd);
+    if (card >= 0) {
+        char dir[320];
+        snprintf(dir, sizeof dir, "%s/class/drm/card%d", ps->root, card);
+        if (path_exists(dir, "device")) set_card(ps, dir);
+    }
+    return count_cpus(ps);
+}
+
+static const char *runtime_states[] = { "suspended", "suspending", "resuming", "active" };
+
+void powerstat_read(const struct powerstat *ps, struct power_sample *s)
+{
+    s->t_ns = bench_now_ns();
+    s->gt_cur_mhz = s->gt_act_mhz = s->sclk_mhz = s->busy_pct = -1;
+    s->runtime_active = -1;
+    s->cpu_mhz = -1;
+
+    if (ps->card[0]) {
+        char path[512], buf[32];
+        s->gt_cur_mhz = read_int(ps->card, "gt_cur_freq_mhz");
+        s->gt_act_mhz = read_int(ps->card, "gt_act_freq_mhz");
+        s->sclk_mhz = read_dpm(ps->card, 0);
+        s->busy_pct = read_int(ps->card, "device/gpu_busy_percent");
+
+        snprintf(path, sizeof path, "%s/device/power/runtime_status", ps->card);
+        if (read_file(path, buf, sizeof buf) > 0) {
+            buf[strcspn(buf, "\n")] = '\0';
+            for (int i = 0; i < 4; i++) {
+                if (!strcmp(buf, runtime_states[i])) s->runtime_active = i >= 2;
+            }
+        }
+    }
+
+    char cpus[320];
+    long sum = 0;
+    int n = 0;
+    snprintf(cpus, sizeof cpus, "%s/devices/system/cpu", ps->root);
+    for (int i = 0; i < ps->ncpus; i++) {
+        char name[64];
+        snprintf(name, sizeof name, "cpu%d/cpufreq/scaling_cur_freq", i);
+        int khz = read_int(cpus, name);
+        if (khz > 0) {
+            sum += khz;
+            n++;
+        }
+    }
+    if (n) s->cpu_mhz = sum / n / 1000;
+}
+
+static void add_sample(struct powerstat *ps, const struct power_sample *s)
+{
+    if (ps->n == ps->cap) {
+        size_t cap = ps->cap ? ps->cap * 2 : 256;
+        struct power_sample *p = realloc(ps->samples, cap * sizeof *p);
+        if (!p) return;
+        ps->samples = p;
+        ps->cap = cap;
+    }
+    ps->samples[ps->n++] = *s;
+}
+
+static void *sampler(void *data)
+{
+    struct powerstat *ps = data;
+    while (!__atomic_load_n(&ps->stop, __ATOMIC_ACQUIRE)) {
+        struct power_sample s;
+        powerstat_read(ps, &s);
+        add_sample(ps, &s);
+        usleep(ps->interval_ms * 1000);
+    }
+    return NULL;
+}
+
+int powerstat_start(struct powerstat *ps, int interval_ms)
+{
+    if (ps->running) powerstat_stop(ps);
+    ps->n = 0;
+    ps->stop = 0;
+    ps->interval_ms = interval_ms > 0 ? interval_ms : 50;
+    if (pthread_create(&ps->thread, NULL, sampler, ps)) return 1;
+    ps->running = 1;
+    return 0;
+}
+
+void powerstat_stop(struct powerstat *ps)
+{
+    if (!ps->running) return;
+    __atomic_store_n(&ps->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(ps->thread, NULL);
+    ps->running = 0;
+}
+
+// one counter of every sample, unread ones left out. returns the count
+static size_t column(const struct powerstat *ps, size_t offset, double *out)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < ps->n; i++) {
+        int v = *(const int *)((const char *)&ps->samples[i] + offset);
+        if (v >= 0) out[n++] = v;
+    }
+    return n;
+}
+
+void powerstat_report(struct powerstat *ps, const char *test, const char *label)
+{
+    static const struct {
+        const char *name;
+        const char *unit;
+        size_t offset;
+    } counters[] = {
+        { "gpu requested", "MHz", offsetof(struct power_sample, gt_cur_mhz) },
+        { "gpu actual", "MHz", offsetof(struct power_sample, gt_act_mhz) },
+        { "gpu sclk", "MHz", offsetof(struct power_sample, sclk_mhz) },
+        { "gpu busy", "%", offsetof(struct power_sample, busy_pct) },
+        { "cpu", "MHz", offsetof(struct power_sample, cpu_mhz) },
+    };
+
+    if (ps->n == 0) return;
+    double *v = malloc(ps->n * sizeof *v);
+    if (!v) return;
+
+    printf("%s: %zu power samples, %s %s\n", label, ps->n,
+            ps->card[0] ? ps->card + strlen(ps->root) + 1 : "no card", ps->driver);
+    for (size_t c = 0; c < sizeof counters / sizeof counters[0]; c++) {
+        size_t n = column(ps, counters[c].offset, v);
+        if (n == 0) continue;
+
+        char metric[128];
+        snprintf(metric, sizeof metric, "%s %s", label, counters[c].name);
+        bench_result_record(test, metric, counters[c].unit, BENCH_CONTEXT, v, n);
+
+        struct bench_stats st;
+        snprintf(metric, sizeof metric, "  %s", counters[c].name);
+        bench_stats_compute(v, n, &st);
+        bench_stats_print(metric, counters[c].unit, &st);
+        if (ps->max_mhz > 0 && strcmp(counters[c].unit, "MHz") == 0 &&
+                strncmp(counters[c].name, "gpu", 3) == 0) {
+            printf("%-24s median at %.0f%% of the %d MHz maximum\n", "",
+                    100.0 * st.median / ps->max_mhz, ps->max_mhz);
+        }
+    }
+
+    size_t known = 0, active = 0;
+    for (size_t i = 0; i < ps->n; i++) {
+        if (ps->samples[i].runtime_active < 0) continue;
+        known++;
+        active += ps->samples[i].runtime_active;
+    }
+    if (known) {
+        printf("  %-22s active in %zu of %zu samples%s\n", "runtime pm", active, known,
+                active < known ? ", SUSPENDED during the run" : "");
+    }
+    free(v);
+}
+
+void powerstat_release(struct powerstat *ps)
+{
+    powerstat_stop(ps);
+    free(ps->samples);
+    ps->samples = NULL;
+    ps->n = ps->cap = 0;
+}
@@ -0,0 +1,66 @@
+#ifndef _POWER_STAT_H
+#define _POWER_STAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * gpu clocks and power state while a benchmark runs, read from sysfs by a
+ * background thread so a slow run can be told apart from a clocked down one:
+ *
+ *   i915     gt_cur_freq_mhz (requested) and gt_act_freq_mhz (actual)
+ *   amdgpu   device/pp_dpm_sclk (the level marked *), device/gpu_busy_percent
+ *   any      device/power/runtime_status of the card
+ *   cpu      mean scaling_cur_freq over all cpus
+ *
+ * counters the card does not have read as -1. every path is below the
+ * sysfs root given to powerstat_open (NULL: $BENCH_SYSFS_ROOT, else /sys),
+ * so a directory of fixture files can stand in for a real machine.
+ */
+struct power_sample {
+    uint64_t t_ns;
+    int gt_cur_mhz, gt_act_mhz;
+    int sclk_mhz, busy_pct;
+    int runtime_active;             // 1 active, 0 suspended or suspending
+    int cpu_mhz;
+};
+
+struct powerstat {
+    char root[256];
+    char card[320];                 // <root>/class/drm/cardN, empty without one
+    char driver[32];
+    int max_mhz;                    // RP0 or the highest sclk level, -1 unknown
+    int ncpus;
+
+    pthread_t thread;
+    int running, stop;
+    int interval_ms;
+    struct power_sample *samples;
+    size_t n, cap;
+};
+
+/* card -1 takes the first card with a device. cpu clocks are sampled even
+ * without a card. returns non-zero when neither is found */
+int powerstat_open(struct powerstat *ps, const char *root, int card);
+/* the card behind an open drm fd, primary or render node, found through
+ * <root>/dev/char/MAJ:MIN. only cpu clocks are sampled when it is not */
+int powerstat_open_fd(struct powerstat *ps, const char *root, int fd);
+void powerstat_read(const struct powerstat *ps, struct power_sample *s);
+/* drops earlier samples and samples every interval_ms until stopped */
+int powerstat_start(struct powerstat *ps, int interval_ms);
+void powerstat_stop(struct powerstat *ps);
+/* prints every counter that was read and records it as test/<label> <counter>.
+ * the records are context for the other series, never regressions */
+void powerstat_report(struct powerstat *ps, const char *test, const char *label);
+void powerstat_release(struct powerstat *ps);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
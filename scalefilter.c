@@ -0,0 +1,305 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "scalefilter.h"
+
+// the references should stay scalar, whatever -O level they are built at
+#if defined(__GNUC__) && !defined(__clang__)
+#define SF_SCALAR __attribute__((optimize("no-tree-vectorize")))
+#else
+#define SF_SCALAR
+#endif
+
+const char *sf_filter_name(enum sf_filter f)
+{
+    switch (f) {
+    case SF_BILINEAR: return "bilinear";
+    case SF_BICUBIC: return "bicubic";
+    case SF_LANCZOS: return "lanczos";
+    default: return "unknown";
+    }
+}
+
+int sf_filter_radius(enum sf_filter f)
+{
+    switch (f) {
+    case SF_BICUBIC: return 2;
+    case SF_LANCZOS: return 3;
+    default: return 1;
+    }
+}
+
+double sf_filter_weight(enum sf_filter f, double x)
+{
+    x = fabs(x);
+    switch (f) {
+    case SF_BILINEAR:
+        return x < 1.0 ? 1.0 - x : 0.0;
+    case SF_BICUBIC:
+        if (x < 1.0) return (1.5 * x - 2.5) * x * x + 1.0;
+        if (x < 2.0) return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+        return 0.0;
+    case SF_LANCZOS:
+        if (x < 1e-6) return 1.0;
+        if (x < 3.0) return 3.0 * sin(M_PI * x) * sin(M_PI * x / 3.0) / (M_PI * M_PI * x * x);
+        return 0.0;
+    default:
+        return 0.0;
+    }
+}
+
+double sf_filter_stretch(enum sf_filter f, int src_len, int dst_len)
+{
+    if (f == SF_BILINEAR || src_len <= dst_len) return 1.0;
+    return (double)src_len / dst_len;
+}
+
+int sf_filter_taps(enum sf_filter f, int src_len, int dst_len)
+{
+    return 2 * (int)ceil(sf_filter_radius(f) * sf_filter_stretch(f, src_len, dst_len));
+}
+
+static int axis_init(struct sf_axis *a, enum sf_filter f, int src_len, int dst_len)
+{
+    double scale = (double)src_len / dst_len;
+    double stretch = sf_filter_stretch(f, src_len, dst_len);
+
+    a->len = dst_len;
+    a->taps = sf_filter_taps(f, src_len, dst_len);
+    a->index = malloc(sizeof(int) * dst_len * a->taps);
+    a->weight = malloc(sizeof(int16_t) * dst_len * a->taps);
+    if (!a->index || !a->weight) return -1;
+
+    double w[a->taps];
+    for (int i = 0; i < dst_len; i++) {
+        int *index = a->index + i * a->taps;
+        int16_t *weight = a->weight + i * a->taps;
+
+        // the same tap placement as the shaders: centered on the sample
+        // position, then clamped to the edge
+        double c = (i + 0.5) * scale;
+        int first = (int)floor(c - 0.5) - a->taps / 2 + 1;
+        double sum = 0;
+        for (int j = 0; j < a->taps; j++) {
+            w[j] = sf_filter_weight(f, (first + j + 0.5 - c) / stretch);
+            sum += w[j];
+            int idx = first + j;
+            index[j] = idx < 0 ? 0 : idx >= src_len ? src_len - 1 : idx;
+        }
+
+        // rounding may leave the fixed point sum off by a few, the largest
+        // weight takes the difference
+        int total = 0, largest = 0;
+        for (int j = 0; j < a->taps; j++) {
+            weight[j] = (int16_t)lrint(w[j] / sum * (1 << SF_SHIFT));
+            total += weight[j];
+            if (weight[j] > weight[largest]) largest = j;
+        }
+        weight[largest] += (1 << SF_SHIFT) - total;
+    }
+    return 0;
+}
+
+static void axis_release(struct sf_axis *a)
+{
+    free(a->index);
+    free(a->weight);
+    a->index = NULL;
+    a->weight = NULL;
+}
+
+static inline uint8_t round_clamp(int sum)
+{
+    int v = (sum + (1 << (SF_SHIFT - 1))) >> SF_SHIFT;
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+SF_SCALAR static void hscale_c(uint8_t *dst, const uint8_t *src, const struct sf_axis *x)
+{
+    for (int i = 0; i < x->len; i++, dst += 4) {
+        const int *index = x->index + i * x->taps;
+        const int16_t *weight = x->weight + i * x->taps;
+        int sum[4] = { 0, 0, 0, 0 };
+        for (int j = 0; j < x->taps; j++) {
+            const uint8_t *p = src + index[j] * 4;
+            for (int c = 0; c < 4; c++) sum[c] += weight[j] * p[c];
+        }
+        for (int c = 0; c < 4; c++) dst[c] = round_clamp(sum[c]);
+    }
+}
+
+SF_SCALAR static void vscale_c(uint8_t *dst, const uint8_t *const *rows,
+        const int16_t *weight, int taps, int width)
+{
+    for (int i = 0; i < width * 4; i++) {
+        int sum = 0;
+        for (int k = 0; k < taps; k++) sum += weight[k] * rows[k][i];
+        dst[i] = round_clamp(sum);
+    }
+}
+
+const struct sf_kernels sf_scalar = {
+    "scalar", hscale_c, vscale_c,
+};
+
+#ifdef __SSE2__
+
+// pairs of taps: the channels of two pixels interleaved in 16 bit lanes
+// go through pmaddwd against (w0, w1) pairs
+static inline __m128i weight_pair(const int16_t *w)
+{
+    return _mm_set1_epi32((int)((uint32_t)(uint16_t)w[1] << 16 | (uint16_t)w[0]));
+}
+
+static inline __m128i round_shift(__m128i sum)
+{
+    return _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(1 << (SF_SHIFT - 1))), SF_SHIFT);
+}
+
+static void hscale_sse2(uint8_t *dst, const uint8_t *src, const struct sf_axis *x)
+{
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < x->len; i++, dst += 4) {
+        const int *index = x->index + i * x->taps;
+        const int16_t *weight = x->weight + i * x->taps;
+        __m128i sum = zero;
+        for (int j = 0; j < x->taps; j += 2) {
+            int32_t p0, p1;
+            memcpy(&p0, src + index[j] * 4, 4);
+            memcpy(&p1, src + index[j + 1] * 4, 4);
+            __m128i px = _mm_unpacklo_epi8(_mm_cvtsi32_si128(p0), _mm_cvtsi32_si128(p1));
+            px = _mm_unpacklo_epi8(px, zero);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(px, weight_pair(weight + j)));
+        }
+        __m128i v = round_shift(sum);
+        v = _mm_packus_epi16(_mm_packs_epi32(v, v), zero);
+        int32_t out = _mm_cvtsi128_si32(v);
+        memcpy(dst, &out, 4);
+    }
+}
+
+static void vscale_sse2(uint8_t *dst, const uint8_t *const *rows,
+        const int16_t *weight, int taps, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int bytes = width * 4, i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i s0 = zero, s1 = zero, s2 = zero, s3 = zero;
+        for (int k = 0; k < taps; k += 2) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(rows[k] + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(rows[k + 1] + i));
+            __m128i w = weight_pair(weight + k);
+            __m128i lo = _mm_unpacklo_epi8(a, b), hi = _mm_unpackhi_epi8(a, b);
+            s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+            s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+            s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+            s3 = _mm_add_epi32(s3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+        }
+        __m128i lo = _mm_packs_epi32(round_shift(s0), round_shift(s1));
+        __m128i hi = _mm_packs_epi32(round_shift(s2), round_shift(s3));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    for (; i < bytes; i++) {
+        int sum = 0;
+        for (int k = 0; k < taps; k++) sum += weight[k] * rows[k][i];
+        dst[i] = round_clamp(sum);
+    }
+}
+
+const struct sf_kernels sf_simd = {
+    "sse2", hscale_sse2, vscale_sse2,
+};
+
+#else
+
+const struct sf_kernels sf_simd = {
+    "scalar", hscale_c, vscale_c,
+};
+
+#endif
+
+int sf_scaler_init(struct sf_scaler *s, enum sf_filter f, int src_w, int src_h,
+        int dst_w, int dst_h)
+{
+    memset(s, 0, sizeof *s);
+    s->src_w = src_w;
+    s->src_h = src_h;
+    s->dst_w = dst_w;
+    s->dst_h = dst_h;
+    if (axis_init(&s->x, f, src_w, dst_w) || axis_init(&s->y, f, src_h, dst_h)) {
+        sf_scaler_release(s);
+        return -1;
+    }
+    s->tmp = malloc((size_t)dst_w * src_h * 4);
+    s->rows = malloc(sizeof(*s->rows) * s->y.taps);
+    if (!s->tmp || !s->rows) {
+        sf_scaler_release(s);
+        return -1;
+    }
+    return 0;
+}
+
+void sf_scaler_run(struct sf_scaler *s, const struct sf_kernels *k, uint8_t *dst,
+        const uint8_t *src)
+{
+    size_t src_stride = (size_t)s->src_w * 4, stride = (size_t)s->dst_w * 4;
+    for (int y = 0; y < s->src_h; y++)
+        k->hscale(s->tmp + y * stride, src + y * src_stride, &s->x);
+
+    for (int y = 0; y < s->dst_h; y++) {
+        const int *index = s->y.index + y * s->y.taps;
+        for (int j = 0; j < s->y.taps; j++) s->rows[j] = s->tmp + index[j] * stride;
+        k->vscale(dst + y * stride, s->rows, s->y.weight + y * s->y.taps, s->y.taps,
+                s->dst_w);
+    }
+}
+
+void sf_scaler_release(struct sf_scaler *s)
+{
+    axis_release(&s->x);
+    axis_release(&s->y);
+    free(s->tmp);
+    free(s->rows);
+    s->tmp = NULL;
+    s->rows = NULL;
+}
+
+const char *sf_validate(const struct sf_kernels *k)
+{
+    // odd sizes for the vector tails, up and down by uneven ratios
+    static const int sizes[][4] = {
+        { 37, 23, 61, 41 }, { 61, 41, 19, 13 }, { 5, 3, 97, 7 }, { 130, 9, 33, 21 },
+    };
+    const char *failed = NULL;
+    uint32_t seed = 1;
+
+    for (int f = 0; !failed && f < SF_FILTERS; f++) {
+        for (size_t i = 0; !failed && i < sizeof sizes / sizeof sizes[0]; i++) {
+            const int *sz = sizes[i];
+            size_t src_len = (size_t)sz[0] * sz[1] * 4, dst_len = (size_t)sz[2] * sz[3] * 4;
+            uint8_t *src = malloc(src_len), *a = malloc(dst_len), *b = malloc(dst_len);
+            struct sf_scaler s;
+            if (!src || !a || !b || sf_scaler_init(&s, f, sz[0], sz[1], sz[2], sz[3])) {
+                failed = "out of memory";
+            } else {
+                for (size_t j = 0; j < src_len; j++) {
+                    seed = seed * 1103515245u + 12345u;
+                    src[j] = seed >> 16;
+                }
+                sf_scaler_run(&s, &sf_scalar, b, src);
+                sf_scaler_run(&s, k, a, src);
+                if (memcmp(a, b, dst_len)) failed = sf_filter_name(f);
+                sf_scaler_release(&s);
+            }
+            free(src);
+            free(a);
+            free(b);
+        }
+    }
+    return failed;
+}
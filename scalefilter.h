@@ -0,0 +1,78 @@
+#ifndef _SCALE_FILTER_H
+#define _SCALE_FILTER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * separable cpu scaler for RGBA8 frames, the reference the gpu scaling
+ * shaders are checked against and the software baseline they are timed
+ * against. horizontal pass first into an 8 bit intermediate, then the
+ * vertical pass, like the two pass shaders. weights are 14 bit fixed
+ * point, so the scalar and vectorized kernels must match bit exact.
+ */
+enum sf_filter { SF_BILINEAR, SF_BICUBIC, SF_LANCZOS, SF_FILTERS };
+
+const char *sf_filter_name(enum sf_filter f);
+/* kernel support in source pixels at 1:1: 1, 2 (catmull-rom) and 3 */
+int sf_filter_radius(enum sf_filter f);
+/* kernel value at distance x */
+double sf_filter_weight(enum sf_filter f, double x);
+/* how far the kernel is stretched: bilinear never (as GL_LINEAR), the
+ * others by the downscale ratio so that they do not alias */
+double sf_filter_stretch(enum sf_filter f, int src_len, int dst_len);
+/* taps per destination pixel along one axis, always even */
+int sf_filter_taps(enum sf_filter f, int src_len, int dst_len);
+
+#define SF_SHIFT 14
+
+/* clamped source indices and weights (summing to 1 << SF_SHIFT) of every
+ * destination pixel along one axis, taps entries per pixel */
+struct sf_axis {
+    int len, taps;
+    int *index;
+    int16_t *weight;
+};
+
+struct sf_kernels {
+    const char *name;
+    /* one row of RGBA8 pixels, x->len wide afterwards */
+    void (*hscale)(uint8_t *dst, const uint8_t *src, const struct sf_axis *x);
+    /* one destination row of width pixels from taps source rows */
+    void (*vscale)(uint8_t *dst, const uint8_t *const *rows, const int16_t *weight,
+            int taps, int width);
+};
+
+/* plain c, the reference */
+extern const struct sf_kernels sf_scalar;
+/* the vectorized set of this build (sse2), sf_scalar without one */
+extern const struct sf_kernels sf_simd;
+
+struct sf_scaler {
+    int src_w, src_h, dst_w, dst_h;
+    struct sf_axis x, y;
+    uint8_t *tmp;
+    const uint8_t **rows;
+};
+
+/* returns 0, or -1 when out of memory */
+int sf_scaler_init(struct sf_scaler *s, enum sf_filter f, int src_w, int src_h,
+        int dst_w, int dst_h);
+/* tightly packed RGBA8, src_w x src_h to dst_w x dst_h */
+void sf_scaler_run(struct sf_scaler *s, const struct sf_kernels *k, uint8_t *dst,
+        const uint8_t *src);
+void sf_scaler_release(struct sf_scaler *s);
+
+/* scales odd sized random frames up and down with every filter through k
+ * and sf_scalar. returns NULL when all match, else the name of the first
+ * filter that differs */
+const char *sf_validate(const struct sf_kernels *k);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,340 @@
+/**
+ * runs the benchmark cases registered with VIDEO_BENCH (see
+ * benchharness.h) through one harness: warmup, batches sized to a minimum
+ * sample time, a fixed number of samples, median/MAD statistics with
+ * outliers counted instead of averaged in, and optional pinning to one
+ * cpu. the cpufreq governors are reported with the results since anything
+ * but "performance" moves the numbers between runs. results go to stdout
+ * and optionally to JSON and CSV files and the result store.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/utsname.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "benchutil.h"
+#include "benchharness.h"
+#include "benchresult.h"
+
+#define err_msg(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+} while (0)
+
+#define err_quit(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+    exit(1); \
+} while (0)
+
+using namespace std;
+
+static struct {
+    double warmup_ms;
+    double min_sample_ms;
+    int repetitions;
+    int cpu;
+    const char* json_path;
+    const char* csv_path;
+    bool list;
+} opts = {
+    200, 20, 20, -1, NULL, NULL, false,
+};
+
+struct SystemInfo {
+    string cpu_model;
+    string kernel;
+    string governors;
+    bool stable_clock {true};
+};
+
+struct Result {
+    string name;
+    string skipped;
+    bool failed {false};
+    size_t samples {0};
+    int64_t batch {0};
+    double median, mad, mean, min, max, p95;
+    int outliers {0};
+    double items_per_s {0};
+    const char* item_unit {""};
+};
+
+static string read_line(const string& path)
+{
+    char buf[256] = "";
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return "";
+    if (!fgets(buf, sizeof buf, f)) buf[0] = 0;
+    fclose(f);
+    buf[strcspn(buf, "\n")] = 0;
+    return buf;
+}
+
+static SystemInfo system_info()
+{
+    SystemInfo si;
+    FILE* f = fopen("/proc/cpuinfo", "r");
+    char line[512];
+    while (f && fgets(line, sizeof line, f)) {
+        char* colon = strchr(line, ':');
+        if (!strncmp(line, "model name", 10) && colon) {
+            si.cpu_model = colon + 2;
+            si.cpu_model.erase(si.cpu_model.find_last_not_of("\n ") + 1);
+            break;
+        }
+    }
+    if (f) fclose(f);
+
+    struct utsname uts;
+    if (!uname(&uts)) si.kernel = uts.release;
+
+    // governors of the cpus we may run on, counted
+    cpu_set_t set;
+    sched_getaffinity(0, sizeof set, &set);
+    map<string, int> governors;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &set)) continue;
+        string gov = read_line("/sys/devices/system/cpu/cpu" + to_string(cpu) +
+                "/cpufreq/scaling_governor");
+        governors[gov.empty() ? "none" : gov]++;
+    }
+    for (auto& g: governors) {
+        if (!si.governors.empty()) si.governors += ", ";
+        si.governors += g.first + " x" + to_string(g.second);
+        // no cpufreq (vms, containers) is as stable as we can tell
+        if (g.first != "performance" && g.first != "none") si.stable_clock = false;
+    }
+    return si;
+}
+
+static Result summarize(const BenchCase& c, const BenchState& state)
+{
+    Result r;
+    r.name = c.name;
+    if (state.skipped() || state.samples_ns().empty()) {
+        r.skipped = state.skipped() ? state.skip_reason() : "no samples";
+        r.failed = state.failed();
+        return r;
+    }
+
+    vector<double> s = state.samples_ns();
+    struct bench_stats st;
+    bench_stats_compute(s.data(), s.size(), &st);
+    r.samples = st.n;
+    r.batch = state.batch();
+    r.median = st.median;
+    r.mean = st.mean;
+    r.min = st.min;
+    r.max = st.max;
+    r.p95 = st.p95;
+
+    // tukey fences, a preempted sample should not drag the result
+    double q1 = bench_quantile(s.data(), s.size(), 0.25);
+    double q3 = bench_quantile(s.data(), s.size(), 0.75);
+    for (double v: s) {
+        if (v < q1 - 1.5 * (q3 - q1) || v > q3 + 1.5 * (q3 - q1)) r.outliers++;
+    }
+
+    vector<double> dev;
+    for (double v: s) dev.push_back(fabs(v - st.median));
+    struct bench_stats dst;
+    bench_stats_compute(dev.data(), dev.size(), &dst);
+    r.mad = dst.median;
+
+    if (state.items() > 0 && r.median > 0) {
+        r.items_per_s = state.items() / (r.median / 1e9);
+        r.item_unit = state.item_unit();
+    }
+    return r;
+}
+
+static string si_rate(double v, const char* unit)
+{
+    const char* prefix[] = { "", "k", "M", "G", "T" };
+    int i = 0;
+    for (; v >= 1000.0 && i < 4; i++) v /= 1000.0;
+    char buf[64];
+    snprintf(buf, sizeof buf, "%.2f %s%s/s", v, prefix[i], unit);
+    return buf;
+}
+
+static string si_time(double ns)
+{
+    char buf[32];
+    if (ns < 1e3) snprintf(buf, sizeof buf, "%.1f ns", ns);
+    else if (ns < 1e6) snprintf(buf, sizeof buf, "%.2f us", ns / 1e3);
+    else snprintf(buf, sizeof buf, "%.2f ms", ns / 1e6);
+    return buf;
+}
+
+static void print_result(const Result& r)
+{
+    if (!r.skipped.empty()) {
+        printf("%-28s %s: %s\n", r.name.c_str(), r.failed ? "FAILED" : "skipped",
+                r.skipped.c_str());
+        return;
+    }
+    printf("%-28s %12s +-%5.1f%%  min %12s  p95 %12s  %2d outliers  %3zux%-8lld %s\n",
+            r.name.c_str(), si_time(r.median).c_str(),
+            r.median > 0 ? 100.0 * r.mad / r.median : 0.0, si_time(r.min).c_str(),
+            si_time(r.p95).c_str(), r.outliers, r.samples, (long long)r.batch,
+            r.items_per_s > 0 ? si_rate(r.items_per_s, r.item_unit).c_str() : "");
+}
+
+static string json_string(const string& s)
+{
+    string out = "\"";
+    for (char c: s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if ((unsigned char)c < 0x20) continue;
+        out += c;
+    }
+    return out + "\"";
+}
+
+static int write_json(const char* path, const SystemInfo& si, const vector<Result>& results)
+{
+    FILE* f = fopen(path, "w");
+    if (!f) return 1;
+    fprintf(f, "{\n  \"context\": {\n");
+    fprintf(f, "    \"date\": %ld,\n", (long)time(NULL));
+    fprintf(f, "    \"kernel\": %s,\n", json_string(si.kernel).c_str());
+    fprintf(f, "    \"cpu\": %s,\n", json_string(si.cpu_model).c_str());
+    fprintf(f, "    \"governors\": %s,\n", json_string(si.governors).c_str());
+    fprintf(f, "    \"pinned_cpu\": %d,\n", opts.cpu);
+    fprintf(f, "    \"warmup_ms\": %g,\n", opts.warmup_ms);
+    fprintf(f, "    \"min_sample_ms\": %g,\n", opts.min_sample_ms);
+    fprintf(f, "    \"repetitions\": %d\n  },\n", opts.repetitions);
+    fprintf(f, "  \"benchmarks\": [");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        fprintf(f, "%s\n    {\"name\": %s, ", i ? "," : "", json_string(r.name).c_str());
+        if (!r.skipped.empty()) {
+            fprintf(f, "\"%s\": %s}", r.failed ? "failed" : "skipped",
+                    json_string(r.skipped).c_str());
+            continue;
+        }
+        fprintf(f, "\"samples\": %zu, \"batch\": %lld, \"median_ns\": %.6g, "
+                "\"mad_ns\": %.6g, \"mean_ns\": %.6g, \"min_ns\": %.6g, \"max_ns\": %.6g, "
+                "\"p95_ns\": %.6g, \"outliers\": %d", r.samples, (long long)r.batch,
+                r.median, r.mad, r.mean, r.min, r.max, r.p95, r.outliers);
+        if (r.items_per_s > 0)
+            fprintf(f, ", \"items_per_second\": %.6g, \"item_unit\": %s", r.items_per_s,
+                    json_string(r.item_unit).c_str());
+        fprintf(f, "}");
+    }
+    fprintf(f, "\n  ]\n}\n");
+    return fclose(f) != 0;
+}
+
+static int write_csv(const char* path, const vector<Result>& results)
+{
+    FILE* f = fopen(path, "w");
+    if (!f) return 1;
+    fprintf(f, "name,samples,batch,median_ns,mad_ns,mean_ns,min_ns,max_ns,p95_ns,"
+            "outliers,items_per_second,item_unit,skipped\n");
+    for (auto& r: results) {
+        if (!r.skipped.empty()) {
+            fprintf(f, "%s,,,,,,,,,,,,\"%s%s\"\n", r.name.c_str(),
+                    r.failed ? "failed: " : "", r.skipped.c_str());
+            continue;
+        }
+        fprintf(f, "%s,%zu,%lld,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%d,%.6g,%s,\n",
+                r.name.c_str(), r.samples, (long long)r.batch, r.median, r.mad, r.mean,
+                r.min, r.max, r.p95, r.outliers, r.items_per_s, r.item_unit);
+    }
+    return fclose(f) != 0;
+}
+
+static bool selected(const string& name, int argc, char* argv[])
+{
+    if (optind >= argc) return true;
+    for (int i = optind; i < argc; i++) {
+        if (name.find(argv[i]) != string::npos) return true;
+    }
+    return false;
+}
+
+static void usage(const char* prog)
+{
+    err_quit("usage: %s [-l] [-w warmup_ms] [-t min_sample_ms] [-r repetitions] "
+            "[-c cpu] [-j out.json] [-C out.csv] [filter...]\n"
+            "runs the registered cases whose name contains any filter\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    int c;
+    while ((c = getopt(argc, argv, "lw:t:r:c:j:C:")) != -1) {
+        switch (c) {
+            case 'l': opts.list = true; break;
+            case 'w': opts.warmup_ms = atof(optarg); break;
+            case 't': opts.min_sample_ms = atof(optarg); break;
+            case 'r': opts.repetitions = atoi(optarg); break;
+            case 'c': opts.cpu = atoi(optarg); break;
+            case 'j': opts.json_path = optarg; break;
+            case 'C': opts.csv_path = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (opts.repetitions <= 0 || opts.warmup_ms < 0 || opts.min_sample_ms <= 0)
+        usage(argv[0]);
+
+    if (opts.list) {
+        for (auto& bc: bench_cases()) {
+            if (selected(bc.name, argc, argv)) printf("%s\n", bc.name.c_str());
+        }
+        return 0;
+    }
+
+    if (opts.cpu >= 0) {
+        // threads started later (gl drivers) inherit the mask
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(opts.cpu, &set);
+        if (sched_setaffinity(0, sizeof set, &set))
+            err_quit("cannot pin to cpu %d\n", opts.cpu);
+    }
+
+    SystemInfo si = system_info();
+    printf("cpu: %s, kernel %s, governors: %s%s\n", si.cpu_model.c_str(),
+            si.kernel.c_str(), si.governors.c_str(),
+            si.stable_clock ? "" : " (not performance, expect drift)");
+    printf("warmup %g ms, %d samples of >= %g ms, %s\n", opts.warmup_ms,
+            opts.repetitions, opts.min_sample_ms,
+            opts.cpu >= 0 ? ("pinned to cpu " + to_string(opts.cpu)).c_str() : "not pinned");
+
+    vector<Result> results;
+    int ret = 0;
+    for (auto& bc: bench_cases()) {
+        if (!selected(bc.name, argc, argv)) continue;
+        BenchState state(bc.arg, opts.warmup_ms, opts.min_sample_ms, opts.repetitions);
+        bc.fn(state);
+
+        Result r = summarize(bc, state);
+        print_result(r);
+        fflush(stdout);
+        if (r.failed) ret = 1;
+        if (r.skipped.empty())
+            bench_result_record("video_bench", bc.name.c_str(), "ns", 1,
+                    state.samples_ns().data(), state.samples_ns().size());
+        results.push_back(r);
+    }
+
+    if (opts.json_path && write_json(opts.json_path, si, results)) {
+        err_msg("cannot write %s\n", opts.json_path);
+        ret = 1;
+    }
+    if (opts.csv_path && write_csv(opts.csv_path, results)) {
+        err_msg("cannot write %s\n", opts.csv_path);
+        ret = 1;
+    }
+    return ret;
+}
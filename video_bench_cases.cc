@@ -0,0 +1,81 @@
+// basic cases of video_bench: the cost of the clock itself, plain frame
+// copies as the memory bandwidth reference, and the fixed per-frame cost
+// of the headless gl path. the argument is the frame height of a 16:9 frame.
+
+#include <string.h>
+#include <vector>
+
+#include "glutil.h"
+#include "eglutil.h"
+#include "benchutil.h"
+#include "benchharness.h"
+
+using namespace std;
+
+static size_t frame_width(int64_t height)
+{
+    return (size_t)height * 16 / 9;
+}
+
+static void clock_read(BenchState& state)
+{
+    while (state.keep_running()) {
+        uint64_t t = bench_now_ns();
+        bench_keep(&t);
+    }
+}
+VIDEO_BENCH(clock_read);
+
+static void frame_copy(BenchState& state)
+{
+    size_t size = frame_width(state.arg()) * state.arg() * 4;
+    vector<char> src(size, 1), dst(size, 0);
+    state.set_items(size, "B");
+    while (state.keep_running()) {
+        memcpy(dst.data(), src.data(), size);
+        bench_keep(dst.data());
+    }
+}
+VIDEO_BENCH(frame_copy, 720, 1080, 2160);
+
+static void gl_clear(BenchState& state)
+{
+    int w = frame_width(state.arg()), h = state.arg();
+    EGLOffscreen egl;
+    if (!egl.create(w, h)) {
+        state.skip("no EGL context");
+        return;
+    }
+    state.set_items((double)w * h, "px");
+    glClearColor(0.1f, 0.2f, 0.3f, 1.0f);
+    while (state.keep_running()) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        glFinish();
+    }
+}
+VIDEO_BENCH(gl_clear, 720, 1080, 2160);
+
+static void gl_upload(BenchState& state)
+{
+    int w = frame_width(state.arg()), h = state.arg();
+    EGLOffscreen egl;
+    if (!egl.create(16, 16)) {
+        state.skip("no EGL context");
+        return;
+    }
+    vector<GLubyte> pixels((size_t)w * h * 4, 0x80);
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+    state.set_items(pixels.size(), "B");
+    while (state.keep_running()) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE,
+                pixels.data());
+        glFinish();
+    }
+    glDeleteTextures(1, &tex);
+}
+VIDEO_BENCH(gl_upload, 720, 1080, 2160);
@@ -0,0 +1,356 @@
+// EGL config cases of video_bench: the render cost of colour depth,
+// depth/stencil size and multisampling. each eglconfig_<layout> case
+// renders the same workload into a 1280x720 pbuffer of exactly that
+// layout, the argument is the sample count; layouts or sample counts the
+// display does not offer are skipped. the eglconfig_fbo_* cases split
+// msaa on a GLES3 context into rendering into a 0/2/4/8x renderbuffer and
+// resolving it with glBlitFramebuffer, which is what a pbuffer or window
+// surface does behind the swap where it cannot be timed.
+//
+// the workload is layers of thin overlapping triangles, depth tested when
+// the target has depth, so there are edges everywhere for msaa to work on.
+
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include <GLES3/gl3.h>
+#include "glutil.h"
+#include "eglutil.h"
+#include "benchharness.h"
+
+using namespace std;
+
+static const int width = 1280, height = 720;
+static const int layers = 16;
+// triangles per layer, a star of thin wedges
+#define WEDGES 96
+
+static const char* vert_shader = R"(
+attribute vec3 position;
+uniform float depth;
+uniform float angle;
+varying float shade;
+
+void main() {
+    float c = cos(angle), s = sin(angle);
+    shade = position.z;
+    gl_Position = vec4(mat2(c, s, -s, c) * position.xy, depth, 1.0);
+}
+)";
+static const char* frag_shader = R"(
+precision mediump float;
+uniform vec4 color;
+varying float shade;
+void main() {
+    gl_FragColor = color * (0.5 + 0.5 * shade);
+}
+)";
+
+struct Layout {
+    const char *name;
+    EGLint red, green, blue, alpha;
+    EGLint depth, stencil;
+};
+
+static const Layout layouts[] = {
+    { "eglconfig_rgba8888", 8, 8, 8, 8, 0, 0 },
+    { "eglconfig_rgba8888_d24s8", 8, 8, 8, 8, 24, 8 },
+    { "eglconfig_rgb888_d24s8", 8, 8, 8, 0, 24, 8 },
+    { "eglconfig_rgb565", 5, 6, 5, 0, 0, 0 },
+    { "eglconfig_rgb565_d16", 5, 6, 5, 0, 16, 0 },
+    { "eglconfig_rgba1010102", 10, 10, 10, 2, 0, 0 },
+};
+
+struct Workload {
+    GLProgram prog;
+    GLBuffer vertices {GL_ARRAY_BUFFER};
+    GLint depth_loc, angle_loc, color_loc;
+};
+
+static bool setup_workload(Workload& w)
+{
+    w.prog = GLProgram(vert_shader, frag_shader);
+    if (!w.prog.valid()) return false;
+    w.depth_loc = w.prog.uniform("depth");
+    w.angle_loc = w.prog.uniform("angle");
+    w.color_loc = w.prog.uniform("color");
+
+    // every wedge fills 60% of its slice, the rest stays empty
+    vector<GLfloat> v;
+    for (int i = 0; i < WEDGES; i++) {
+        float a = 2.0f * (float)M_PI * i / WEDGES;
+        float b = a + 2.0f * (float)M_PI / WEDGES * 0.6f;
+        GLfloat tri[] = {
+            0.0f, 0.0f, 1.0f,
+            1.5f * cosf(a), 1.5f * sinf(a), 0.0f,
+            1.5f * cosf(b), 1.5f * sinf(b), 0.5f,
+        };
+        v.insert(v.end(), tri, tri + 9);
+    }
+    w.vertices.data(v.size() * sizeof(GLfloat), v.data(), GL_STATIC_DRAW);
+    return true;
+}
+
+static void draw_workload(Workload& w, bool depth_test)
+{
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    if (depth_test) glEnable(GL_DEPTH_TEST);
+    else glDisable(GL_DEPTH_TEST);
+
+    w.prog.use();
+    w.vertices.bind();
+    GLint pos = w.prog.attrib("position");
+    glEnableVertexAttribArray(pos);
+    glVertexAttribPointer(pos, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+
+    // every layer is turned a little and closer than the last, so it passes
+    // the depth test and its edges cross the ones below
+    for (int l = 0; l < layers; l++) {
+        float t = (float)l / layers;
+        glUniform1f(w.depth_loc, 0.9f - 1.8f * t);
+        glUniform1f(w.angle_loc, 0.37f * l);
+        glUniform4f(w.color_loc, t, 1.0f - t, l & 1 ? 1.0f : 0.3f, 1.0f);
+        glDrawArrays(GL_TRIANGLES, 0, WEDGES * 3);
+    }
+}
+
+// eglChooseConfig takes the sizes as minimums, only an exact match will do
+static EGLConfig exact_config(EGLDisplay display, const Layout& l, EGLint samples)
+{
+    const EGLint conf_att[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_RED_SIZE, l.red,
+        EGL_GREEN_SIZE, l.green,
+        EGL_BLUE_SIZE, l.blue,
+        EGL_ALPHA_SIZE, l.alpha,
+        EGL_DEPTH_SIZE, l.depth,
+        EGL_STENCIL_SIZE, l.stencil,
+        EGL_SAMPLES, samples,
+        EGL_NONE,
+    };
+    EGLint n = 0;
+    eglChooseConfig(display, conf_att, NULL, 0, &n);
+    vector<EGLConfig> configs(n);
+    if (n) eglChooseConfig(display, conf_att, configs.data(), n, &n);
+
+    for (EGLint i = 0; i < n; i++) {
+        bool match = true;
+        // the attribute/value pairs after the surface and renderable type
+        for (int k = 4; conf_att[k] != EGL_NONE; k += 2) {
+            EGLint v = -1;
+            eglGetConfigAttrib(display, configs[i], conf_att[k], &v);
+            match = match && v == conf_att[k + 1];
+        }
+        if (match) return configs[i];
+    }
+    return nullptr;
+}
+
+/**
+ * a context and pbuffer of one config on its own headless display, GLES3
+ * where the config allows it so the fbo cases can use it
+ */
+class ConfigTarget {
+public:
+    ConfigTarget() = default;
+    ~ConfigTarget()
+    {
+        if (_display == EGL_NO_DISPLAY) return;
+        eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (_surface != EGL_NO_SURFACE) eglDestroySurface(_display, _surface);
+        if (_context != EGL_NO_CONTEXT) eglDestroyContext(_display, _context);
+        eglTerminate(_display);
+    }
+
+    ConfigTarget(const ConfigTarget&) = delete;
+    ConfigTarget& operator=(const ConfigTarget&) = delete;
+
+    // returns why it cannot be created, empty on success
+    string create(const Layout& l, EGLint samples, int w, int h)
+    {
+        _display = egl_open_headless_display();
+        if (_display == EGL_NO_DISPLAY || !eglBindAPI(EGL_OPENGL_ES_API))
+            return "no EGL display";
+        EGLConfig config = exact_config(_display, l, samples);
+        if (!config) return "no such config";
+
+        for (_version = 3; _version >= 2; _version--) {
+            const EGLint ctx_att[] = {
+                EGL_CONTEXT_CLIENT_VERSION, _version,
+                EGL_NONE
+            };
+            _context = eglCreateContext(_display, config, EGL_NO_CONTEXT, ctx_att);
+            if (_context != EGL_NO_CONTEXT) break;
+        }
+        if (_context == EGL_NO_CONTEXT) return "no context";
+
+        const EGLint pb_att[] = { EGL_WIDTH, w, EGL_HEIGHT, h, EGL_NONE };
+        _surface = eglCreatePbufferSurface(_display, config, pb_att);
+        if (_surface == EGL_NO_SURFACE ||
+                !eglMakeCurrent(_display, _surface, _surface, _context))
+            return "no " + to_string(w) + "x" + to_string(h) + " pbuffer";
+        return "";
+    }
+
+    int version() const { return _version; }
+
+private:
+    EGLDisplay _display {EGL_NO_DISPLAY};
+    EGLContext _context {EGL_NO_CONTEXT};
+    EGLSurface _surface {EGL_NO_SURFACE};
+    int _version {0};
+};
+
+template <int L>
+static void eglconfig(BenchState& state)
+{
+    const Layout& l = layouts[L];
+    ConfigTarget target;
+    string reason = target.create(l, state.arg(), width, height);
+    if (!reason.empty()) {
+        state.skip(reason);
+        return;
+    }
+
+    Workload w;
+    if (!setup_workload(w)) {
+        state.skip("shaders failed");
+        return;
+    }
+    glViewport(0, 0, width, height);
+    state.set_items(1, "frame");
+    while (state.keep_running()) {
+        draw_workload(w, l.depth > 0);
+        glFinish();
+    }
+}
+
+/**
+ * msaa through fbos: render into a multisampled colour+depth pair, then
+ * resolve into a single sampled texture. 0x renders into the texture
+ * directly.
+ */
+struct MsaaTarget {
+    GLuint fbo {0}, color {0}, depth {0};
+    GLuint resolve_fbo {0}, resolve_tex {0};
+};
+
+static bool create_msaa_target(MsaaTarget& t, int samples)
+{
+    glGenTextures(1, &t.resolve_tex);
+    glBindTexture(GL_TEXTURE_2D, t.resolve_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+            GL_UNSIGNED_BYTE, NULL);
+    glGenFramebuffers(1, &t.resolve_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, t.resolve_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+            t.resolve_tex, 0);
+
+    glGenRenderbuffers(1, &t.depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, t.depth);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8,
+            width, height);
+
+    if (samples == 0) {
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                GL_RENDERBUFFER, t.depth);
+        t.fbo = t.resolve_fbo;
+    } else {
+        glGenRenderbuffers(1, &t.color);
+        glBindRenderbuffer(GL_RENDERBUFFER, t.color);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width,
+                height);
+        glGenFramebuffers(1, &t.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, t.fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+                t.color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                GL_RENDERBUFFER, t.depth);
+    }
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+static void release_msaa_target(MsaaTarget& t)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (t.fbo != t.resolve_fbo) glDeleteFramebuffers(1, &t.fbo);
+    glDeleteFramebuffers(1, &t.resolve_fbo);
+    glDeleteRenderbuffers(1, &t.color);
+    glDeleteRenderbuffers(1, &t.depth);
+    glDeleteTextures(1, &t.resolve_tex);
+    t = MsaaTarget();
+}
+
+// Resolve: time only the resolve, the render before it is paused
+template <int Resolve>
+static void eglconfig_fbo(BenchState& state)
+{
+    int samples = state.arg();
+    // any single sampled rgba8888 config will do, the targets are fbos
+    ConfigTarget target;
+    string reason = target.create(layouts[0], 0, 16, 16);
+    if (!reason.empty()) {
+        state.skip(reason);
+        return;
+    }
+    if (target.version() < 3) {
+        state.skip("no GLES3 context");
+        return;
+    }
+    GLint max_samples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+    if (samples > max_samples) {
+        state.skip("GL_MAX_SAMPLES " + to_string(max_samples));
+        return;
+    }
+
+    Workload w;
+    MsaaTarget t;
+    if (!setup_workload(w)) {
+        state.skip("shaders failed");
+    } else if (!create_msaa_target(t, samples)) {
+        state.skip("framebuffer incomplete");
+    } else {
+        static const GLenum discard[] = { GL_COLOR_ATTACHMENT0, GL_DEPTH_STENCIL_ATTACHMENT };
+        glViewport(0, 0, width, height);
+        state.set_items(1, "frame");
+        while (state.keep_running()) {
+            if (Resolve) state.pause_timing();
+            glBindFramebuffer(GL_FRAMEBUFFER, t.fbo);
+            draw_workload(w, true);
+            glFinish();
+            if (Resolve) state.resume_timing();
+            if (!samples) continue;
+
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, t.fbo);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, t.resolve_fbo);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                    GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            // the samples are dead after the resolve, tilers skip the store
+            glInvalidateFramebuffer(GL_READ_FRAMEBUFFER, 2, discard);
+            glFinish();
+        }
+    }
+    release_msaa_target(t);
+}
+
+static int register_eglconfig_cases()
+{
+    static const BenchFunction fns[] = {
+        eglconfig<0>, eglconfig<1>, eglconfig<2>, eglconfig<3>, eglconfig<4>,
+        eglconfig<5>,
+    };
+    static_assert(sizeof fns / sizeof fns[0] == sizeof layouts / sizeof layouts[0],
+            "one case per layout");
+    for (size_t i = 0; i < sizeof layouts / sizeof layouts[0]; i++)
+        bench_register(layouts[i].name, fns[i], { 0, 2, 4, 8 });
+
+    // render plus resolve, and the resolve alone
+    bench_register("eglconfig_fbo", eglconfig_fbo<0>, { 0, 2, 4, 8 });
+    bench_register("eglconfig_fbo_resolve", eglconfig_fbo<1>, { 2, 4, 8 });
+    return 0;
+}
+static int eglconfig_registered = register_eglconfig_cases();
@@ -0,0 +1,359 @@
+// video scaling cases of video_bench: bilinear, separable bicubic
+// (catmull-rom) and lanczos3 as one pass and as a horizontal then a
+// vertical pass on the gpu, checked against and compared with the cpu
+// scaler of scalefilter.c. the argument is the source height of a 16:9
+// frame: 720 and 1080 scale up to 1080 and 2160, 2160 down to 1080.
+
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "glutil.h"
+#include "eglutil.h"
+#include "benchharness.h"
+#include "scalefilter.h"
+
+using namespace std;
+
+// largest per channel difference a gpu frame may have from the cpu one:
+// float against fixed point weights, and one pass shaders do not round
+// to 8 bits in between
+static const int max_difference = 3;
+
+static const char *vertex_src = R"(
+attribute vec2 pos;
+void main()
+{
+    gl_Position = vec4(pos, 0.0, 1.0);
+}
+)";
+
+static const char *kernel_src[] = {
+    // bilinear samples through GL_LINEAR, no kernel
+    "",
+    R"(
+float kernel(float x)
+{
+    x = abs(x);
+    if (x < 1.0) return (1.5 * x - 2.5) * x * x + 1.0;
+    if (x < 2.0) return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+    return 0.0;
+}
+)",
+    R"(
+float kernel(float x)
+{
+    const float pi = 3.14159265;
+    x = abs(x);
+    if (x < 1e-6) return 1.0;
+    if (x < 3.0) return 3.0 * sin(pi * x) * sin(pi * x / 3.0) / (pi * pi * x * x);
+    return 0.0;
+}
+)",
+};
+
+static const char *header_src = R"(
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
+precision mediump float;
+#endif
+uniform sampler2D tex;
+uniform vec2 src_size;
+// source pixels per destination pixel, and the kernel stretch
+uniform vec2 scale;
+uniform vec2 stretch;
+)";
+
+// gl_FragCoord is the destination pixel center, times scale the sample
+// position in source pixels. taps sit around it and clamp to the edge,
+// exactly as the cpu weight tables do.
+static const char *one_pass_src = R"(
+vec4 texel(vec2 i)
+{
+    return texture2D(tex, (clamp(i, vec2(0.0), src_size - 1.0) + 0.5) / src_size);
+}
+
+void main()
+{
+    vec2 c = gl_FragCoord.xy * scale;
+#ifdef BILINEAR
+    gl_FragColor = texture2D(tex, c / src_size);
+#else
+    vec2 first = floor(c - 0.5) - vec2(float(TAPS_X / 2), float(TAPS_Y / 2)) + 1.0;
+    float wx[TAPS_X];
+    float wsum_x = 0.0, wsum_y = 0.0;
+    for (int j = 0; j < TAPS_X; j++) {
+        wx[j] = kernel((first.x + float(j) + 0.5 - c.x) / stretch.x);
+        wsum_x += wx[j];
+    }
+    vec4 sum = vec4(0.0);
+    for (int k = 0; k < TAPS_Y; k++) {
+        float y = first.y + float(k);
+        float wy = kernel((y + 0.5 - c.y) / stretch.y);
+        vec4 row = vec4(0.0);
+        for (int j = 0; j < TAPS_X; j++) row += wx[j] * texel(vec2(first.x + float(j), y));
+        sum += wy * row;
+        wsum_y += wy;
+    }
+    gl_FragColor = sum / (wsum_x * wsum_y);
+#endif
+}
+)";
+
+// one axis, the other passes through at the pixel center
+static const char *one_axis_src = R"(
+uniform vec2 axis;
+
+void main()
+{
+    float c = dot(gl_FragCoord.xy, axis) * dot(scale, axis);
+    vec2 other = gl_FragCoord.xy * (1.0 - axis);
+#ifdef BILINEAR
+    gl_FragColor = texture2D(tex, (other + c * axis) / src_size);
+#else
+    float first = floor(c - 0.5) - float(TAPS / 2) + 1.0;
+    float len = dot(src_size, axis), s = dot(stretch, axis);
+    vec4 sum = vec4(0.0);
+    float wsum = 0.0;
+    for (int j = 0; j < TAPS; j++) {
+        float i = first + float(j);
+        float w = kernel((i + 0.5 - c) / s);
+        vec2 p = other + (clamp(i, 0.0, len - 1.0) + 0.5) * axis;
+        sum += w * texture2D(tex, p / src_size);
+        wsum += w;
+    }
+    gl_FragColor = sum / wsum;
+#endif
+}
+)";
+
+static void frame_size(int64_t src_h, int *sw, int *sh, int *dw, int *dh)
+{
+    *sh = src_h;
+    *dh = src_h == 720 ? 1080 : src_h == 1080 ? 2160 : 1080;
+    *sw = *sh * 16 / 9;
+    *dw = *dh * 16 / 9;
+}
+
+// smooth gradients under a moderate pattern, no edges hard enough to make
+// the negative lobes clip differently in one and two passes
+static vector<uint8_t> test_frame(int w, int h)
+{
+    vector<uint8_t> px((size_t)w * h * 4);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            uint8_t *p = &px[((size_t)y * w + x) * 4];
+            p[0] = x * 255 / w;
+            p[1] = y * 255 / h;
+            p[2] = 128 + (int)(90 * sin(x * 0.05) * cos(y * 0.07));
+            p[3] = 192 + (int)(60 * cos((x + y) * 0.03));
+        }
+    }
+    return px;
+}
+
+static GLuint make_texture(int w, int h, const void *pixels, GLenum filter)
+{
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return tex;
+}
+
+// one_axis: taps_x is the tap count along the pass's axis
+static GLProcess* scale_program(sf_filter f, bool one_axis, int taps_x, int taps_y)
+{
+    string defines;
+    if (f == SF_BILINEAR)
+        defines = "#define BILINEAR\n";
+    else if (one_axis)
+        defines = "#define TAPS " + to_string(taps_x) + "\n";
+    else
+        defines = "#define TAPS_X " + to_string(taps_x) + "\n#define TAPS_Y " +
+            to_string(taps_y) + "\n";
+    string frag = defines + header_src + kernel_src[f] +
+        (one_axis ? one_axis_src : one_pass_src);
+
+    GLProcess* proc = glprocess_create(vertex_src, frag.c_str(), true);
+    if (!proc) return nullptr;
+
+    static const GLfloat quad[] = { -1, -1, 1, -1, -1, 1, 1, 1 };
+    glGenBuffers(1, &proc->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, proc->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof quad, quad, GL_STATIC_DRAW);
+    return proc;
+}
+
+struct ScalePass {
+    GLProcess* proc;
+    GLuint src_tex;
+    int src_w, src_h, dst_w, dst_h;
+    GLuint fbo;
+    // one axis passes only
+    bool vertical;
+};
+
+static void draw_pass(sf_filter f, const ScalePass& p)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, p.fbo);
+    glViewport(0, 0, p.dst_w, p.dst_h);
+    glUseProgram(p.proc->program);
+    glBindTexture(GL_TEXTURE_2D, p.src_tex);
+    glUniform1i(glGetUniformLocation(p.proc->program, "tex"), 0);
+    glUniform2f(glGetUniformLocation(p.proc->program, "src_size"), p.src_w, p.src_h);
+    glUniform2f(glGetUniformLocation(p.proc->program, "scale"),
+            (float)p.src_w / p.dst_w, (float)p.src_h / p.dst_h);
+    glUniform2f(glGetUniformLocation(p.proc->program, "stretch"),
+            sf_filter_stretch(f, p.src_w, p.dst_w), sf_filter_stretch(f, p.src_h, p.dst_h));
+    glUniform2f(glGetUniformLocation(p.proc->program, "axis"), !p.vertical, p.vertical);
+
+    GLint pos = glGetAttribLocation(p.proc->program, "pos");
+    glBindBuffer(GL_ARRAY_BUFFER, p.proc->vbo);
+    glVertexAttribPointer(pos, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(pos);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+template <int F, int Passes>
+static void gpu_scale(BenchState& state)
+{
+    sf_filter f = (sf_filter)F;
+    int sw, sh, dw, dh;
+    frame_size(state.arg(), &sw, &sh, &dw, &dh);
+
+    EGLOffscreen egl;
+    if (!egl.create(16, 16)) {
+        state.skip("no EGL context");
+        return;
+    }
+    GLint max_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    if (max_size < sw || max_size < dw) {
+        state.skip("GL_MAX_TEXTURE_SIZE " + to_string(max_size));
+        return;
+    }
+
+    GLenum filter = f == SF_BILINEAR ? GL_LINEAR : GL_NEAREST;
+    vector<uint8_t> src = test_frame(sw, sh);
+    GLuint src_tex = make_texture(sw, sh, src.data(), filter);
+    GLuint tmp_tex = Passes == 2 ? make_texture(dw, sh, NULL, filter) : 0;
+    GLuint dst_tex = make_texture(dw, dh, NULL, GL_NEAREST);
+    GLuint fbo[2];
+    glGenFramebuffers(2, fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo[0]);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+            Passes == 2 ? tmp_tex : dst_tex, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo[1]);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dst_tex, 0);
+
+    int taps_x = sf_filter_taps(f, sw, dw), taps_y = sf_filter_taps(f, sh, dh);
+    vector<ScalePass> passes;
+    if (Passes == 1) {
+        passes.push_back({ scale_program(f, false, taps_x, taps_y), src_tex, sw, sh,
+                dw, dh, fbo[0], false });
+    } else {
+        passes.push_back({ scale_program(f, true, taps_x, 0), src_tex, sw, sh, dw, sh,
+                fbo[0], false });
+        passes.push_back({ scale_program(f, true, taps_y, 0), tmp_tex, dw, sh, dw, dh,
+                fbo[1], true });
+    }
+
+    bool ok = true;
+    for (auto& p: passes) ok = ok && p.proc;
+    if (!ok) {
+        state.skip("shader does not compile");
+    } else {
+        for (auto& p: passes) draw_pass(f, p);
+        vector<uint8_t> out((size_t)dw * dh * 4), ref(out.size());
+        glBindFramebuffer(GL_FRAMEBUFFER, passes.back().fbo);
+        glReadPixels(0, 0, dw, dh, GL_RGBA, GL_UNSIGNED_BYTE, out.data());
+
+        struct sf_scaler s;
+        if (sf_scaler_init(&s, f, sw, sh, dw, dh)) {
+            state.skip("out of memory");
+        } else {
+            sf_scaler_run(&s, &sf_simd, ref.data(), src.data());
+            sf_scaler_release(&s);
+
+            int worst = 0;
+            for (size_t i = 0; i < out.size(); i++)
+                worst = max(worst, abs((int)out[i] - (int)ref[i]));
+            if (worst > max_difference)
+                state.fail("differs from the cpu scaler by up to " + to_string(worst));
+        }
+    }
+
+    // one destination frame per iteration, the rate is the frame rate
+    state.set_items(1, "frame");
+    while (state.keep_running()) {
+        for (auto& p: passes) draw_pass(f, p);
+        glFinish();
+    }
+
+    for (auto& p: passes) glprocess_release(p.proc);
+    glDeleteFramebuffers(2, fbo);
+    glDeleteTextures(1, &src_tex);
+    if (tmp_tex) glDeleteTextures(1, &tmp_tex);
+    glDeleteTextures(1, &dst_tex);
+}
+
+template <int F, int Simd>
+static void cpu_scale(BenchState& state)
+{
+    const struct sf_kernels *k = Simd ? &sf_simd : &sf_scalar;
+    int sw, sh, dw, dh;
+    frame_size(state.arg(), &sw, &sh, &dw, &dh);
+
+    if (Simd) {
+        const char *failed = sf_validate(k);
+        if (failed) {
+            state.fail(string(k->name) + " differs from scalar on " + failed);
+            return;
+        }
+    }
+
+    struct sf_scaler s;
+    if (sf_scaler_init(&s, (sf_filter)F, sw, sh, dw, dh)) {
+        state.skip("out of memory");
+        return;
+    }
+    vector<uint8_t> src = test_frame(sw, sh), dst((size_t)dw * dh * 4);
+    state.set_items(1, "frame");
+    while (state.keep_running()) {
+        sf_scaler_run(&s, k, dst.data(), src.data());
+        bench_keep(dst.data());
+    }
+    sf_scaler_release(&s);
+}
+
+static int register_scale_cases()
+{
+    static const struct {
+        const char *name;
+        BenchFunction fn;
+    } cases[] = {
+        { "scale_bilinear", gpu_scale<SF_BILINEAR, 1> },
+        { "scale_bilinear_2pass", gpu_scale<SF_BILINEAR, 2> },
+        { "scale_bicubic", gpu_scale<SF_BICUBIC, 1> },
+        { "scale_bicubic_2pass", gpu_scale<SF_BICUBIC, 2> },
+        { "scale_lanczos", gpu_scale<SF_LANCZOS, 1> },
+        { "scale_lanczos_2pass", gpu_scale<SF_LANCZOS, 2> },
+        { "scale_bilinear_cpu", cpu_scale<SF_BILINEAR, 0> },
+        { "scale_bilinear_simd", cpu_scale<SF_BILINEAR, 1> },
+        { "scale_bicubic_cpu", cpu_scale<SF_BICUBIC, 0> },
+        { "scale_bicubic_simd", cpu_scale<SF_BICUBIC, 1> },
+        { "scale_lanczos_cpu", cpu_scale<SF_LANCZOS, 0> },
+        { "scale_lanczos_simd", cpu_scale<SF_LANCZOS, 1> },
+    };
+    for (auto& c: cases) bench_register(c.name, c.fn, { 720, 1080, 2160 });
+    return 0;
+}
+static int scale_registered = register_scale_cases();
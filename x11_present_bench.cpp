@@ -0,0 +1,389 @@
+/**
+ * what the player's non-GL fallback can sustain: full window frames pushed
+ * through core XPutImage, MIT-SHM XShmPutImage and MIT-SHM pixmaps copied
+ * with XCopyArea, at 720p, 1080p and 4K. each method streams frames with a
+ * round trip every `depth` frames (depth client buffers in flight), each
+ * batch timed as ms/frame, then measures the round trip latency of single
+ * frames. the frame contents are prepared up front so only presentation is
+ * timed. server cpu time is read from /proc when the server is local. works
+ * against Xvfb, whose screen must be at least as large as the biggest size
+ * (-screen 0 3840x2160x24).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/socket.h>
+#include <vector>
+#include <string>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+#include "benchutil.h"
+#include "memstat.h"
+#include "benchresult.h"
+
+#define err_msg(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+} while (0)
+
+#define err_quit(...) do { \
+    fprintf(stderr, __VA_ARGS__); \
+    exit(1); \
+} while (0)
+
+using namespace std;
+
+enum Method {
+    METHOD_PUT,
+    METHOD_SHM,
+    METHOD_SHM_PIXMAP,
+    METHOD_COUNT,
+};
+
+static const char* method_names[] = { "put", "shm", "shmpixmap" };
+
+static struct {
+    const char* sizes;
+    int frames;
+    int latency_frames;
+    int depth;
+    const char* methods;
+} opts = {
+    "1280x720,1920x1080,3840x2160", 120, 60, 2, "all",
+};
+
+// XShmAttach fails with BadAccess on remote servers, only reported async
+static bool x_error;
+
+static int on_x_error(Display*, XErrorEvent*)
+{
+    x_error = true;
+    return 0;
+}
+
+// one client side frame buffer and the server object presenting it
+struct Buffer {
+    XImage* image {nullptr};
+    XShmSegmentInfo shm {};
+    bool attached {false};
+    Pixmap pixmap {None};
+};
+
+struct Presenter {
+    Display* dpy;
+    Window win;
+    GC gc;
+    Visual* visual;
+    int depth;
+    int width, height;
+    Method method;
+    vector<Buffer> buffers;
+};
+
+static void fill_frame(XImage* img, int seed)
+{
+    for (int y = 0; y < img->height; y++) {
+        uint32_t* row = (uint32_t*)(img->data + (size_t)y * img->bytes_per_line);
+        for (int x = 0; x < img->width; x++) {
+            row[x] = ((x + seed * 16) & 0xff) << 16 | ((y + seed * 8) & 0xff) << 8 |
+                ((x ^ y) & 0xff);
+        }
+    }
+}
+
+static void release_buffers(Presenter& p)
+{
+    for (auto& b: p.buffers) {
+        if (b.pixmap != None) XFreePixmap(p.dpy, b.pixmap);
+        if (b.attached) XShmDetach(p.dpy, &b.shm);
+        XSync(p.dpy, False);
+        if (b.image && p.method != METHOD_PUT) {
+            if (b.image->data) shmdt(b.shm.shmaddr);
+            b.image->data = NULL;
+        }
+        if (b.image) XDestroyImage(b.image);
+    }
+    p.buffers.clear();
+}
+
+static bool create_buffer(Presenter& p, Buffer& b)
+{
+    if (p.method == METHOD_PUT) {
+        b.image = XCreateImage(p.dpy, p.visual, p.depth, ZPixmap, 0, NULL,
+                p.width, p.height, 32, 0);
+        if (!b.image) return false;
+        b.image->data = (char*)malloc((size_t)b.image->bytes_per_line * p.height);
+        return b.image->data && b.image->bits_per_pixel == 32;
+    }
+
+    b.image = XShmCreateImage(p.dpy, p.visual, p.depth, ZPixmap, NULL,
+            &b.shm, p.width, p.height);
+    if (!b.image || b.image->bits_per_pixel != 32) return false;
+    b.shm.shmid = shmget(IPC_PRIVATE, (size_t)b.image->bytes_per_line * p.height,
+            IPC_CREAT | 0600);
+    if (b.shm.shmid < 0) return false;
+    char* addr = (char*)shmat(b.shm.shmid, NULL, 0);
+    if (addr == (char*)-1) {
+        shmctl(b.shm.shmid, IPC_RMID, NULL);
+        return false;
+    }
+    b.shm.shmaddr = b.image->data = addr;
+    b.shm.readOnly = True;
+    b.attached = XShmAttach(p.dpy, &b.shm);
+    XSync(p.dpy, False);
+    // goes away once both sides have detached
+    shmctl(b.shm.shmid, IPC_RMID, NULL);
+    if (!b.attached || x_error) return false;
+
+    if (p.method == METHOD_SHM_PIXMAP) {
+        b.pixmap = XShmCreatePixmap(p.dpy, p.win, b.shm.shmaddr, &b.shm,
+                p.width, p.height, p.depth);
+        XSync(p.dpy, False);
+    }
+    return !x_error;
+}
+
+static bool create_buffers(Presenter& p, int count)
+{
+    x_error = false;
+    p.buffers.resize(count);
+    for (int i = 0; i < count; i++) {
+        if (!create_buffer(p, p.buffers[i])) {
+            release_buffers(p);
+            return false;
+        }
+        fill_frame(p.buffers[i].image, i);
+    }
+    return true;
+}
+
+static void present(Presenter& p, int frame)
+{
+    Buffer& b = p.buffers[frame % p.buffers.size()];
+    switch (p.method) {
+        case METHOD_PUT:
+            XPutImage(p.dpy, p.win, p.gc, b.image, 0, 0, 0, 0, p.width, p.height);
+            break;
+        case METHOD_SHM:
+            XShmPutImage(p.dpy, p.win, p.gc, b.image, 0, 0, 0, 0, p.width, p.height,
+                    False);
+            break;
+        case METHOD_SHM_PIXMAP:
+            // shm pixmap contents follow the client memory, the copy presents it
+            XCopyArea(p.dpy, b.pixmap, p.win, p.gc, 0, 0, p.width, p.height, 0, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+// pid of the server at the other end of a local connection, or 0
+static pid_t server_pid(Display* dpy)
+{
+    struct ucred cred;
+    socklen_t len = sizeof cred;
+    if (getsockopt(ConnectionNumber(dpy), SOL_SOCKET, SO_PEERCRED, &cred, &len))
+        return 0;
+    return cred.pid;
+}
+
+// utime + stime of a process in ns, or -1 when not readable
+static int64_t process_cpu_ns(pid_t pid)
+{
+    if (pid <= 0) return -1;
+    char path[64], buf[1024];
+    snprintf(path, sizeof path, "/proc/%d/stat", (int)pid);
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+    size_t n = fread(buf, 1, sizeof buf - 1, f);
+    fclose(f);
+    buf[n] = 0;
+
+    // the command name may contain spaces, fields restart after ')'
+    char* p = strrchr(buf, ')');
+    unsigned long utime, stime;
+    if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                &utime, &stime) != 2)
+        return -1;
+    return (int64_t)(utime + stime) * (1000000000LL / sysconf(_SC_CLK_TCK));
+}
+
+static int run_method(Presenter& p, pid_t server, struct memstat* mem)
+{
+    char label[64];
+    snprintf(label, sizeof label, "%s %dx%d", method_names[p.method], p.width, p.height);
+
+    if (!create_buffers(p, opts.depth)) {
+        printf("%-24s unsupported by this server\n", label);
+        return 0;
+    }
+
+    for (int frame = 0; frame < opts.depth * 2; frame++) present(p, frame);
+    XSync(p.dpy, False);
+
+    // streaming: the client only waits when all its buffers are in flight.
+    // every batch of depth frames is one ms/frame sample
+    vector<double> frame_ms;
+    struct bench_cpu_usage cpu0, cpu1;
+    int64_t server0 = process_cpu_ns(server);
+    bench_cpu_sample(&cpu0);
+    uint64_t batch0 = bench_now_ns();
+    int next_mem = 0;
+    for (int frame = 0; frame < opts.frames; frame++) {
+        present(p, frame);
+        if ((frame + 1) % opts.depth) {
+            XFlush(p.dpy);
+            continue;
+        }
+        XSync(p.dpy, False);
+        frame_ms.push_back(bench_ns_to_ms(bench_now_ns() - batch0) / opts.depth);
+        // between batches so it is not timed
+        if (frame >= next_mem) {
+            memstat_sample(mem, method_names[p.method]);
+            next_mem = frame + 32;
+        }
+        batch0 = bench_now_ns();
+    }
+    XSync(p.dpy, False);
+    bench_cpu_sample(&cpu1);
+    int64_t server1 = process_cpu_ns(server);
+
+    double wall_s = (cpu1.wall_ns - cpu0.wall_ns) / 1e9;
+    double client_ms = (cpu1.user_ns - cpu0.user_ns + cpu1.sys_ns - cpu0.sys_ns) / 1e6;
+    double mb = (double)p.width * p.height * 4 * opts.frames / 1e6;
+    printf("%-24s %7.1f fps %8.0f MB/s  client cpu %6.2f ms/frame", label,
+            opts.frames / wall_s, mb / wall_s, client_ms / opts.frames);
+    if (server0 >= 0 && server1 >= 0)
+        printf("  server cpu %6.2f ms/frame", (server1 - server0) / 1e6 / opts.frames);
+    printf("\n");
+
+    char frame_label[80];
+    struct bench_stats st;
+    snprintf(frame_label, sizeof frame_label, "%s frame", label);
+    if (!frame_ms.empty()) {
+        bench_result_record("x11_present_bench", frame_label, "ms", 1,
+                frame_ms.data(), frame_ms.size());
+        bench_stats_compute(frame_ms.data(), frame_ms.size(), &st);
+        bench_stats_print("  frame", "ms", &st);
+    }
+
+    // round trip: present one frame and wait until the server has done it
+    vector<double> rtt_ms;
+    for (int frame = 0; frame < opts.latency_frames; frame++) {
+        uint64_t t0 = bench_now_ns();
+        present(p, frame);
+        XSync(p.dpy, False);
+        rtt_ms.push_back(bench_ns_to_ms(bench_now_ns() - t0));
+    }
+    bench_result_record("x11_present_bench", label, "ms", 1, rtt_ms.data(), rtt_ms.size());
+    bench_stats_compute(rtt_ms.data(), rtt_ms.size(), &st);
+    bench_stats_print("  round trip", "ms", &st);
+
+    release_buffers(p);
+    return x_error;
+}
+
+static void usage(const char* prog)
+{
+    err_quit("usage: %s [-s WxH,...] [-f frames] [-l latency_frames] [-d depth] "
+            "[-m all|put,shm,shmpixmap]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    int c;
+    while ((c = getopt(argc, argv, "s:f:l:d:m:")) != -1) {
+        switch (c) {
+            case 's': opts.sizes = optarg; break;
+            case 'f': opts.frames = atoi(optarg); break;
+            case 'l': opts.latency_frames = atoi(optarg); break;
+            case 'd': opts.depth = atoi(optarg); break;
+            case 'm': opts.methods = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (opts.frames <= 0 || opts.latency_frames <= 0 || opts.depth <= 0) usage(argv[0]);
+
+    Display* dpy = XOpenDisplay(NULL);
+    if (!dpy) err_quit("cannot open display\n");
+    XSetErrorHandler(on_x_error);
+
+    int scr = DefaultScreen(dpy);
+    int major = 0, minor = 0;
+    Bool shm_pixmaps = False;
+    bool has_shm = XShmQueryVersion(dpy, &major, &minor, &shm_pixmaps);
+    if (has_shm && XShmPixmapFormat(dpy) != ZPixmap) shm_pixmaps = False;
+
+    char driver[256];
+    snprintf(driver, sizeof driver, "%s %d", ServerVendor(dpy), VendorRelease(dpy));
+    bench_result_driver(driver);
+
+    pid_t server = server_pid(dpy);
+    printf("server: %s, screen %dx%d depth %d, MIT-SHM %s, shm pixmaps %s, server cpu %s\n",
+            driver, DisplayWidth(dpy, scr), DisplayHeight(dpy, scr),
+            DefaultDepth(dpy, scr),
+            has_shm ? (to_string(major) + "." + to_string(minor)).c_str() : "no",
+            shm_pixmaps ? "yes" : "no", process_cpu_ns(server) >= 0 ? "visible" : "not visible");
+
+    struct memstat mem = {0};
+    int ret = 0;
+    for (const char* s = opts.sizes; s && *s; s = strchr(s, ',') ? strchr(s, ',') + 1 : NULL) {
+        int w, h;
+        if (sscanf(s, "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) usage(argv[0]);
+
+        // clipped frames would not be a full screen frame
+        if (w > DisplayWidth(dpy, scr) || h > DisplayHeight(dpy, scr)) {
+            printf("%dx%d: larger than the screen, skipped (Xvfb -screen 0 %dx%dx24)\n",
+                    w, h, w, h);
+            continue;
+        }
+
+        XSetWindowAttributes attrs;
+        attrs.override_redirect = True;
+        attrs.background_pixmap = None;
+        Window win = XCreateWindow(dpy, RootWindow(dpy, scr), 0, 0, w, h, 0,
+                CopyFromParent, InputOutput, CopyFromParent,
+                CWOverrideRedirect | CWBackPixmap, &attrs);
+        XSelectInput(dpy, win, StructureNotifyMask);
+        XMapWindow(dpy, win);
+        for (XEvent ev; ; ) {
+            XNextEvent(dpy, &ev);
+            if (ev.type == MapNotify) break;
+        }
+
+        Presenter p;
+        p.dpy = dpy;
+        p.win = win;
+        p.gc = XCreateGC(dpy, win, 0, NULL);
+        p.visual = DefaultVisual(dpy, scr);
+        p.depth = DefaultDepth(dpy, scr);
+        p.width = w;
+        p.height = h;
+
+        for (int m = 0; m < METHOD_COUNT; m++) {
+            if (!bench_selected(opts.methods, method_names[m])) continue;
+            if ((m != METHOD_PUT && !has_shm) || (m == METHOD_SHM_PIXMAP && !shm_pixmaps)) {
+                printf("%s %dx%d: not available\n", method_names[m], w, h);
+                continue;
+            }
+            p.method = (Method)m;
+            ret |= run_method(p, server, &mem);
+        }
+
+        XFreeGC(dpy, p.gc);
+        XDestroyWindow(dpy, win);
+        XSync(dpy, False);
+    }
+
+    XCloseDisplay(dpy);
+    memstat_sample(&mem, "end");
+    memstat_report(&mem, "x11_present_bench");
+    memstat_release(&mem);
+    return ret;
+}
@@ -14,6 +14,8 @@
 #include <X11/extensions/Xcomposite.h>
 #include <X11/extensions/Xdamage.h>
 
+#include "memstat.h"
+
 using namespace std;
 
 static string run_and_collect(const string& cmd)
@@ -205,10 +207,19 @@ int main(int argc, char *argv[])
         new ExtensionChecker(),
     };
 
+    struct memstat mem = {0};
+    memstat_sample(&mem, "start");
+
+    int ret = 0;
     for (int i = 0; i < 2; i++) {
-        if (checkers[i]->doTest()) 
-            return 1;
+        ret = checkers[i]->doTest();
+        memstat_sample(&mem, "checker");
+        if (ret)
+            break;
     }
-    return 0;
+
+    memstat_report(&mem, "xorg_test");
+    memstat_release(&mem);
+    return ret;
 }
 